@@ -33,8 +33,24 @@
 #include <assert.h>
 #include <bearssl.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "daence_stats.h"
+#include "poly1305x2.h"
+
+/*
+ * HChaCha20 runs a few times per message, so pick its kernel when
+ * compiling rather than asking the CPU each time.  SSE2 is part of
+ * x86-64, and of any i386 build that the compiler may use it in.
+ */
+#if defined(__GNUC__) && defined(__SSE2__)
+#define	HCHACHA20_SSE2
+#include <emmintrin.h>
+#endif
+
+#define	TILE	4096		/* bytes per fused decrypt/MAC tile */
+
 static inline uint32_t
 le32dec(const void *buf)
 {
@@ -60,6 +76,142 @@ le32enc(void *buf, uint32_t v)
 	p[3] = v >> 24;
 }
 
+static inline void
+le64enc(void *buf, uint64_t v)
+{
+	uint8_t *p = buf;
+
+	p[0] = v >> 0;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+	p[4] = v >> 32;
+	p[5] = v >> 40;
+	p[6] = v >> 48;
+	p[7] = v >> 56;
+}
+
+/*
+ * HChaCha20 computed directly rather than by running a whole ChaCha
+ * block through ichacha and subtracting the input back out of the
+ * feed-forward: words 0..3 and 12..15 of the permuted state, with no
+ * keystream buffer.  out may alias key.
+ */
+
+static const uint8_t hchacha20_const[16] = "expand 32-byte k";
+
+static inline uint32_t
+rol32(uint32_t x, unsigned c)
+{
+
+	return (x << c) | (x >> (32 - c));
+}
+
+#define	QR(a, b, c, d) do {						      \
+	(a) += (b); (d) ^= (a); (d) = rol32((d), 16);			      \
+	(c) += (d); (b) ^= (c); (b) = rol32((b), 12);			      \
+	(a) += (b); (d) ^= (a); (d) = rol32((d), 8);			      \
+	(c) += (d); (b) ^= (c); (b) = rol32((b), 7);			      \
+} while (0)
+
+static void
+hchacha20_scalar(const uint8_t key[static 32], const uint8_t in[static 16],
+    uint8_t out[static 32])
+{
+	uint32_t x[16];
+	unsigned i;
+
+	for (i = 0; i < 4; i++) {
+		x[i] = le32dec(hchacha20_const + 4*i);
+		x[4 + i] = le32dec(key + 4*i);
+		x[8 + i] = le32dec(key + 16 + 4*i);
+		x[12 + i] = le32dec(in + 4*i);
+	}
+	for (i = 0; i < 10; i++) {
+		QR(x[0], x[4], x[8], x[12]);	/* columns */
+		QR(x[1], x[5], x[9], x[13]);
+		QR(x[2], x[6], x[10], x[14]);
+		QR(x[3], x[7], x[11], x[15]);
+		QR(x[0], x[5], x[10], x[15]);	/* diagonals */
+		QR(x[1], x[6], x[11], x[12]);
+		QR(x[2], x[7], x[8], x[13]);
+		QR(x[3], x[4], x[9], x[14]);
+	}
+	for (i = 0; i < 4; i++) {
+		le32enc(out + 4*i, x[i]);
+		le32enc(out + 16 + 4*i, x[12 + i]);
+	}
+
+	memset(x, 0, sizeof x);
+}
+
+#undef	QR
+
+#ifdef HCHACHA20_SSE2
+
+static inline __m128i
+rol32x4(__m128i x, int c)
+{
+
+	return _mm_or_si128(_mm_slli_epi32(x, c), _mm_srli_epi32(x, 32 - c));
+}
+
+/*
+ * One row of the state per register, so each quarter-round step does
+ * all four columns (or, after rotating rows 1-3, all four diagonals)
+ * at once.  No SSSE3 byte shuffles: the 16- and 8-bit rotations are
+ * shifts like the rest, so this runs on any SSE2 CPU.
+ */
+static void
+hchacha20_sse2(const uint8_t key[static 32], const uint8_t in[static 16],
+    uint8_t out[static 32])
+{
+	__m128i a, b, c, d;
+	unsigned i;
+
+	a = _mm_loadu_si128((const __m128i *)hchacha20_const);
+	b = _mm_loadu_si128((const __m128i *)key);
+	c = _mm_loadu_si128((const __m128i *)(key + 16));
+	d = _mm_loadu_si128((const __m128i *)in);
+
+#define	QR4() do {							      \
+	a = _mm_add_epi32(a, b); d = rol32x4(_mm_xor_si128(d, a), 16);	      \
+	c = _mm_add_epi32(c, d); b = rol32x4(_mm_xor_si128(b, c), 12);	      \
+	a = _mm_add_epi32(a, b); d = rol32x4(_mm_xor_si128(d, a), 8);	      \
+	c = _mm_add_epi32(c, d); b = rol32x4(_mm_xor_si128(b, c), 7);	      \
+} while (0)
+
+	for (i = 0; i < 10; i++) {
+		QR4();			/* columns */
+		b = _mm_shuffle_epi32(b, 0x39);
+		c = _mm_shuffle_epi32(c, 0x4e);
+		d = _mm_shuffle_epi32(d, 0x93);
+		QR4();			/* diagonals */
+		b = _mm_shuffle_epi32(b, 0x93);
+		c = _mm_shuffle_epi32(c, 0x4e);
+		d = _mm_shuffle_epi32(d, 0x39);
+	}
+
+#undef	QR4
+
+	_mm_storeu_si128((__m128i *)out, a);
+	_mm_storeu_si128((__m128i *)(out + 16), d);
+}
+
+#endif	/* HCHACHA20_SSE2 */
+
+static void
+hchacha20_run(const uint8_t key[static 32], const uint8_t in[static 16],
+    uint8_t out[static 32])
+{
+
+#ifdef HCHACHA20_SSE2
+	hchacha20_sse2(key, in, out);
+#else
+	hchacha20_scalar(key, in, out);
+#endif
+}
+
 static uint32_t
 null_chacha20_run(const void *key, const void *iv, uint32_t cc, void *data,
     size_t len)
@@ -74,57 +226,116 @@ null_chacha20_run(const void *key, const void *iv, uint32_t cc, void *data,
 	return 1;
 }
 
-static void
-hchacha20_run(const uint8_t key[static 32], const uint8_t in[static 16],
-    uint8_t out[static 32], br_chacha20_run ichacha)
-{
-	static const unsigned char c[16] = "expand 32-byte k";
-	uint8_t buf[64] = {0};
-
-	ichacha(key, in + 4, le32dec(in), buf, sizeof buf);
-	le32enc(out + 4*0, le32dec(buf + 4*0) - le32dec(c + 4*0));
-	le32enc(out + 4*1, le32dec(buf + 4*1) - le32dec(c + 4*1));
-	le32enc(out + 4*2, le32dec(buf + 4*2) - le32dec(c + 4*2));
-	le32enc(out + 4*3, le32dec(buf + 4*3) - le32dec(c + 4*3));
-	le32enc(out + 4*4, le32dec(buf + 4*12) - le32dec(in + 4*0));
-	le32enc(out + 4*5, le32dec(buf + 4*13) - le32dec(in + 4*1));
-	le32enc(out + 4*6, le32dec(buf + 4*14) - le32dec(in + 4*2));
-	le32enc(out + 4*7, le32dec(buf + 4*15) - le32dec(in + 4*3));
-}
-
 static void
 xchacha20_run(const uint8_t key[static 32], const uint8_t nonce[static 24],
     uint32_t cc, void *data, size_t len, br_chacha20_run ichacha)
 {
 	uint8_t subkey[32], subnonce[12];
 
-	hchacha20_run(key, nonce, subkey, ichacha);
+	hchacha20_run(key, nonce, subkey);
 	memset(subnonce, 0, 4);
 	memcpy(subnonce + 4, nonce + 16, 8);
 	ichacha(subkey, subnonce, cc, data, len);
 }
 
+/*
+ * t := HChaCha_{HChaCha_k0(h1)}(h2)[0..24]
+ */
+static void
+hashtag(const uint8_t k0[static 32], const uint8_t h[static 32],
+    uint8_t t[static 24])
+{
+	uint8_t u[32];
+	uint64_t t0 = daence_stats_begin();
+
+	hchacha20_run(k0, h, u);
+	hchacha20_run(u, h + 16, u);
+	daence_stats_end(DAENCE_IMPL_BEAR, DAENCE_PHASE_TAG, 0, t0);
+
+	memcpy(t, u, 24);
+}
+
+/*
+ * h1 := Poly1305_{k1}(pad0(aad) || pad0(data) || |aad|_8 || |data|_8)
+ * h2 := Poly1305_{k2}(pad0(aad) || pad0(data) || |aad|_8 || |data|_8)
+ *
+ * with the caller's BearSSL Poly1305, one key per pass.
+ */
 static void
 compressauth(const uint8_t key[static 64], const void *data, size_t len,
-    const void *aad, size_t aad_len, void *tag,
-    br_chacha20_run ichacha, br_poly1305_run ipoly1305)
+    const void *aad, size_t aad_len, uint8_t t[static 24],
+    br_poly1305_run ipoly1305)
 {
 	/*
 	 * ipoly1305 won't write to data (via null_chacha20_run), so
 	 * just discard the const qualifier.
 	 */
 	void *ptr = (void *)(uintptr_t)data;
-	const uint8_t *k0 = key, *k1 = key + 32, *k2 = key + 48;
+	const uint8_t *k1 = key + 32, *k2 = key + 48;
 	uint8_t h[32], *h1 = h, *h2 = h + 16;
-	uint8_t u[32];
+	uint64_t t0;
 
+	t0 = daence_stats_begin();
 	ipoly1305(k1, NULL, ptr, len, aad, aad_len, h1, null_chacha20_run, 0);
 	ipoly1305(k2, NULL, ptr, len, aad, aad_len, h2, null_chacha20_run, 0);
+	daence_stats_end(DAENCE_IMPL_BEAR, DAENCE_PHASE_COMPRESS,
+	    len + aad_len, t0);
 
-	hchacha20_run(k0, h1, u, ichacha);
-	hchacha20_run(u, h2, u, ichacha);
+	hashtag(key, h, t);
+}
 
-	memcpy(tag, u, 24);
+/*
+ * h := Poly1305^2_{k1,k2}(pad0(aad) || pad0(data) || |aad|_8 || |data|_8)
+ *
+ * with poly1305x2, which reads aad and data once for both keys.
+ */
+static void
+compressauth_x2(const uint8_t key[static 64], const void *data, size_t len,
+    const void *aad, size_t aad_len, uint8_t t[static 24])
+{
+	static const uint8_t z[16] = {0};
+	const uint8_t *k1 = key + 32, *k2 = key + 48;
+	uint8_t h[32], len64le[16];
+	struct poly1305x2_key k12;
+	struct poly1305x2 poly1305;
+	uint64_t t0;
+
+	t0 = daence_stats_begin();
+	poly1305x2_setkey(&k12, k1, k2);
+	poly1305x2_init(&poly1305, &k12);
+	poly1305x2_update(&poly1305, aad, aad_len);
+	poly1305x2_update(&poly1305, z, (0x10 - aad_len) & 0xf);
+	poly1305x2_update(&poly1305, data, len);
+	poly1305x2_update(&poly1305, z, (0x10 - len) & 0xf);
+	le64enc(&len64le[0], aad_len);
+	le64enc(&len64le[8], len);
+	poly1305x2_update(&poly1305, len64le, 16);
+	poly1305x2_final(&poly1305, h, h + 16);
+	poly1305x2_clearkey(&k12);
+	daence_stats_end(DAENCE_IMPL_BEAR, DAENCE_PHASE_COMPRESS,
+	    len + aad_len, t0);
+
+	hashtag(key, h, t);
+}
+
+/*
+ * Compare tags as best we can in constant time.  Returns 1 if they
+ * match, 0 if not.
+ */
+static int
+tagmatch(const uint8_t t[static 24], const uint8_t u[static 24])
+{
+	unsigned i, d = 0;
+
+	/*
+	 * XXX No consttime_memequal in BearSSL -- hope the compiler
+	 * doesn't try to optimize this...
+	 */
+	for (i = 0; i < 24; i++)
+		d |= t[i] ^ u[i];
+	asm volatile("" ::: "memory");
+
+	return d == 0;
 }
 
 void
@@ -132,9 +343,13 @@ br_chachadaence_encrypt(const void *key, void *data, size_t len,
     const void *aad, size_t aad_len, void *tag,
     br_chacha20_run ichacha, br_poly1305_run ipoly1305)
 {
+	uint64_t t0 = daence_stats_begin(), t1;
 
-	compressauth(key, data, len, aad, aad_len, tag, ichacha, ipoly1305);
+	compressauth(key, data, len, aad, aad_len, tag, ipoly1305);
+	t1 = daence_stats_begin();
 	xchacha20_run(key, tag, 0, data, len, ichacha);
+	daence_stats_end(DAENCE_IMPL_BEAR, DAENCE_PHASE_STREAM, len, t1);
+	daence_stats_end(DAENCE_IMPL_BEAR, DAENCE_PHASE_SEAL, len, t0);
 }
 
 int
@@ -142,22 +357,103 @@ br_chachadaence_decrypt(const void *key, void *data, size_t len,
     const void *aad, size_t aad_len, const void *tag,
     br_chacha20_run ichacha, br_poly1305_run ipoly1305)
 {
-	const uint8_t *t = tag;
 	uint8_t t_[24];
-	unsigned i, d = 0;
+	uint64_t t0 = daence_stats_begin(), t1;
+	int ok;
 
+	t1 = daence_stats_begin();
 	xchacha20_run(key, tag, 0, data, len, ichacha);
-	compressauth(key, data, len, aad, aad_len, t_, ichacha, ipoly1305);
+	daence_stats_end(DAENCE_IMPL_BEAR, DAENCE_PHASE_STREAM, len, t1);
+	compressauth(key, data, len, aad, aad_len, t_, ipoly1305);
+	ok = tagmatch(tag, t_);
+	daence_stats_end(DAENCE_IMPL_BEAR, DAENCE_PHASE_OPEN, len, t0);
 
-	/*
-	 * XXX No consttime_memequal in BearSSL -- hope the compiler
-	 * doesn't try to optimize this...
-	 */
-	for (i = 0; i < 24; i++)
-		d |= t[i] ^ t_[i];
-	asm volatile("" ::: "memory");
+	if (!ok) {
+		memset(data, 0, len);
+		return 0;
+	}
 
-	if (d) {
+	return 1;
+}
+
+void
+br_chachadaence_encrypt_x2(const void *key, void *data, size_t len,
+    const void *aad, size_t aad_len, void *tag, br_chacha20_run ichacha)
+{
+	uint64_t t0 = daence_stats_begin(), t1;
+
+	compressauth_x2(key, data, len, aad, aad_len, tag);
+	t1 = daence_stats_begin();
+	xchacha20_run(key, tag, 0, data, len, ichacha);
+	daence_stats_end(DAENCE_IMPL_BEAR, DAENCE_PHASE_STREAM, len, t1);
+	daence_stats_end(DAENCE_IMPL_BEAR, DAENCE_PHASE_SEAL, len, t0);
+}
+
+/*
+ * Decrypt data in place and compress it in one pass, in tiles small
+ * enough that each tile of plaintext is still in L1 cache when
+ * Poly1305 reads it back:
+ *
+ *	data := data ^ XChaCha_k0(t')
+ *	h := Poly1305^2_{k1,k2}(pad0(aad) || pad0(data) || |aad|_8 || |data|_8)
+ *
+ * BearSSL's Poly1305 can only take the whole message at once, so this
+ * uses poly1305x2 instead.
+ */
+static void
+decryptauth(const uint8_t key[static 64], void *data, size_t len,
+    const void *aad, size_t aad_len, const uint8_t tag[static 24],
+    uint8_t h[static 32], br_chacha20_run ichacha)
+{
+	static const uint8_t z[16] = {0};
+	const uint8_t *k0 = key, *k1 = key + 32, *k2 = key + 48;
+	uint8_t subkey[32], subnonce[12], len64le[16];
+	struct poly1305x2_key k12;
+	struct poly1305x2 poly1305;
+	uint8_t *p = data;
+	size_t i, n;
+	uint32_t cc = 0;
+
+	hchacha20_run(k0, tag, subkey);
+	memset(subnonce, 0, 4);
+	memcpy(subnonce + 4, tag + 16, 8);
+
+	poly1305x2_setkey(&k12, k1, k2);
+	poly1305x2_init(&poly1305, &k12);
+	poly1305x2_update(&poly1305, aad, aad_len);
+	poly1305x2_update(&poly1305, z, (0x10 - aad_len) & 0xf);
+	for (i = 0; i < len; i += n) {
+		n = (len - i < TILE ? len - i : TILE);
+		cc = ichacha(subkey, subnonce, cc, p + i, n);
+		poly1305x2_update(&poly1305, p + i, n);
+	}
+	poly1305x2_update(&poly1305, z, (0x10 - len) & 0xf);
+	le64enc(&len64le[0], aad_len);
+	le64enc(&len64le[8], len);
+	poly1305x2_update(&poly1305, len64le, 16);
+	poly1305x2_final(&poly1305, h, h + 16);
+
+	poly1305x2_clearkey(&k12);
+	memset(subkey, 0, sizeof subkey);
+}
+
+int
+br_chachadaence_decrypt_x2(const void *key, void *data, size_t len,
+    const void *aad, size_t aad_len, const void *tag, br_chacha20_run ichacha)
+{
+	uint8_t h[32], t_[24];
+	uint64_t t0 = daence_stats_begin(), t1;
+	int ok;
+
+	t1 = daence_stats_begin();
+	decryptauth(key, data, len, aad, aad_len, tag, h, ichacha);
+	daence_stats_end(DAENCE_IMPL_BEAR, DAENCE_PHASE_FUSED,
+	    len + aad_len, t1);
+	hashtag(key, h, t_);
+	ok = tagmatch(tag, t_);
+	daence_stats_end(DAENCE_IMPL_BEAR, DAENCE_PHASE_OPEN, len, t0);
+
+	if (!ok) {
 		memset(data, 0, len);
 		return 0;
 	}
@@ -166,7 +462,7 @@ br_chachadaence_decrypt(const void *key, void *data, size_t len,
 }
 
 static int
-hchacha20_selftest(br_chacha20_run ichacha)
+hchacha20_selftest(void)
 {
 	/* https://tools.ietf.org/html/draft-irtf-cfrg-xchacha-03, §2.2.1 */
 	static const uint8_t k[32] = {
@@ -187,15 +483,56 @@ hchacha20_selftest(br_chacha20_run ichacha)
 	};
 	uint8_t out[32];
 
-	hchacha20_run(k, in, out, ichacha);
+	hchacha20_scalar(k, in, out);
+	if (memcmp(out, expected, 32))
+		return -1;
+#ifdef HCHACHA20_SSE2
+	memset(out, 0, sizeof out);
+	hchacha20_sse2(k, in, out);
 	if (memcmp(out, expected, 32))
 		return -1;
+#endif
 
 	return 0;
 }
 
-int
-br_chachadaence_selftest(br_chacha20_run ichacha, br_poly1305_run ipoly1305)
+/* With ipoly1305, or through poly1305x2 if it is null.  */
+static void
+encrypt_either(const void *key, void *data, size_t len,
+    const void *aad, size_t aad_len, void *tag,
+    br_chacha20_run ichacha, br_poly1305_run ipoly1305)
+{
+
+	if (ipoly1305) {
+		br_chachadaence_encrypt(key, data, len, aad, aad_len, tag,
+		    ichacha, ipoly1305);
+	} else {
+		br_chachadaence_encrypt_x2(key, data, len, aad, aad_len, tag,
+		    ichacha);
+	}
+}
+
+static int
+decrypt_either(const void *key, void *data, size_t len,
+    const void *aad, size_t aad_len, const void *tag,
+    br_chacha20_run ichacha, br_poly1305_run ipoly1305)
+{
+
+	if (ipoly1305) {
+		return br_chachadaence_decrypt(key, data, len, aad, aad_len,
+		    tag, ichacha, ipoly1305);
+	} else {
+		return br_chachadaence_decrypt_x2(key, data, len, aad,
+		    aad_len, tag, ichacha);
+	}
+}
+
+/*
+ * Run the test vectors with ipoly1305, or through poly1305x2 if it is
+ * null.
+ */
+static int
+selftest_vectors(br_chacha20_run ichacha, br_poly1305_run ipoly1305)
 {
 	static const unsigned char k[64] = {
 		0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,
@@ -231,17 +568,14 @@ br_chachadaence_selftest(br_chacha20_run ichacha, br_poly1305_run ipoly1305)
 	unsigned char tag[sizeof t];
 	unsigned char data[sizeof m];
 
-	if (hchacha20_selftest(ichacha))
-		return -1;
-
 	memcpy(data, m, sizeof m);
-	br_chachadaence_encrypt(k, data, sizeof data, a, sizeof a, tag,
+	encrypt_either(k, data, sizeof data, a, sizeof a, tag,
 	    ichacha, ipoly1305);
 	if (memcmp(tag, t, sizeof t))
 		return -1;
 	if (memcmp(data, c, sizeof c))
 		return -1;
-	if (!br_chachadaence_decrypt(k, data, sizeof data, a, sizeof a, t,
+	if (!decrypt_either(k, data, sizeof data, a, sizeof a, t,
 		ichacha, ipoly1305))
 		return -1;
 	if (memcmp(data, m, sizeof m))
@@ -249,9 +583,102 @@ br_chachadaence_selftest(br_chacha20_run ichacha, br_poly1305_run ipoly1305)
 
 	memcpy(data, c, sizeof c);
 	data[18] ^= 0x4;
-	if (br_chachadaence_decrypt(k, data, sizeof data, a, sizeof a, t,
+	if (decrypt_either(k, data, sizeof data, a, sizeof a, t,
 		ichacha, ipoly1305))
 		return -1;
 
 	return 0;
 }
+
+int
+br_chachadaence_selftest(br_chacha20_run ichacha, br_poly1305_run ipoly1305)
+{
+
+	if (hchacha20_selftest())
+		return -1;
+	if (selftest_vectors(ichacha, ipoly1305))
+		return -1;
+	if (selftest_vectors(ichacha, 0))
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Fastest ChaCha20 and Poly1305 pair available on this CPU, found on
+ * first use and kept.  ChaCha20 candidates are sse2 then ct; Poly1305
+ * candidates are poly1305x2 (null below), which reads the data once for
+ * both keys, then BearSSL's ctmulq and ctmul.  Each pair must pass the
+ * selftest; ct and ctmul are the last resort, and if even they fail,
+ * something is badly wrong and we refuse to go on.  Threads racing on
+ * the first call all arrive at the same answer.
+ */
+static br_chacha20_run auto_ichacha;
+static br_poly1305_run auto_ipoly1305;
+static int auto_ready;
+
+static void
+auto_select(void)
+{
+	br_chacha20_run chachas[2];
+	br_poly1305_run polys[3];
+	unsigned nchacha = 0, npoly = 0, i, j;
+
+	if (__atomic_load_n(&auto_ready, __ATOMIC_ACQUIRE))
+		return;
+
+	if ((chachas[nchacha] = br_chacha20_sse2_get()) != 0)
+		nchacha++;
+	chachas[nchacha++] = br_chacha20_ct_run;
+	polys[npoly++] = 0;
+	if ((polys[npoly] = br_poly1305_ctmulq_get()) != 0)
+		npoly++;
+	polys[npoly++] = br_poly1305_ctmul_run;
+
+	if (hchacha20_selftest())
+		abort();
+	for (i = 0; i < nchacha; i++) {
+		for (j = 0; j < npoly; j++) {
+			if (selftest_vectors(chachas[i], polys[j]))
+				continue;
+			__atomic_store_n(&auto_ichacha, chachas[i],
+			    __ATOMIC_RELAXED);
+			__atomic_store_n(&auto_ipoly1305, polys[j],
+			    __ATOMIC_RELAXED);
+			__atomic_store_n(&auto_ready, 1, __ATOMIC_RELEASE);
+			return;
+		}
+	}
+
+	abort();
+}
+
+void
+br_chachadaence_auto_get(br_chacha20_run *ichachap,
+    br_poly1305_run *ipoly1305p)
+{
+
+	auto_select();
+	*ichachap = auto_ichacha;
+	*ipoly1305p = auto_ipoly1305;
+}
+
+void
+br_chachadaence_encrypt_auto(const void *key, void *data, size_t len,
+    const void *aad, size_t aad_len, void *tag)
+{
+
+	auto_select();
+	encrypt_either(key, data, len, aad, aad_len, tag, auto_ichacha,
+	    auto_ipoly1305);
+}
+
+int
+br_chachadaence_decrypt_auto(const void *key, void *data, size_t len,
+    const void *aad, size_t aad_len, const void *tag)
+{
+
+	auto_select();
+	return decrypt_either(key, data, len, aad, aad_len, tag, auto_ichacha,
+	    auto_ipoly1305);
+}
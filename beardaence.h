@@ -29,6 +29,10 @@
 
 #include <bearssl.h>
 
+/*
+ * ichacha and ipoly1305 are the BearSSL ChaCha20 and Poly1305 to use.
+ * The selftest also runs ichacha through the _x2 calls below.
+ */
 void br_chachadaence_encrypt(const void *key, void *data, size_t len,
     const void *aad, size_t aad_len, void *tag,
     br_chacha20_run ichacha, br_poly1305_run ipoly1305);
@@ -40,4 +44,33 @@ int br_chachadaence_decrypt(const void *key, void *data, size_t len,
 int br_chachadaence_selftest(br_chacha20_run ichacha,
     br_poly1305_run ipoly1305);
 
+/*
+ * Same as above, but with poly1305x2.c in place of a BearSSL Poly1305:
+ * sealing reads aad and data once for both Poly1305 keys, and opening
+ * decrypts and hashes each tile of data while it is still in cache.
+ */
+void br_chachadaence_encrypt_x2(const void *key, void *data, size_t len,
+    const void *aad, size_t aad_len, void *tag, br_chacha20_run ichacha);
+
+int br_chachadaence_decrypt_x2(const void *key, void *data, size_t len,
+    const void *aad, size_t aad_len, const void *tag,
+    br_chacha20_run ichacha);
+
+/*
+ * Same as above with the fastest ChaCha20 and Poly1305 available on
+ * this CPU, chosen on first use after passing the selftest: sse2 if
+ * present, else ct, with poly1305x2 as in the _x2 calls, falling back
+ * to BearSSL's ctmulq if present, else ctmul, only if poly1305x2 fails.
+ * br_chachadaence_auto_get reports the choice, with a null ipoly1305
+ * meaning poly1305x2.
+ */
+void br_chachadaence_encrypt_auto(const void *key, void *data, size_t len,
+    const void *aad, size_t aad_len, void *tag);
+
+int br_chachadaence_decrypt_auto(const void *key, void *data, size_t len,
+    const void *aad, size_t aad_len, const void *tag);
+
+void br_chachadaence_auto_get(br_chacha20_run *ichacha,
+    br_poly1305_run *ipoly1305);
+
 #endif	/* BEARDAENCE_H */
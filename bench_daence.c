@@ -0,0 +1,500 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Benchmark the C implementations of Daence: seal and open, over a
+ * range of message and header sizes, reporting time and messages per
+ * second, and cycles where a cycle counter is available.
+ *
+ *	bench_daence [-jqs] [-m maxmlen] [impl ...]
+ *
+ *	-j	print JSON instead of CSV
+ *	-q	quick: fewer sizes and shorter runs, for smoke tests
+ *	-s	print a breakdown by phase to stderr at the end, if built
+ *		with -DDAENCE_STATS (see daence_stats.h)
+ *	-m	largest message size to try (default 1 MiB)
+ *
+ * impl is any of chachadaence, salsa20daence, tweetdaence, bear-ct,
+ * bear-sse2, bear-sse2-x2, and bear-auto; default is all that are
+ * available.
+ *
+ * Each measurement is the median over several runs, each of enough
+ * iterations to take about a millisecond.  On x86 `cycles' come from
+ * the time-stamp counter, which ticks at a fixed rate that need not be
+ * the core clock; compare them only between runs on the same machine.
+ */
+
+#define	_POSIX_C_SOURCE	200809L
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define	HAVE_RDTSC
+#include <x86intrin.h>
+#endif
+
+#include "beardaence.h"
+#include "chachadaence.h"
+#include "daence_stats.h"
+#include "salsa20daence.h"
+
+/*
+ * tweetdaence.h renames crypto_dae_salsa20daence to the tweet version,
+ * which would clash with salsa20daence.h, so declare it by hand.
+ */
+void crypto_dae_salsa20daence_tweet(unsigned char *, const unsigned char *,
+    unsigned long long, const unsigned char *, unsigned long long,
+    const unsigned char *);
+int crypto_dae_salsa20daence_tweet_open(unsigned char *,
+    const unsigned char *, unsigned long long, const unsigned char *,
+    unsigned long long, const unsigned char *);
+
+#define	MAXALEN		4096
+#define	NRUNS		7
+#define	NRUNS_QUICK	3
+#define	RUNNSEC		1000000		/* target time per run */
+#define	RUNNSEC_QUICK	100000
+
+void
+randombytes(unsigned char *p, unsigned long long n)
+{
+
+	/* Needed to link tweetnacl; nothing here is secret.  */
+	while (n--)
+		*p++ = rand();
+}
+
+struct bench {
+	unsigned char		*c, *m, *a, *buf;
+	unsigned long long	mlen, alen;
+	unsigned char		k[96];
+	struct crypto_dae_chachadaence_ctx chacha;
+	struct crypto_dae_salsa20daence_ctx salsa;
+	br_chacha20_run		ichacha;
+	br_poly1305_run		ipoly1305;
+};
+
+static void
+chacha_seal(struct bench *B)
+{
+
+	crypto_dae_chachadaence_ctx_encrypt(B->c, B->m, B->mlen,
+	    B->a, B->alen, &B->chacha);
+}
+
+static void
+chacha_open(struct bench *B)
+{
+
+	if (crypto_dae_chachadaence_ctx_open(B->buf, B->c, B->mlen,
+		B->a, B->alen, &B->chacha))
+		errx(1, "chachadaence: forgery");
+}
+
+static void
+salsa_seal(struct bench *B)
+{
+
+	crypto_dae_salsa20daence_ctx_encrypt(B->c, B->m, B->mlen,
+	    B->a, B->alen, &B->salsa);
+}
+
+static void
+salsa_open(struct bench *B)
+{
+
+	if (crypto_dae_salsa20daence_ctx_open(B->buf, B->c, B->mlen,
+		B->a, B->alen, &B->salsa))
+		errx(1, "salsa20daence: forgery");
+}
+
+static void
+tweet_seal(struct bench *B)
+{
+
+	crypto_dae_salsa20daence_tweet(B->c, B->m, B->mlen, B->a, B->alen,
+	    B->k);
+}
+
+static void
+tweet_open(struct bench *B)
+{
+
+	if (crypto_dae_salsa20daence_tweet_open(B->buf, B->c, B->mlen,
+		B->a, B->alen, B->k))
+		errx(1, "tweetdaence: forgery");
+}
+
+/*
+ * BearSSL-style calls work in place, so the ciphertext is c[24..] and
+ * the tag c[0..24], and opening starts from a fresh copy each time --
+ * the copy is counted in the time, but it is cheap next to the rest.
+ */
+static void
+bear_seal(struct bench *B)
+{
+
+	br_chachadaence_encrypt(B->k, B->c + 24, B->mlen, B->a, B->alen,
+	    B->c, B->ichacha, B->ipoly1305);
+}
+
+static void
+bear_open(struct bench *B)
+{
+
+	memcpy(B->buf, B->c + 24, B->mlen);
+	if (!br_chachadaence_decrypt(B->k, B->buf, B->mlen, B->a, B->alen,
+		B->c, B->ichacha, B->ipoly1305))
+		errx(1, "beardaence: forgery");
+}
+
+static void
+bear_seal_x2(struct bench *B)
+{
+
+	br_chachadaence_encrypt_x2(B->k, B->c + 24, B->mlen, B->a, B->alen,
+	    B->c, B->ichacha);
+}
+
+static void
+bear_open_x2(struct bench *B)
+{
+
+	memcpy(B->buf, B->c + 24, B->mlen);
+	if (!br_chachadaence_decrypt_x2(B->k, B->buf, B->mlen, B->a, B->alen,
+		B->c, B->ichacha))
+		errx(1, "beardaence: forgery");
+}
+
+static void
+bear_seal_auto(struct bench *B)
+{
+
+	br_chachadaence_encrypt_auto(B->k, B->c + 24, B->mlen, B->a, B->alen,
+	    B->c);
+}
+
+static void
+bear_open_auto(struct bench *B)
+{
+
+	memcpy(B->buf, B->c + 24, B->mlen);
+	if (!br_chachadaence_decrypt_auto(B->k, B->buf, B->mlen, B->a,
+		B->alen, B->c))
+		errx(1, "beardaence: forgery");
+}
+
+static const struct impl {
+	const char	*name;
+	void		(*seal)(struct bench *);
+	void		(*open)(struct bench *);
+	int		bear;
+	int		sse2;
+} impls[] = {
+	{ "chachadaence", chacha_seal, chacha_open, 0, 0 },
+	{ "salsa20daence", salsa_seal, salsa_open, 0, 0 },
+	{ "tweetdaence", tweet_seal, tweet_open, 0, 0 },
+	{ "bear-ct", bear_seal, bear_open, 1, 0 },
+	{ "bear-sse2", bear_seal, bear_open, 1, 1 },
+	{ "bear-sse2-x2", bear_seal_x2, bear_open_x2, 1, 1 },
+	{ "bear-auto", bear_seal_auto, bear_open_auto, 0, 0 },
+};
+
+static uint64_t
+nsec(void)
+{
+	struct timespec t;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &t) == -1)
+		err(1, "clock_gettime");
+	return (uint64_t)t.tv_sec*1000000000 + t.tv_nsec;
+}
+
+static uint64_t
+cycles(void)
+{
+
+#ifdef HAVE_RDTSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static int
+cmp_u64(const void *va, const void *vb)
+{
+	const uint64_t *a = va, *b = vb;
+
+	return (*a > *b) - (*a < *b);
+}
+
+/*
+ * Time f, returning the median nanoseconds and cycles per call over
+ * nruns runs of iters calls each, where iters is picked so that a run
+ * takes about runnsec.
+ */
+static void
+measure(void (*f)(struct bench *), struct bench *B, unsigned nruns,
+    uint64_t runnsec, unsigned long long *itersp, double *nsp, double *cyp)
+{
+	uint64_t t[NRUNS], cy[NRUNS], t0, c0;
+	unsigned long long iters, i;
+	unsigned r;
+
+	/* Warm up and calibrate.  */
+	for (iters = 1;; iters *= 2) {
+		t0 = nsec();
+		for (i = 0; i < iters; i++)
+			(*f)(B);
+		if (nsec() - t0 >= runnsec/4)
+			break;
+	}
+	iters *= 4;
+
+	for (r = 0; r < nruns; r++) {
+		t0 = nsec();
+		c0 = cycles();
+		for (i = 0; i < iters; i++)
+			(*f)(B);
+		cy[r] = cycles() - c0;
+		t[r] = nsec() - t0;
+	}
+	qsort(t, nruns, sizeof t[0], cmp_u64);
+	qsort(cy, nruns, sizeof cy[0], cmp_u64);
+
+	*itersp = iters;
+	*nsp = (double)t[nruns/2]/iters;
+	*cyp = (double)cy[nruns/2]/iters;
+}
+
+static void
+report(int json, int *first, const char *impl, const char *op,
+    unsigned long long mlen, unsigned long long alen,
+    unsigned long long iters, double ns, double cy)
+{
+
+	if (json) {
+		printf("%s\n  {\"impl\": \"%s\", \"op\": \"%s\","
+		    " \"mlen\": %llu, \"alen\": %llu, \"iters\": %llu,"
+		    " \"ns_per_msg\": %.1f, \"msgs_per_sec\": %.0f",
+		    *first ? "[" : ",", impl, op, mlen, alen, iters,
+		    ns, 1e9/ns);
+#ifdef HAVE_RDTSC
+		printf(", \"cycles_per_msg\": %.1f", cy);
+		if (mlen)
+			printf(", \"cycles_per_byte\": %.3f", cy/mlen);
+#endif
+		printf("}");
+	} else {
+		if (*first) {
+			printf("impl,op,mlen,alen,iters,ns_per_msg,"
+			    "msgs_per_sec,cycles_per_msg,cycles_per_byte\n");
+		}
+		printf("%s,%s,%llu,%llu,%llu,%.1f,%.0f,", impl, op, mlen, alen,
+		    iters, ns, 1e9/ns);
+#ifdef HAVE_RDTSC
+		printf("%.1f,", cy);
+		if (mlen)
+			printf("%.3f", cy/mlen);
+#else
+		printf(",");
+#endif
+		printf("\n");
+	}
+	*first = 0;
+	fflush(stdout);
+}
+
+static void
+report_stats(void)
+{
+	struct daence_stats S;
+	const struct daence_stats_counter *C;
+	unsigned i, j;
+
+	if (!daence_stats_enabled()) {
+		warnx("built without -DDAENCE_STATS, no phase breakdown");
+		return;
+	}
+	daence_stats_snapshot(&S);
+	fprintf(stderr, "%-14s %-9s %12s %16s %16s %10s\n",
+	    "impl", "phase", "calls", "bytes", "cycles", "cyc/call");
+	for (i = 0; i < DAENCE_NIMPL; i++) {
+		for (j = 0; j < DAENCE_NPHASE; j++) {
+			C = &S.c[i][j];
+			if (C->calls == 0)
+				continue;
+			fprintf(stderr, "%-14s %-9s %12llu %16llu %16llu"
+			    " %10.1f\n",
+			    daence_stats_impl_name(i),
+			    daence_stats_phase_name(j),
+			    (unsigned long long)C->calls,
+			    (unsigned long long)C->bytes,
+			    (unsigned long long)C->cycles,
+			    (double)C->cycles/C->calls);
+		}
+	}
+}
+
+static void __attribute__((__noreturn__))
+usage(void)
+{
+
+	fprintf(stderr,
+	    "usage: bench_daence [-jqs] [-m maxmlen] [impl ...]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	static const unsigned long long mlens[] = {
+		0, 1, 16, 64, 128, 256, 1024, 4096, 16384, 65536, 262144,
+		1048576,
+	};
+	static const unsigned long long alens[] = { 0, 16, 256, MAXALEN };
+	static const unsigned long long mlens_quick[] = { 0, 64, 1024, 65536 };
+	static const unsigned long long alens_quick[] = { 0, 256 };
+	const unsigned long long *mlenv = mlens, *alenv = alens;
+	size_t nmlen = sizeof mlens/sizeof mlens[0];
+	size_t nalen = sizeof alens/sizeof alens[0];
+	unsigned long long maxmlen = 1048576, iters, mi, ai;
+	unsigned nruns = NRUNS;
+	uint64_t runnsec = RUNNSEC;
+	const struct impl *I;
+	struct bench B;
+	br_chacha20_run sse2;
+	double ns, cy;
+	char *end;
+	size_t i;
+	int json = 0, stats = 0, first = 1, ch, j;
+
+	while ((ch = getopt(argc, argv, "jm:qs")) != -1) {
+		switch (ch) {
+		case 'j':
+			json = 1;
+			break;
+		case 'm':
+			maxmlen = strtoull(optarg, &end, 0);
+			if (end == optarg || *end != '\0')
+				usage();
+			break;
+		case 'q':
+			mlenv = mlens_quick;
+			nmlen = sizeof mlens_quick/sizeof mlens_quick[0];
+			alenv = alens_quick;
+			nalen = sizeof alens_quick/sizeof alens_quick[0];
+			nruns = NRUNS_QUICK;
+			runnsec = RUNNSEC_QUICK;
+			break;
+		case 's':
+			stats = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	for (j = 0; j < argc; j++) {
+		for (i = 0; i < sizeof impls/sizeof impls[0]; i++) {
+			if (strcmp(argv[j], impls[i].name) == 0)
+				break;
+		}
+		if (i == sizeof impls/sizeof impls[0])
+			errx(1, "unknown implementation: %s", argv[j]);
+	}
+
+	memset(&B, 0, sizeof B);
+	for (i = 0; i < sizeof B.k; i++)
+		B.k[i] = i;
+	if ((B.m = malloc(maxmlen ? maxmlen : 1)) == NULL ||
+	    (B.buf = malloc(maxmlen ? maxmlen : 1)) == NULL ||
+	    (B.c = malloc(24 + maxmlen)) == NULL ||
+	    (B.a = malloc(MAXALEN)) == NULL)
+		err(1, "malloc");
+	memset(B.m, 0x5a, maxmlen);
+	memset(B.a, 0xa5, MAXALEN);
+	crypto_dae_chachadaence_ctx_init(&B.chacha, B.k);
+	crypto_dae_salsa20daence_ctx_init(&B.salsa, B.k);
+	sse2 = br_chacha20_sse2_get();
+
+	for (i = 0; i < sizeof impls/sizeof impls[0]; i++) {
+		I = &impls[i];
+		if (argc) {
+			for (j = 0; j < argc; j++) {
+				if (strcmp(argv[j], I->name) == 0)
+					break;
+			}
+			if (j == argc)
+				continue;
+		}
+		if (I->bear) {
+			if (I->sse2 && sse2 == 0) {
+				warnx("%s: not supported on this CPU",
+				    I->name);
+				continue;
+			}
+			B.ichacha = I->sse2 ? sse2 : br_chacha20_ct_run;
+			B.ipoly1305 = br_poly1305_ctmul_run;
+		}
+		for (ai = 0; ai < nalen; ai++) {
+			for (mi = 0; mi < nmlen; mi++) {
+				if (mlenv[mi] > maxmlen)
+					continue;
+				B.mlen = mlenv[mi];
+				B.alen = alenv[ai];
+				measure(I->seal, &B, nruns, runnsec,
+				    &iters, &ns, &cy);
+				report(json, &first, I->name, "seal",
+				    B.mlen, B.alen, iters, ns, cy);
+				measure(I->open, &B, nruns, runnsec,
+				    &iters, &ns, &cy);
+				report(json, &first, I->name, "open",
+				    B.mlen, B.alen, iters, ns, cy);
+			}
+		}
+	}
+	if (json)
+		printf("%s\n", first ? "[]" : "\n]");
+	if (stats)
+		report_stats();
+
+	crypto_dae_salsa20daence_ctx_destroy(&B.salsa);
+	crypto_dae_chachadaence_ctx_destroy(&B.chacha);
+	free(B.a);
+	free(B.c);
+	free(B.buf);
+	free(B.m);
+	return 0;
+}
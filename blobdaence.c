@@ -0,0 +1,754 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#define	_POSIX_C_SOURCE	200809L
+
+#include "blobdaence.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chachadaence.h"
+
+#define	BLOB_PACKMAX	(1ull << 30)	/* default packfile size limit */
+#define	BLOB_MAXMLEN	(1ull << 38)	/* Daence message limit */
+#define	BLOB_MINCAP	1024		/* initial index slots */
+#define	RECHDR		32		/* le64(mlen) || tag */
+
+/*
+ * Index file: a 64-byte header
+ *
+ *	magic[16] || le64(cap) || le64(count) || le64(pack) || le64(end)
+ *	|| 0^16,
+ *
+ * where every record in packfiles before pack, and in pack before
+ * offset end, is in the table, and count is the number of slots for
+ * those records; then cap 48-byte slots
+ *
+ *	tag[24] || le64(pack + 1) || le64(off) || le64(mlen),
+ *
+ * empty if pack + 1 is zero.  cap is a power of two, and a tag's first
+ * slot is its first eight bytes mod cap -- tags are uniform, so no
+ * further hashing is needed -- probing linearly from there.
+ *
+ * Slots are filled in place as blobs are put, but the header is only
+ * rewritten by idx_publish, after the packfiles and the slots have
+ * reached stable storage.  After a crash, slots may have been written
+ * back for records past the recorded end, some of which may never have
+ * made it to the packfile; idx_check finds those.
+ */
+#define	IDX_HDRBYTES	64
+#define	IDX_SLOTBYTES	48
+
+static const char idx_magic[16] = "daence blob idx";
+
+struct crypto_dae_blob {
+	const struct crypto_dae_chachadaence_ctx *ctx;
+	int			dirfd;
+	unsigned long long	packmax;
+	int			idxfd;
+	unsigned char		*idx;		/* mapped index file */
+	size_t			idxsize;
+	unsigned long long	cap;		/* slots in the index */
+	unsigned long long	pack;		/* packfile being appended */
+	unsigned long long	end;		/* ... and its length */
+	int			*packfd;	/* -1 if not yet open */
+	unsigned long long	npackfd;
+	struct crypto_dae_blob_stats stats;
+};
+
+static inline void
+le64enc(void *buf, uint64_t v)
+{
+	unsigned char *p = buf;
+	unsigned i;
+
+	for (i = 0; i < 8; i++)
+		p[i] = v >> (8*i);
+}
+
+static inline uint64_t
+le64dec(const void *buf)
+{
+	const unsigned char *p = buf;
+	uint64_t v = 0;
+	unsigned i;
+
+	for (i = 0; i < 8; i++)
+		v |= (uint64_t)p[i] << (8*i);
+	return v;
+}
+
+static int
+preadall(int fd, void *buf, size_t n, off_t off)
+{
+	unsigned char *p = buf;
+	ssize_t k;
+
+	while (n) {
+		if ((k = pread(fd, p, n, off)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (k == 0) {
+			errno = EIO;	/* file shrank under us */
+			return -1;
+		}
+		p += k;
+		n -= k;
+		off += k;
+	}
+	return 0;
+}
+
+static int
+pwriteall(int fd, const void *buf, size_t n, off_t off)
+{
+	const unsigned char *p = buf;
+	ssize_t k;
+
+	while (n) {
+		if ((k = pwrite(fd, p, n, off)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += k;
+		n -= k;
+		off += k;
+	}
+	return 0;
+}
+
+/*
+ * Return the descriptor for packfile n, opening it if need be.  Unless
+ * create is set, fail with ENOENT if it does not exist.
+ */
+static int
+packfd(struct crypto_dae_blob *B, unsigned long long n, int create)
+{
+	char name[32];
+	int *fds;
+	unsigned long long i;
+
+	if (n >= B->npackfd) {
+		if (n >= SIZE_MAX/sizeof fds[0] - 1) {
+			errno = ENOMEM;
+			return -1;
+		}
+		fds = realloc(B->packfd, (n + 1)*sizeof fds[0]);
+		if (fds == NULL)
+			return -1;
+		for (i = B->npackfd; i <= n; i++)
+			fds[i] = -1;
+		B->packfd = fds;
+		B->npackfd = n + 1;
+	}
+	if (B->packfd[n] == -1) {
+		snprintf(name, sizeof name, "pack-%06llu", n);
+		B->packfd[n] = openat(B->dirfd, name,
+		    O_RDWR | (create ? O_CREAT : 0), 0600);
+	}
+	return B->packfd[n];
+}
+
+static unsigned char *
+slot(const struct crypto_dae_blob *B, unsigned long long i)
+{
+
+	return B->idx + IDX_HDRBYTES + i*IDX_SLOTBYTES;
+}
+
+/*
+ * Find the slot holding tag, or the empty slot where it would go.  Tags
+ * are public, so there is no need to compare them in constant time.
+ * Returns NULL with errno set to EIO if every slot is taken, which only
+ * a damaged index allows.
+ */
+static unsigned char *
+lookup(const struct crypto_dae_blob *B, const unsigned char tag[static 24])
+{
+	unsigned long long i = le64dec(tag), n;
+	unsigned char *s;
+
+	for (n = 0; n < B->cap; n++, i++) {
+		s = slot(B, i & (B->cap - 1));
+		if (le64dec(s + 24) == 0 || memcmp(s, tag, 24) == 0)
+			return s;
+	}
+	errno = EIO;
+	return NULL;
+}
+
+static void
+idx_setpos(struct crypto_dae_blob *B)
+{
+
+	le64enc(B->idx + 32, B->pack);
+	le64enc(B->idx + 40, B->end);
+}
+
+static void
+idx_unmap(struct crypto_dae_blob *B)
+{
+
+	if (B->idx)
+		(void)munmap(B->idx, B->idxsize);
+	if (B->idxfd != -1)
+		(void)close(B->idxfd);
+	B->idx = NULL;
+	B->idxfd = -1;
+}
+
+/*
+ * Map the index file already open on fd, and check that it is sane.
+ */
+static int
+idx_map(struct crypto_dae_blob *B, int fd)
+{
+	struct stat st;
+	unsigned char *p;
+	unsigned long long cap, count;
+
+	if (fstat(fd, &st) == -1)
+		return -1;
+	if (st.st_size < IDX_HDRBYTES)
+		goto bad;
+	p = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		return -1;
+	cap = le64dec(p + 16);
+	count = le64dec(p + 24);
+	if (memcmp(p, idx_magic, 16) != 0 ||
+	    cap < BLOB_MINCAP || (cap & (cap - 1)) != 0 ||
+	    cap > ((unsigned long long)st.st_size - IDX_HDRBYTES)/
+		IDX_SLOTBYTES ||
+	    (unsigned long long)st.st_size !=
+		IDX_HDRBYTES + cap*IDX_SLOTBYTES ||
+	    count >= cap) {
+		(void)munmap(p, st.st_size);
+		goto bad;
+	}
+
+	B->idxfd = fd;
+	B->idx = p;
+	B->idxsize = st.st_size;
+	B->cap = cap;
+	B->stats.nblobs = count;
+	B->pack = le64dec(p + 32);
+	B->end = le64dec(p + 40);
+	return 0;
+
+bad:	errno = EINVAL;
+	return -1;
+}
+
+/*
+ * Check the slots of a freshly mapped index against its header and the
+ * packfiles: the slots for records before the recorded end must number
+ * exactly count, and any others must match a whole record in their
+ * packfile.  Sets the blob count from the slots.  Returns 0, or -1 with
+ * errno set to EINVAL if the index is damaged or out of date.
+ */
+static int
+idx_check(struct crypto_dae_blob *B)
+{
+	unsigned char hdr[RECHDR], *s;
+	struct stat st;
+	unsigned long long i, pack, off, mlen, nold = 0, n = 0;
+	int fd;
+
+	for (i = 0; i < B->cap; i++) {
+		s = slot(B, i);
+		if ((pack = le64dec(s + 24)) == 0)
+			continue;
+		pack--;
+		off = le64dec(s + 32);
+		mlen = le64dec(s + 40);
+		if (mlen > BLOB_MAXMLEN || off > UINT64_MAX - RECHDR - mlen)
+			goto bad;
+		n++;
+		if (pack < B->pack ||
+		    (pack == B->pack && off + RECHDR + mlen <= B->end)) {
+			nold++;
+			continue;
+		}
+
+		/* Written back ahead of the header: is the record there?  */
+		if ((fd = packfd(B, pack, 0)) == -1 || fstat(fd, &st) == -1 ||
+		    off + RECHDR + mlen > (unsigned long long)st.st_size ||
+		    preadall(fd, hdr, RECHDR, off) == -1 ||
+		    le64dec(hdr) != mlen || memcmp(hdr + 8, s, 24) != 0)
+			goto bad;
+	}
+	if (nold != le64dec(B->idx + 24) || 4*n > 3*B->cap)
+		goto bad;
+
+	B->stats.nblobs = n;
+	return 0;
+
+bad:	errno = EINVAL;
+	return -1;
+}
+
+/*
+ * Create an empty index with cap slots in the file name, replacing
+ * whatever was there, and return its descriptor.
+ */
+static int
+idx_create(struct crypto_dae_blob *B, const char *name,
+    unsigned long long cap)
+{
+	unsigned char hdr[IDX_HDRBYTES] = {0};
+	int fd;
+
+	fd = openat(B->dirfd, name, O_RDWR|O_CREAT|O_TRUNC, 0600);
+	if (fd == -1)
+		return -1;
+	memcpy(hdr, idx_magic, 16);
+	le64enc(hdr + 16, cap);
+	if (ftruncate(fd, IDX_HDRBYTES + cap*IDX_SLOTBYTES) == -1 ||
+	    pwriteall(fd, hdr, sizeof hdr, 0) == -1) {
+		(void)close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Flush the packfiles from the index's recorded one through B->pack,
+ * and the directory, to stable storage.
+ */
+static int
+pack_sync(struct crypto_dae_blob *B)
+{
+	unsigned long long n;
+	int fd;
+
+	for (n = le64dec(B->idx + 32); n <= B->pack; n++) {
+		if ((fd = packfd(B, n, 0)) == -1) {
+			if (errno == ENOENT)
+				continue;	/* empty store */
+			return -1;
+		}
+		if (fdatasync(fd) == -1)
+			return -1;
+	}
+	if (fsync(B->dirfd) == -1 && errno != EINVAL)
+		return -1;
+	return 0;
+}
+
+/*
+ * Record B->pack, B->end, and the blob count in the index header, once
+ * everything they describe is on stable storage: first the packfiles,
+ * then the slots, and only then the header, which fits in one sector.
+ */
+static int
+idx_publish(struct crypto_dae_blob *B)
+{
+
+	if (pack_sync(B) == -1 ||
+	    msync(B->idx, B->idxsize, MS_SYNC) == -1)
+		return -1;
+	le64enc(B->idx + 24, B->stats.nblobs);
+	idx_setpos(B);
+	return msync(B->idx, IDX_HDRBYTES, MS_SYNC);
+}
+
+/*
+ * Double the index: fill a new one in index.tmp, then rename it over
+ * the old.  A crash in between leaves the old index, which is still
+ * good up to its recorded end.  The new one records B->pack, B->end,
+ * so the packfiles are flushed through there first.
+ */
+static int
+idx_grow(struct crypto_dae_blob *B)
+{
+	struct crypto_dae_blob N = *B;
+	unsigned long long i;
+	unsigned char *s;
+	int fd;
+
+	if (pack_sync(B) == -1)
+		return -1;
+	if ((fd = idx_create(B, "index.tmp", 2*B->cap)) == -1)
+		return -1;
+	N.idx = NULL;
+	N.idxfd = -1;
+	if (idx_map(&N, fd) == -1) {
+		(void)close(fd);
+		return -1;
+	}
+	for (i = 0; i < B->cap; i++) {
+		s = slot(B, i);
+		if (le64dec(s + 24) != 0)
+			memcpy(lookup(&N, s), s, IDX_SLOTBYTES);
+	}
+	le64enc(N.idx + 24, B->stats.nblobs);
+	N.pack = B->pack;
+	N.end = B->end;
+	idx_setpos(&N);
+	if (msync(N.idx, N.idxsize, MS_SYNC) == -1 ||
+	    renameat(B->dirfd, "index.tmp", B->dirfd, "index") == -1) {
+		idx_unmap(&N);
+		return -1;
+	}
+	(void)fsync(B->dirfd);
+
+	idx_unmap(B);
+	B->idxfd = N.idxfd;
+	B->idx = N.idx;
+	B->idxsize = N.idxsize;
+	B->cap = N.cap;
+	return 0;
+}
+
+/*
+ * Make room for one more slot.  Keep the load below 3/4 so probes stay
+ * short.  Growing writes out an index whose recorded end is B->pack,
+ * B->end, so callers must do this before appending anything past it.
+ */
+static int
+idx_reserve(struct crypto_dae_blob *B)
+{
+
+	if (4*(B->stats.nblobs + 1) > 3*B->cap)
+		return idx_grow(B);
+	return 0;
+}
+
+/*
+ * Record that the blob with tag lives at off in packfile pack, unless
+ * it is already recorded (which can happen if a crash lost an index
+ * update and the blob was put again).  Room must have been made with
+ * idx_reserve.  Returns 0, or -1 if the index is damaged.
+ */
+static int
+idx_insert(struct crypto_dae_blob *B, const unsigned char tag[static 24],
+    unsigned long long pack, unsigned long long off, unsigned long long mlen)
+{
+	unsigned char *s;
+
+	if ((s = lookup(B, tag)) == NULL)
+		return -1;
+	if (le64dec(s + 24) != 0)
+		return 0;
+	memcpy(s, tag, 24);
+	le64enc(s + 32, off);
+	le64enc(s + 40, mlen);
+	le64enc(s + 24, pack + 1);
+	B->stats.nblobs++;
+	return 0;
+}
+
+/*
+ * Index the records of packfile n from offset off onward, making it
+ * the one being appended.  If the last record is torn, cut it off.
+ * B->end follows along, so it never passes a record not yet indexed.
+ * Returns 0, or -1 if the packfile cannot be read -- with errno ENOENT
+ * if it does not exist.
+ */
+static int
+scan(struct crypto_dae_blob *B, unsigned long long n, unsigned long long off)
+{
+	unsigned char hdr[RECHDR];
+	struct stat st;
+	unsigned long long size, mlen;
+	int fd;
+
+	if ((fd = packfd(B, n, 0)) == -1 || fstat(fd, &st) == -1)
+		return -1;
+	size = st.st_size;
+	if (off > size) {
+		errno = EINVAL;	/* index is ahead of the packfile */
+		return -1;
+	}
+	B->pack = n;
+	B->end = off;
+	while (size - off >= RECHDR) {
+		if (preadall(fd, hdr, RECHDR, off) == -1)
+			return -1;
+		mlen = le64dec(hdr);
+		if (mlen > size - off - RECHDR)
+			break;
+		if (idx_reserve(B) == -1 ||
+		    idx_insert(B, hdr + 8, n, off, mlen) == -1)
+			return -1;
+		B->end = off += RECHDR + mlen;
+	}
+	if (off < size && ftruncate(fd, off) == -1)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Bring the index up to date from B->pack, B->end onward, through
+ * every later packfile that exists.
+ */
+static int
+catchup(struct crypto_dae_blob *B)
+{
+
+	if (scan(B, B->pack, B->end) == -1 &&
+	    (errno != ENOENT || B->end != 0))
+		return -1;	/* ENOENT at 0: no packfiles yet */
+	while (scan(B, B->pack + 1, 0) == 0)
+		continue;
+	if (errno != ENOENT)
+		return -1;
+
+	return 0;
+}
+
+struct crypto_dae_blob *
+crypto_dae_blob_open(const char *dir, unsigned long long packmax,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	struct crypto_dae_blob *B;
+	int fd, error;
+
+	if ((B = calloc(1, sizeof *B)) == NULL)
+		return NULL;
+	B->ctx = ctx;
+	B->packmax = (packmax ? packmax : BLOB_PACKMAX);
+	B->idxfd = -1;
+	if ((B->dirfd = open(dir, O_RDONLY|O_DIRECTORY)) == -1)
+		goto fail;
+
+	/* Use the index if it is good and agrees with the packfiles.  */
+	if ((fd = openat(B->dirfd, "index", O_RDWR)) != -1) {
+		if (idx_map(B, fd) == 0 && idx_check(B) == 0 &&
+		    catchup(B) == 0)
+			goto good;
+		if (B->idx == NULL)
+			(void)close(fd);
+		idx_unmap(B);
+	}
+
+	/* Otherwise rebuild it from scratch.  */
+	if ((fd = idx_create(B, "index", BLOB_MINCAP)) == -1)
+		goto fail;
+	if (idx_map(B, fd) == -1) {
+		(void)close(fd);
+		goto fail;
+	}
+	B->pack = B->end = 0;
+	if (catchup(B) == -1)
+		goto fail;
+
+	/* Record anything catchup found.  */
+good:	if ((le64dec(B->idx + 24) != B->stats.nblobs ||
+		le64dec(B->idx + 32) != B->pack ||
+		le64dec(B->idx + 40) != B->end) &&
+	    idx_publish(B) == -1)
+		goto fail;
+	return B;
+
+fail:	error = errno;
+	(void)crypto_dae_blob_close(B);
+	errno = error;
+	return NULL;
+}
+
+int
+crypto_dae_blob_sync(struct crypto_dae_blob *B)
+{
+
+	if (B->idx == NULL)
+		return 0;
+	return idx_publish(B);
+}
+
+int
+crypto_dae_blob_close(struct crypto_dae_blob *B)
+{
+	unsigned long long i;
+	int ret = 0;
+
+	if (B->dirfd != -1)
+		ret = crypto_dae_blob_sync(B);
+	idx_unmap(B);
+	for (i = 0; i < B->npackfd; i++) {
+		if (B->packfd[i] != -1)
+			(void)close(B->packfd[i]);
+	}
+	free(B->packfd);
+	if (B->dirfd != -1)
+		(void)close(B->dirfd);
+	free(B);
+
+	return ret;
+}
+
+int
+crypto_dae_blob_put(struct crypto_dae_blob *B,
+    unsigned char tag[static crypto_dae_chachadaence_TAGBYTES],
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen)
+{
+	unsigned char hdr[RECHDR], *c, *s;
+	unsigned long long pack, off;
+	int fd, ret = -1;
+
+	if (mlen > BLOB_MAXMLEN || mlen > SIZE_MAX - 1) {
+		errno = EFBIG;
+		return -1;
+	}
+
+	/*
+	 * Probe by tag before encrypting: a duplicate costs only the
+	 * hash, with no buffer and no stream cipher.  A new blob is
+	 * hashed a second time by the seal below, which is the price
+	 * of not running the stream for every duplicate.
+	 */
+	crypto_dae_chachadaence_ctx_tag(tag, m, mlen, a, alen, B->ctx);
+	B->stats.puts++;
+	B->stats.bytes_in += mlen;
+	if ((s = lookup(B, tag)) == NULL)
+		return -1;
+	if (le64dec(s + 24) != 0) {
+		B->stats.dups++;
+		return 0;
+	}
+
+	/*
+	 * Grow the index, if need be, before appending: the grown
+	 * index records B->pack, B->end as its end, which must not yet
+	 * cover a record it lacks.
+	 */
+	if (idx_reserve(B) == -1)
+		return -1;
+
+	if ((c = malloc(mlen ? mlen : 1)) == NULL)
+		return -1;
+	crypto_dae_chachadaence_ctx_encrypt_detached(c, tag, m, mlen, a, alen,
+	    B->ctx);
+
+	/*
+	 * Start a new packfile if this one is full.  It may already be
+	 * past packmax, after a blob bigger than packmax or on reopening
+	 * with a smaller packmax.
+	 */
+	pack = B->pack;
+	off = B->end;
+	if (off && (off >= B->packmax || RECHDR + mlen > B->packmax - off)) {
+		pack++;
+		off = 0;
+	}
+	if ((fd = packfd(B, pack, 1)) == -1)
+		goto out;
+
+	/*
+	 * Append the record first, then index it, and only then move
+	 * the end past it.  The end reaches the index header only at
+	 * the next sync; a crash before then leaves it behind the
+	 * record, and the next open picks it up.  On failure, nothing
+	 * past the end survives.
+	 */
+	le64enc(hdr, mlen);
+	memcpy(hdr + 8, tag, 24);
+	if (pwriteall(fd, hdr, RECHDR, off) == -1 ||
+	    pwriteall(fd, c, mlen, off + RECHDR) == -1 ||
+	    idx_insert(B, tag, pack, off, mlen) == -1) {
+		(void)ftruncate(fd, off);
+		goto out;
+	}
+	B->pack = pack;
+	B->end = off + RECHDR + mlen;
+	B->stats.bytes_stored += RECHDR + mlen;
+	ret = 1;
+
+out:	free(c);
+	return ret;
+}
+
+int
+crypto_dae_blob_size(const struct crypto_dae_blob *B,
+    const unsigned char tag[static crypto_dae_chachadaence_TAGBYTES],
+    unsigned long long *mlen)
+{
+	const unsigned char *s;
+
+	if ((s = lookup(B, tag)) == NULL)
+		return -1;
+	if (le64dec(s + 24) == 0) {
+		errno = ENOENT;
+		return -1;
+	}
+	*mlen = le64dec(s + 40);
+	return 0;
+}
+
+int
+crypto_dae_blob_get(struct crypto_dae_blob *B, unsigned char *m,
+    const unsigned char tag[static crypto_dae_chachadaence_TAGBYTES],
+    const unsigned char *a, unsigned long long alen)
+{
+	const unsigned char *s;
+	unsigned long long pack, off, mlen;
+	int fd;
+
+	if ((s = lookup(B, tag)) == NULL)
+		return -1;
+	if ((pack = le64dec(s + 24)) == 0) {
+		errno = ENOENT;
+		return -1;
+	}
+	pack--;
+	off = le64dec(s + 32);
+	mlen = le64dec(s + 40);
+
+	/* Read the ciphertext right into m and open it in place.  */
+	if ((fd = packfd(B, pack, 0)) == -1 ||
+	    preadall(fd, m, mlen, off + RECHDR) == -1)
+		return -1;
+	if (crypto_dae_chachadaence_ctx_open_detached(m, m, mlen, tag, a, alen,
+		B->ctx)) {
+		errno = EBADMSG;
+		return -1;
+	}
+	return 0;
+}
+
+void
+crypto_dae_blob_stats(const struct crypto_dae_blob *B,
+    struct crypto_dae_blob_stats *S)
+{
+
+	*S = B->stats;
+	S->npacks = (B->pack || B->end ? B->pack + 1 : 0);
+}
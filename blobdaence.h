@@ -0,0 +1,123 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef BLOBDAENCE_H
+#define	BLOBDAENCE_H
+
+#include "chachadaence.h"
+
+/*
+ * Content-addressed blob store.  Daence is deterministic, so the 24-byte
+ * tag of a blob sealed with ChaCha-Daence under a fixed key is a name
+ * for its (header, payload) pair: storing the same pair twice gives the
+ * same tag, and the second copy need not be written at all.
+ *
+ * A store is a directory holding append-only packfiles pack-000000,
+ * pack-000001, ..., each a sequence of records
+ *
+ *	le64(mlen) || tag || ciphertext[0..mlen],
+ *
+ * and a file index, an open-addressing hash table from tag to the
+ * record's packfile and offset, mapped into memory.  The index is only
+ * a cache of what is in the packfiles.  crypto_dae_blob_sync brings it
+ * up to date on disk, after the packfiles; records appended since, e.g.
+ * before a crash, are picked up on open.  If the index is missing, or
+ * its slots disagree with its header or the packfiles, it is rebuilt
+ * by scanning them.  A torn record at the end of the last packfile is
+ * cut off.
+ *
+ * The tags are not secret, but they do reveal which blobs are equal.
+ * The header a is not stored; it must be presented again to get a blob
+ * back.  Not thread-safe.
+ */
+
+struct crypto_dae_blob;
+
+/*
+ * nblobs and npacks describe the whole store; the rest count only
+ * since it was opened.
+ */
+struct crypto_dae_blob_stats {
+	unsigned long long	nblobs;		/* distinct blobs stored */
+	unsigned long long	npacks;		/* packfiles */
+	unsigned long long	puts;		/* calls to _put */
+	unsigned long long	dups;		/* ... that found a copy */
+	unsigned long long	bytes_in;	/* payload bytes put */
+	unsigned long long	bytes_stored;	/* record bytes written */
+};
+
+/*
+ * Open or create the store in the directory dir, which must exist.  A
+ * packfile is closed to appends once it reaches packmax bytes; 0 means
+ * 1 GiB.  ctx must outlive the store, and must be the same key every
+ * time the store is opened.  Returns NULL and sets errno on failure.
+ */
+struct crypto_dae_blob *crypto_dae_blob_open(const char */*dir*/,
+    unsigned long long /*packmax*/,
+    const struct crypto_dae_chachadaence_ctx *);
+
+/*
+ * Flush the packfiles, then the index, to stable storage, and close the
+ * store.
+ * crypto_dae_blob_close returns 0, or -1 with errno set if flushing
+ * failed; the store is closed either way.
+ */
+int crypto_dae_blob_sync(struct crypto_dae_blob *);
+int crypto_dae_blob_close(struct crypto_dae_blob *);
+
+/*
+ * Seal m[0..mlen] with header a[0..alen], set tag to its address, and
+ * store it unless it is already there.  Returns 1 if it was stored, 0
+ * if it was a duplicate, or -1 with errno set on failure.
+ */
+int crypto_dae_blob_put(struct crypto_dae_blob *,
+    unsigned char[static crypto_dae_chachadaence_TAGBYTES],
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/);
+
+/*
+ * Look up the payload length of the blob with the given tag.  Returns
+ * 0, or -1 with errno set to ENOENT if there is no such blob.
+ */
+int crypto_dae_blob_size(const struct crypto_dae_blob *,
+    const unsigned char[static crypto_dae_chachadaence_TAGBYTES],
+    unsigned long long */*mlen*/);
+
+/*
+ * Read the blob with the given tag into m[0..mlen], where mlen is as
+ * crypto_dae_blob_size reports, and authenticate it with header a.
+ * Returns 0, or -1 with errno set: ENOENT if there is no such blob,
+ * EBADMSG if it is a forgery or a was wrong (and m is zeroed), or
+ * whatever the I/O failed with.
+ */
+int crypto_dae_blob_get(struct crypto_dae_blob *, unsigned char */*m*/,
+    const unsigned char[static crypto_dae_chachadaence_TAGBYTES],
+    const unsigned char */*a*/, unsigned long long /*alen*/);
+
+void crypto_dae_blob_stats(const struct crypto_dae_blob *,
+    struct crypto_dae_blob_stats *);
+
+#endif	/* BLOBDAENCE_H */
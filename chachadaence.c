@@ -46,14 +46,51 @@
 #include <string.h>
 
 #include <sodium/crypto_core_hchacha20.h>
-#include <sodium/crypto_onetimeauth_poly1305.h>
+#include <sodium/crypto_stream_chacha20.h>
 #include <sodium/crypto_stream_xchacha20.h>
 #include <sodium/crypto_verify_32.h>
 
+#include "daence_chunk.h"
+#include "daence_stats.h"
+#include "poly1305x2.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define	CHACHADAENCE_AVX2
+#include <immintrin.h>
+#endif
+
+#define	BATCH	8		/* messages per batch group */
+#define	TILE	4096		/* bytes per fused decrypt/MAC tile */
+
 static void *(*volatile explicit_memset)(void *, int, size_t) = memset;
 
 static const unsigned char sigma[16] = "expand 32-byte k";
 
+static inline uint32_t
+le32dec(const void *buf)
+{
+	const unsigned char *p = buf;
+	uint32_t v = 0;
+
+	v |= (uint32_t)p[0] << 0;
+	v |= (uint32_t)p[1] << 8;
+	v |= (uint32_t)p[2] << 16;
+	v |= (uint32_t)p[3] << 24;
+
+	return v;
+}
+
+static inline void
+le32enc(void *buf, uint32_t v)
+{
+	unsigned char *p = buf;
+
+	p[0] = v >> 0;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
 static void
 le64enc(void *buf, uint64_t v)
 {
@@ -69,101 +106,923 @@ le64enc(void *buf, uint64_t v)
 	*p++ = v & 0xff;
 }
 
+/* Absorb the padding of pad0(a), once all alen bytes of a are in.  */
 static void
-poly1305ad(unsigned char h[static 16],
-    const unsigned char *m, unsigned long long mlen,
+poly1305x2ad_pad(struct poly1305x2 *poly1305, unsigned long long alen)
+{
+	static const unsigned char z[16] = {0};
+
+	poly1305x2_update(poly1305, z, (0x10 - alen) & 0xf);
+}
+
+/*
+ * Begin h_i := Poly1305_{k_i,0}(pad0(a) || pad0(m) || |a|_8 || |m|_8)
+ * for i = 1, 2: absorb pad0(a).  The caller then feeds m in as many
+ * pieces as it likes before poly1305x2ad_final.
+ */
+static void
+poly1305x2ad_init(struct poly1305x2 *poly1305,
     const unsigned char *a, unsigned long long alen,
-    const unsigned char k[static 16])
+    const struct poly1305x2_key *k12)
+{
+
+	poly1305x2_init(poly1305, k12);
+	poly1305x2_update(poly1305, a, alen);
+	poly1305x2ad_pad(poly1305, alen);
+}
+
+/* Finish: absorb the rest of pad0(m) and |a|_8 || |m|_8.  */
+static void
+poly1305x2ad_final(struct poly1305x2 *poly1305,
+    unsigned char h1[static 16], unsigned char h2[static 16],
+    unsigned long long mlen, unsigned long long alen)
 {
 	static const unsigned char z[16] = {0};
 	unsigned char len64le[16];
-	crypto_onetimeauth_poly1305_state poly1305;
-	unsigned char k_[32];
-
-	/* Poly1305: Set evaluation point; zero addend. */
-	memcpy(k_, k, 16);
-	memset(k_ + 16, 0, 16);
-
-	/* Set h := Poly1305_k(pad0(a) || pad0(m) || |a|_8 || |m|_8). */
-	crypto_onetimeauth_poly1305_init(&poly1305, k_);
-	crypto_onetimeauth_poly1305_update(&poly1305, a, alen);
-	crypto_onetimeauth_poly1305_update(&poly1305, z, (0x10 - alen) & 0xf);
-	crypto_onetimeauth_poly1305_update(&poly1305, m, mlen);
-	crypto_onetimeauth_poly1305_update(&poly1305, z, (0x10 - mlen) & 0xf);
+
+	poly1305x2_update(poly1305, z, (0x10 - mlen) & 0xf);
 	le64enc(&len64le[0], alen);
 	le64enc(&len64le[8], mlen);
-	crypto_onetimeauth_poly1305_update(&poly1305, len64le, 16);
-	crypto_onetimeauth_poly1305_final(&poly1305, h);
+	poly1305x2_update(poly1305, len64le, 16);
+	poly1305x2_final(poly1305, h1, h2);
+}
+
+static void
+poly1305x2ad(unsigned char h1[static 16], unsigned char h2[static 16],
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct poly1305x2_key *k12)
+{
+	struct poly1305x2 poly1305;
+
+	/*
+	 * Set h_i := Poly1305_{k_i,0}(pad0(a) || pad0(m) || |a|_8 || |m|_8)
+	 * for i = 1, 2, reading a and m only once.
+	 */
+	poly1305x2ad_init(&poly1305, a, alen, k12);
+	poly1305x2_update(&poly1305, m, mlen);
+	poly1305x2ad_final(&poly1305, h1, h2, mlen, alen);
+}
+
+/*
+ * HChaCha on up to BATCH independent (key, input) pairs at once, for
+ * the batch API.  out[i] may alias key[i] or in[i].
+ */
+
+static void
+hchacha20_lanes_load(uint32_t x[static 16][BATCH], unsigned n,
+    const unsigned char *const in[static BATCH],
+    const unsigned char *const key[static BATCH])
+{
+	unsigned i, j;
+
+	for (j = 0; j < BATCH; j++) {
+		for (i = 0; i < 4; i++)
+			x[i][j] = le32dec(sigma + 4*i);
+		for (i = 0; i < 8; i++)
+			x[4 + i][j] = j < n ? le32dec(key[j] + 4*i) : 0;
+		for (i = 0; i < 4; i++)
+			x[12 + i][j] = j < n ? le32dec(in[j] + 4*i) : 0;
+	}
+}
+
+static void
+hchacha20_lanes_store(unsigned char *const out[static BATCH], unsigned n,
+    const uint32_t x[static 16][BATCH])
+{
+	unsigned i, j;
+
+	for (j = 0; j < n; j++) {
+		for (i = 0; i < 4; i++)
+			le32enc(out[j] + 4*i, x[i][j]);
+		for (i = 0; i < 4; i++)
+			le32enc(out[j] + 16 + 4*i, x[12 + i][j]);
+	}
+}
+
+#define	ROTL32(x, c)	(((x) << (c)) | ((x) >> (32 - (c))))
+
+static inline void
+quarterround_lanes(uint32_t a[static BATCH], uint32_t b[static BATCH],
+    uint32_t c[static BATCH], uint32_t d[static BATCH])
+{
+	unsigned j;
+
+	for (j = 0; j < BATCH; j++) {
+		a[j] += b[j]; d[j] ^= a[j]; d[j] = ROTL32(d[j], 16);
+		c[j] += d[j]; b[j] ^= c[j]; b[j] = ROTL32(b[j], 12);
+		a[j] += b[j]; d[j] ^= a[j]; d[j] = ROTL32(d[j], 8);
+		c[j] += d[j]; b[j] ^= c[j]; b[j] = ROTL32(b[j], 7);
+	}
+}
+
+static void
+hchacha20_lanes_portable(unsigned n, unsigned char *const out[static BATCH],
+    const unsigned char *const in[static BATCH],
+    const unsigned char *const key[static BATCH])
+{
+	uint32_t x[16][BATCH];
+	unsigned r;
+
+	hchacha20_lanes_load(x, n, in, key);
+	for (r = 0; r < 20; r += 2) {
+		quarterround_lanes(x[0], x[4], x[ 8], x[12]);
+		quarterround_lanes(x[1], x[5], x[ 9], x[13]);
+		quarterround_lanes(x[2], x[6], x[10], x[14]);
+		quarterround_lanes(x[3], x[7], x[11], x[15]);
+		quarterround_lanes(x[0], x[5], x[10], x[15]);
+		quarterround_lanes(x[1], x[6], x[11], x[12]);
+		quarterround_lanes(x[2], x[7], x[ 8], x[13]);
+		quarterround_lanes(x[3], x[4], x[ 9], x[14]);
+	}
+	hchacha20_lanes_store(out, n, x);
+
+	explicit_memset(x, 0, sizeof x);
+}
+
+#ifdef CHACHADAENCE_AVX2
 
-	explicit_memset(&poly1305, 0, sizeof poly1305);
-	explicit_memset(k_, 0, sizeof k_);
+/* AVX2: one 32-bit lane per message, BATCH = 8 lanes per register.  */
+
+#define	AVX2	__attribute__((__target__("avx2")))
+
+static AVX2 inline __m256i
+avx2_rotl(__m256i x, unsigned c)
+{
+	const __m256i rot16 = _mm256_set_epi8(
+		13,12,15,14, 9,8,11,10, 5,4,7,6, 1,0,3,2,
+		13,12,15,14, 9,8,11,10, 5,4,7,6, 1,0,3,2);
+	const __m256i rot8 = _mm256_set_epi8(
+		14,13,12,15, 10,9,8,11, 6,5,4,7, 2,1,0,3,
+		14,13,12,15, 10,9,8,11, 6,5,4,7, 2,1,0,3);
+
+	switch (c) {
+	case 16:
+		return _mm256_shuffle_epi8(x, rot16);
+	case 8:
+		return _mm256_shuffle_epi8(x, rot8);
+	default:
+		return _mm256_or_si256(_mm256_slli_epi32(x, c),
+		    _mm256_srli_epi32(x, 32 - c));
+	}
+}
+
+static AVX2 inline void
+avx2_quarterround(__m256i *a, __m256i *b, __m256i *c, __m256i *d)
+{
+
+	*a = _mm256_add_epi32(*a, *b);
+	*d = avx2_rotl(_mm256_xor_si256(*d, *a), 16);
+	*c = _mm256_add_epi32(*c, *d);
+	*b = avx2_rotl(_mm256_xor_si256(*b, *c), 12);
+	*a = _mm256_add_epi32(*a, *b);
+	*d = avx2_rotl(_mm256_xor_si256(*d, *a), 8);
+	*c = _mm256_add_epi32(*c, *d);
+	*b = avx2_rotl(_mm256_xor_si256(*b, *c), 7);
+}
+
+static AVX2 void
+hchacha20_lanes_avx2(unsigned n, unsigned char *const out[static BATCH],
+    const unsigned char *const in[static BATCH],
+    const unsigned char *const key[static BATCH])
+{
+	uint32_t x[16][BATCH];
+	__m256i v[16];
+	unsigned i, r;
+
+	hchacha20_lanes_load(x, n, in, key);
+	for (i = 0; i < 16; i++)
+		v[i] = _mm256_loadu_si256((const void *)x[i]);
+	for (r = 0; r < 20; r += 2) {
+		avx2_quarterround(&v[0], &v[4], &v[ 8], &v[12]);
+		avx2_quarterround(&v[1], &v[5], &v[ 9], &v[13]);
+		avx2_quarterround(&v[2], &v[6], &v[10], &v[14]);
+		avx2_quarterround(&v[3], &v[7], &v[11], &v[15]);
+		avx2_quarterround(&v[0], &v[5], &v[10], &v[15]);
+		avx2_quarterround(&v[1], &v[6], &v[11], &v[12]);
+		avx2_quarterround(&v[2], &v[7], &v[ 8], &v[13]);
+		avx2_quarterround(&v[3], &v[4], &v[ 9], &v[14]);
+	}
+	for (i = 0; i < 16; i++)
+		_mm256_storeu_si256((void *)x[i], v[i]);
+	hchacha20_lanes_store(out, n, x);
+
+	explicit_memset(x, 0, sizeof x);
+	explicit_memset(v, 0, sizeof v);
+}
+
+#undef	AVX2
+
+#endif	/* CHACHADAENCE_AVX2 */
+
+static void
+hchacha20_lanes(unsigned n, unsigned char *const out[static BATCH],
+    const unsigned char *const in[static BATCH],
+    const unsigned char *const key[static BATCH])
+{
+
+#ifdef CHACHADAENCE_AVX2
+	if (__builtin_cpu_supports("avx2")) {
+		hchacha20_lanes_avx2(n, out, in, key);
+		return;
+	}
+#endif
+	hchacha20_lanes_portable(n, out, in, key);
 }
 
+/* Tag generation: t, _ := HXChacha_k0(h1 || h2) */
+static void
+hxchacha(unsigned char t[static 24], const unsigned char h[static 32],
+    const unsigned char k0[static 32])
+{
+	const unsigned char *h1 = h, *h2 = h + 16;
+	unsigned char u[32];
+
+	crypto_core_hchacha20(u, h1, k0, sigma);
+	crypto_core_hchacha20(u, h2, u, sigma);
+	memcpy(t, u, 24);
+
+	/* paranoia */
+	explicit_memset(u, 0, sizeof u);
+}
+
+/*
+ * Compress and generate the tag, given poly1305 which has absorbed
+ * pad0(a) for a header of alen bytes.
+ */
 static void
 compressauth(unsigned char t[static 24],
     const unsigned char *m, unsigned long long mlen,
-    const unsigned char *a, unsigned long long alen,
-    const unsigned char k[static 64])
+    struct poly1305x2 *poly1305, unsigned long long alen,
+    const struct crypto_dae_chachadaence_ctx *ctx)
 {
-	const unsigned char *k0 = k, *k1 = k + 32, *k2 = k + 48;
 	unsigned char h[32], *h1 = h, *h2 = h + 16;
-	unsigned char u[32];
+	uint64_t t0;
 
 	/*
 	 * Message compression:
 	 *	h := Poly1305^2_{k1,k2}(a || m || |a| || |m|)
 	 */
-	poly1305ad(h1, m, mlen, a, alen, k1);
-	poly1305ad(h2, m, mlen, a, alen, k2);
+	t0 = daence_stats_begin();
+	poly1305x2_update(poly1305, m, mlen);
+	poly1305x2ad_final(poly1305, h1, h2, mlen, alen);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_COMPRESS, mlen, t0);
 
 	/* Tag generation: t, _ := HXChacha_k0(h1 || h2) */
-	crypto_core_hchacha20(u, h1, k0, sigma);
-	crypto_core_hchacha20(u, h2, u, sigma);
-	memcpy(t, u, 24);
+	t0 = daence_stats_begin();
+	hxchacha(t, h, ctx->k0);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_TAG, 0, t0);
+
+	/* paranoia */
+	explicit_memset(h, 0, sizeof h);
+}
+
+/*
+ * Decrypt and compress in one pass, given the XChaCha subkey
+ * sk = HChaCha_k0(t'[0..16]) and nonce n8 = t'[16..24] for the
+ * purported tag t', and poly1305 which has absorbed pad0(a) for a
+ * header of alen bytes:
+ *
+ *	m[0..mlen] := x[0..mlen] ^ ChaCha_sk(n8)
+ *	h := Poly1305^2_{k1,k2}(a || m || |a| || |m|)
+ *
+ * The message is processed in tiles small enough that each tile of
+ * plaintext is still in L1 cache when Poly1305 reads it back, so large
+ * messages make one trip through memory instead of two.  m may equal x.
+ * If m is null, each tile goes into a buffer on the stack and is
+ * discarded once hashed, so only h comes out.
+ */
+static void
+decryptauth(unsigned char h[static 32], unsigned char *m,
+    const unsigned char *x, unsigned long long mlen,
+    const unsigned char n8[static 8],
+    struct poly1305x2 *poly1305, unsigned long long alen,
+    const unsigned char sk[static 32])
+{
+	unsigned char tile[TILE], *p = tile;
+	unsigned long long i, n;
+
+	for (i = 0; i < mlen; i += n) {
+		n = (mlen - i < TILE ? mlen - i : TILE);
+		if (m)
+			p = m + i;
+		crypto_stream_chacha20_xor_ic(p, x + i, n, n8, i/64, sk);
+		poly1305x2_update(poly1305, p, n);
+	}
+	poly1305x2ad_final(poly1305, h, h + 16, mlen, alen);
+
+	if (m == NULL && mlen)
+		explicit_memset(tile, 0, sizeof tile); /* paranoia */
+}
+
+/*
+ * Seal with the tag and ciphertext in separate places: t[0..24] and
+ * x[0..mlen].  x may equal m.
+ */
+static void
+encrypt_detached_P(unsigned char *x, unsigned char t[static 24],
+    const unsigned char *m, unsigned long long mlen,
+    struct poly1305x2 *poly1305, unsigned long long alen,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	uint64_t t0;
+
+	/* t := HXChacha_k0(Poly1305^2_{k1,k2}(a,m)) */
+	compressauth(t, m, mlen, poly1305, alen, ctx);
+
+	/* Stream cipher: x[0..mlen] := m[0..mlen] ^ XChacha_k0(t) */
+	t0 = daence_stats_begin();
+	crypto_stream_xchacha20_xor(x, m, mlen, t, ctx->k0);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_STREAM, mlen, t0);
+}
+
+static void
+encrypt_P(unsigned char *c, const unsigned char *m, unsigned long long mlen,
+    struct poly1305x2 *poly1305, unsigned long long alen,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+
+	/* c[0..24] := t, c[24..24+mlen] := m ^ XChacha_k0(t) */
+	encrypt_detached_P(c + 24, c, m, mlen, poly1305, alen, ctx);
+}
+
+/*
+ * Open with the purported tag t'[0..24] and the ciphertext x[0..mlen]
+ * in separate places.  m may equal x, or be null to verify only.
+ */
+static int
+open_detached_P(unsigned char *m, const unsigned char *x,
+    unsigned long long mlen, const unsigned char tag[static 24],
+    struct poly1305x2 *poly1305, unsigned long long alen,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	unsigned char sk[32], h[32], t[32], t_[32];
+	uint64_t t0;
+	int ret;
+
+	/*
+	 * Stream cipher, fused with message compression:
+	 *	m[0..mlen] := x[0..mlen] ^ XChacha_k0(t')
+	 *	h := Poly1305^2_{k1,k2}(a || m || |a| || |m|)
+	 */
+	t0 = daence_stats_begin();
+	memcpy(t_, tag, 24);
+	crypto_core_hchacha20(sk, t_, ctx->k0, sigma);
+	decryptauth(h, m, x, mlen, t_ + 16, poly1305, alen, sk);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_FUSED, mlen, t0);
+
+	/* t := HXChacha_k0(h) */
+	t0 = daence_stats_begin();
+	hxchacha(t, h, ctx->k0);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_TAG, 0, t0);
+
+	/* Verify tag: t' ?= t (no crypto_verify_24) */
+	memset(t + 24, 0, 8);
+	memset(t_ + 24, 0, 8);
+	ret = crypto_verify_32(t_, t);
+	if (ret && m)
+		explicit_memset(m, 0, mlen); /* paranoia */
+
+	/* Paranoia: clear temporaries.  */
+	explicit_memset(sk, 0, sizeof sk);
+	explicit_memset(h, 0, sizeof h);
+	explicit_memset(t, 0, sizeof t);
+	explicit_memset(t_, 0, sizeof t_);
+
+	return ret;
+}
+
+static int
+open_P(unsigned char *m, const unsigned char *c, unsigned long long mlen,
+    struct poly1305x2 *poly1305, unsigned long long alen,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+
+	return open_detached_P(m, c + 24, mlen, c, poly1305, alen, ctx);
+}
+
+void
+crypto_dae_chachadaence_ctx_init(struct crypto_dae_chachadaence_ctx *ctx,
+    const unsigned char k[static 64])
+{
+	const unsigned char *k0 = k, *k1 = k + 32, *k2 = k + 48;
+
+	memcpy(ctx->k0, k0, 32);
+	poly1305x2_setkey(&ctx->k12, k1, k2);
+}
+
+void
+crypto_dae_chachadaence_ctx_destroy(struct crypto_dae_chachadaence_ctx *ctx)
+{
+
+	explicit_memset(ctx->k0, 0, sizeof ctx->k0);
+	poly1305x2_clearkey(&ctx->k12);
+}
+
+void
+crypto_dae_chachadaence_ctx_encrypt(unsigned char *c,
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	struct poly1305x2 poly1305;
+	uint64_t t0 = daence_stats_begin(), t1;
+
+	t1 = daence_stats_begin();
+	poly1305x2ad_init(&poly1305, a, alen, &ctx->k12);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_COMPRESS, alen, t1);
+	encrypt_P(c, m, mlen, &poly1305, alen, ctx);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_SEAL, mlen, t0);
+}
+
+int
+crypto_dae_chachadaence_ctx_open(unsigned char *m,
+    const unsigned char *c, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	struct poly1305x2 poly1305;
+	uint64_t t0 = daence_stats_begin(), t1;
+	int ret;
+
+	t1 = daence_stats_begin();
+	poly1305x2ad_init(&poly1305, a, alen, &ctx->k12);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_COMPRESS, alen, t1);
+	ret = open_P(m, c, mlen, &poly1305, alen, ctx);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_OPEN, mlen, t0);
+
+	return ret;
+}
+
+int
+crypto_dae_chachadaence_ctx_verify(const unsigned char *c,
+    unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	struct poly1305x2 poly1305;
+	uint64_t t0 = daence_stats_begin(), t1;
+	int ret;
+
+	t1 = daence_stats_begin();
+	poly1305x2ad_init(&poly1305, a, alen, &ctx->k12);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_COMPRESS, alen, t1);
+	ret = open_detached_P(NULL, c + 24, mlen, c, &poly1305, alen, ctx);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_VERIFY, mlen, t0);
+
+	return ret;
+}
+
+void
+crypto_dae_chachadaence_ctx_tag(unsigned char t[static 24],
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	struct poly1305x2 poly1305;
+	uint64_t t0 = daence_stats_begin(), t1;
+
+	/* t := HXChacha_k0(Poly1305^2_{k1,k2}(a,m)), and no stream */
+	t1 = daence_stats_begin();
+	poly1305x2ad_init(&poly1305, a, alen, &ctx->k12);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_COMPRESS, alen, t1);
+	compressauth(t, m, mlen, &poly1305, alen, ctx);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_AUTH, mlen, t0);
+}
+
+void
+crypto_dae_chachadaence_ctx_encrypt_detached(unsigned char *c,
+    unsigned char t[static 24],
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	struct poly1305x2 poly1305;
+	uint64_t t0 = daence_stats_begin(), t1;
+
+	t1 = daence_stats_begin();
+	poly1305x2ad_init(&poly1305, a, alen, &ctx->k12);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_COMPRESS, alen, t1);
+	encrypt_detached_P(c, t, m, mlen, &poly1305, alen, ctx);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_SEAL, mlen, t0);
+}
+
+int
+crypto_dae_chachadaence_ctx_open_detached(unsigned char *m,
+    const unsigned char *c, unsigned long long mlen,
+    const unsigned char t[static 24],
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	struct poly1305x2 poly1305;
+	uint64_t t0 = daence_stats_begin(), t1;
+	int ret;
+
+	t1 = daence_stats_begin();
+	poly1305x2ad_init(&poly1305, a, alen, &ctx->k12);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_COMPRESS, alen, t1);
+	ret = open_detached_P(m, c, mlen, t, &poly1305, alen, ctx);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_OPEN, mlen, t0);
+
+	return ret;
+}
+
+/*
+ * Header prefix: the Poly1305^2 state after absorbing the first alen
+ * bytes of the header, without padding, so that each message can
+ * append the rest of its header before pad0(a) is completed.
+ */
+void
+crypto_dae_chachadaence_hdr_init(struct crypto_dae_chachadaence_hdr *hdr,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+
+	poly1305x2_init(&hdr->poly1305, &ctx->k12);
+	poly1305x2_update(&hdr->poly1305, a, alen);
+	hdr->alen = alen;
+}
+
+void
+crypto_dae_chachadaence_hdr_destroy(struct crypto_dae_chachadaence_hdr *hdr)
+{
+
+	explicit_memset(hdr, 0, sizeof *hdr);
+}
+
+void
+crypto_dae_chachadaence_hdr_export(
+    const struct crypto_dae_chachadaence_hdr *hdr,
+    unsigned char buf[static crypto_dae_chachadaence_HDRBYTES])
+{
+
+	poly1305x2_export(&hdr->poly1305, buf);
+	le64enc(buf + POLY1305X2_STATEBYTES, hdr->alen);
+}
+
+int
+crypto_dae_chachadaence_hdr_import(struct crypto_dae_chachadaence_hdr *hdr,
+    const unsigned char buf[static crypto_dae_chachadaence_HDRBYTES],
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	const unsigned char *p = buf + POLY1305X2_STATEBYTES;
+	unsigned long long alen = 0;
+	unsigned i;
+
+	for (i = 8; i --> 0;)
+		alen = (alen << 8) | p[i];
+	if (poly1305x2_import(&hdr->poly1305, &ctx->k12, buf))
+		return -1;
+
+	/* The pending partial block must be the tail of the prefix.  */
+	if (alen % 16 != hdr->poly1305.nbuf) {
+		explicit_memset(hdr, 0, sizeof *hdr);
+		return -1;
+	}
+	hdr->alen = alen;
+
+	return 0;
+}
+
+/*
+ * Start from a copy of the prefix state, absorb the rest of the header
+ * a[0..alen], and carry on as usual with the full header length.
+ */
+static void
+hdr_start(struct poly1305x2 *poly1305,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_chachadaence_hdr *hdr,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	uint64_t t0 = daence_stats_begin();
+
+	*poly1305 = hdr->poly1305;
+	poly1305->key = &ctx->k12;
+	poly1305x2_update(poly1305, a, alen);
+	poly1305x2ad_pad(poly1305, hdr->alen + alen);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_COMPRESS, alen, t0);
+}
+
+void
+crypto_dae_chachadaence_hdr_encrypt(unsigned char *c,
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_chachadaence_hdr *hdr,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	struct poly1305x2 poly1305;
+	uint64_t t0 = daence_stats_begin();
+
+	hdr_start(&poly1305, a, alen, hdr, ctx);
+	encrypt_P(c, m, mlen, &poly1305, hdr->alen + alen, ctx);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_SEAL, mlen, t0);
+}
+
+int
+crypto_dae_chachadaence_hdr_open(unsigned char *m,
+    const unsigned char *c, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_chachadaence_hdr *hdr,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	struct poly1305x2 poly1305;
+	uint64_t t0 = daence_stats_begin();
+	int ret;
+
+	hdr_start(&poly1305, a, alen, hdr, ctx);
+	ret = open_P(m, c, mlen, &poly1305, hdr->alen + alen, ctx);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_OPEN, mlen, t0);
+
+	return ret;
+}
+
+void
+crypto_dae_chachadaence_ctx_batch(struct crypto_dae_chachadaence_batch *b,
+    size_t n, const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	unsigned char h[BATCH][32], u[BATCH][32], sk[BATCH][32];
+	unsigned char *out[BATCH];
+	const unsigned char *in[BATCH], *key[BATCH];
+	unsigned long long nbytes = 0;
+	uint64_t t0 = daence_stats_begin();
+	unsigned j, k;
+
+	for (; n; b += k, n -= k) {
+		k = n < BATCH ? n : BATCH;
+
+		/* h := Poly1305^2_{k1,k2}(a || m || |a| || |m|) */
+		for (j = 0; j < k; j++) {
+			nbytes += b[j].mlen;
+			poly1305x2ad(h[j], h[j] + 16, b[j].m, b[j].mlen,
+			    b[j].a, b[j].alen, &ctx->k12);
+		}
+
+		/* u := HChaCha_k0(h1) */
+		for (j = 0; j < k; j++) {
+			out[j] = u[j]; in[j] = h[j]; key[j] = ctx->k0;
+		}
+		hchacha20_lanes(k, out, in, key);
+
+		/* t, _ := HChaCha_u(h2) */
+		for (j = 0; j < k; j++) {
+			out[j] = u[j]; in[j] = h[j] + 16; key[j] = u[j];
+		}
+		hchacha20_lanes(k, out, in, key);
+		for (j = 0; j < k; j++)
+			memcpy(b[j].c, u[j], 24);
+
+		/* XChaCha subkey: HChaCha_k0(t[0..16]) */
+		for (j = 0; j < k; j++) {
+			out[j] = sk[j]; in[j] = u[j]; key[j] = ctx->k0;
+		}
+		hchacha20_lanes(k, out, in, key);
+
+		/* c[24..24+mlen] := m ^ ChaCha_subkey(t[16..24]) */
+		for (j = 0; j < k; j++) {
+			crypto_stream_chacha20_xor_ic(b[j].c + 24, b[j].m,
+			    b[j].mlen, u[j] + 16, 0, sk[j]);
+		}
+	}
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_SEAL, nbytes, t0);
 
 	/* paranoia */
 	explicit_memset(h, 0, sizeof h);
 	explicit_memset(u, 0, sizeof u);
+	explicit_memset(sk, 0, sizeof sk);
+}
+
+int
+crypto_dae_chachadaence_ctx_open_batch(struct crypto_dae_chachadaence_batch *b,
+    size_t n, const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	unsigned char h[BATCH][32], u[BATCH][32], sk[BATCH][32];
+	unsigned char t[32], t_[32];
+	unsigned char *out[BATCH];
+	const unsigned char *in[BATCH], *key[BATCH];
+	struct poly1305x2 poly1305;
+	unsigned long long nbytes = 0;
+	uint64_t t0 = daence_stats_begin();
+	unsigned j, k;
+	int ret = 0;
+
+	for (; n; b += k, n -= k) {
+		k = n < BATCH ? n : BATCH;
+
+		/* XChaCha subkey: HChaCha_k0(t'[0..16]), t' = c[0..24] */
+		for (j = 0; j < k; j++) {
+			out[j] = sk[j]; in[j] = b[j].c; key[j] = ctx->k0;
+		}
+		hchacha20_lanes(k, out, in, key);
+
+		/*
+		 * m := c[24..24+mlen] ^ ChaCha_subkey(t'[16..24])
+		 * h := Poly1305^2_{k1,k2}(a || m || |a| || |m|)
+		 */
+		for (j = 0; j < k; j++) {
+			nbytes += b[j].mlen;
+			poly1305x2ad_init(&poly1305, b[j].a, b[j].alen,
+			    &ctx->k12);
+			decryptauth(h[j], b[j].m, b[j].c + 24, b[j].mlen,
+			    b[j].c + 16, &poly1305, b[j].alen, sk[j]);
+		}
+
+		/* u := HChaCha_k0(h1); t, _ := HChaCha_u(h2) */
+		for (j = 0; j < k; j++) {
+			out[j] = u[j]; in[j] = h[j]; key[j] = ctx->k0;
+		}
+		hchacha20_lanes(k, out, in, key);
+		for (j = 0; j < k; j++) {
+			out[j] = u[j]; in[j] = h[j] + 16; key[j] = u[j];
+		}
+		hchacha20_lanes(k, out, in, key);
+
+		/* Verify tags: c[0..24] ?= t (no crypto_verify_24) */
+		for (j = 0; j < k; j++) {
+			memcpy(t, u[j], 24);
+			memcpy(t_, b[j].c, 24);
+			memset(t + 24, 0, 8);
+			memset(t_ + 24, 0, 8);
+			b[j].ret = crypto_verify_32(t_, t);
+			if (b[j].ret) {
+				explicit_memset(b[j].m, 0, b[j].mlen);
+				ret = -1;
+			}
+		}
+	}
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_OPEN, nbytes, t0);
+
+	/* Paranoia: clear temporaries.  */
+	explicit_memset(h, 0, sizeof h);
+	explicit_memset(u, 0, sizeof u);
+	explicit_memset(sk, 0, sizeof sk);
+	explicit_memset(t, 0, sizeof t);
+	explicit_memset(t_, 0, sizeof t_);
+
+	return ret;
 }
 
 void
-crypto_dae_chachadaence(unsigned char *c,
+crypto_dae_chachadaence_ctx_tag_batch(struct crypto_dae_chachadaence_batch *b,
+    size_t n, const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	unsigned char h[BATCH][32], u[BATCH][32];
+	unsigned char *out[BATCH];
+	const unsigned char *in[BATCH], *key[BATCH];
+	unsigned long long nbytes = 0;
+	uint64_t t0 = daence_stats_begin();
+	unsigned j, k;
+
+	for (; n; b += k, n -= k) {
+		k = n < BATCH ? n : BATCH;
+
+		/* h := Poly1305^2_{k1,k2}(a || m || |a| || |m|) */
+		for (j = 0; j < k; j++) {
+			nbytes += b[j].mlen;
+			poly1305x2ad(h[j], h[j] + 16, b[j].m, b[j].mlen,
+			    b[j].a, b[j].alen, &ctx->k12);
+		}
+
+		/* u := HChaCha_k0(h1); t, _ := HChaCha_u(h2) */
+		for (j = 0; j < k; j++) {
+			out[j] = u[j]; in[j] = h[j]; key[j] = ctx->k0;
+		}
+		hchacha20_lanes(k, out, in, key);
+		for (j = 0; j < k; j++) {
+			out[j] = u[j]; in[j] = h[j] + 16; key[j] = u[j];
+		}
+		hchacha20_lanes(k, out, in, key);
+		for (j = 0; j < k; j++)
+			memcpy(b[j].c, u[j], 24);
+	}
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_AUTH, nbytes, t0);
+
+	/* paranoia */
+	explicit_memset(h, 0, sizeof h);
+	explicit_memset(u, 0, sizeof u);
+}
+
+/*
+ * Parallel processing of one large message, with the chunks of
+ * daence_chunk.c: the ChaCha stream is run from each chunk's first
+ * block, with the HChaCha subkey sk and nonce n8.
+ */
+
+struct chunkkey {
+	const unsigned char	*sk;
+	const unsigned char	*n8;
+};
+
+static void
+chunk_stream(const void *cookie, unsigned char *out, const unsigned char *in,
+    unsigned long long n, uint64_t blk)
+{
+	const struct chunkkey *K = cookie;
+
+	crypto_stream_chacha20_xor_ic(out, in, n, K->n8, blk, K->sk);
+}
+
+/*
+ * Join the chunk hashes onto poly1305, which has absorbed pad0(a), and
+ * finish h := Poly1305^2_{k1,k2}(a || m || |a| || |m|).  m is the
+ * plaintext, for the last few bytes no chunk hashed.
+ */
+static void
+chunk_hash(unsigned char h[static 32], struct poly1305x2 *poly1305,
+    struct daence_chunk *C, unsigned n, const unsigned char *m,
+    unsigned long long mlen, unsigned long long alen)
+{
+	daence_chunk_join(poly1305, C, n, m, mlen);
+	poly1305x2ad_final(poly1305, h, h + 16, mlen, alen);
+}
+
+void
+crypto_dae_chachadaence_ctx_parallel(unsigned char *c,
     const unsigned char *m, unsigned long long mlen,
     const unsigned char *a, unsigned long long alen,
-    const unsigned char k[static 64])
+    const struct crypto_dae_chachadaence_ctx *ctx, unsigned nthreads)
 {
-	const unsigned char *k0 = k;	/* k0 := k[0..32] */
+	struct daence_chunk C[DAENCE_CHUNK_MAXTHREADS];
+	struct chunkkey K;
+	struct poly1305x2 poly1305;
+	unsigned char h[32], sk[32];
+	uint64_t t0 = daence_stats_begin();
+	unsigned i, n;
 
-	/* c[0..24] := HXChacha_k0(Poly1305^2_{k1,k2}(a,m)) */
-	compressauth(c, m, mlen, a, alen, k);
+	n = daence_chunk_split(C, nthreads, mlen);
+
+	/* h := Poly1305^2_{k1,k2}(a || m || |a| || |m|), in chunks */
+	poly1305x2ad_init(&poly1305, a, alen, &ctx->k12);
+	for (i = 0; i < n; i++) {
+		C[i].in = m + C[i].off;
+		C[i].k12 = &ctx->k12;
+	}
+	daence_chunk_runall(C, n);
+	chunk_hash(h, &poly1305, C, n, m, mlen, alen);
+
+	/* c[0..24] := t := HXChacha_k0(h) */
+	hxchacha(c, h, ctx->k0);
 
 	/*
-	 * Stream cipher:
+	 * Stream cipher, in chunks:
 	 *	c[24..24+mlen] := m[0..mlen]
 	 *	    ^ XChacha_k0(t @ c[0..24])
 	 */
-	crypto_stream_xchacha20_xor(c + 24, m, mlen, c, k0);
+	crypto_core_hchacha20(sk, c, ctx->k0, sigma);
+	K.sk = sk;
+	K.n8 = c + 16;
+	for (i = 0; i < n; i++) {
+		C[i].out = c + 24 + C[i].off;
+		C[i].stream = chunk_stream;
+		C[i].key = &K;
+		C[i].k12 = NULL;
+	}
+	daence_chunk_runall(C, n);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_SEAL, mlen, t0);
+
+	/* paranoia */
+	explicit_memset(h, 0, sizeof h);
+	explicit_memset(sk, 0, sizeof sk);
+	explicit_memset(C, 0, sizeof C);
 }
 
 int
-crypto_dae_chachadaence_open(unsigned char *m,
+crypto_dae_chachadaence_ctx_open_parallel(unsigned char *m,
     const unsigned char *c, unsigned long long mlen,
     const unsigned char *a, unsigned long long alen,
-    const unsigned char k[static 64])
+    const struct crypto_dae_chachadaence_ctx *ctx, unsigned nthreads)
 {
-	const unsigned char *k0 = k;	/* k0 := k[0..32] */
-	unsigned char t[32], t_[32];
+	struct daence_chunk C[DAENCE_CHUNK_MAXTHREADS];
+	struct chunkkey K;
+	struct poly1305x2 poly1305;
+	unsigned char h[32], sk[32], t[32], t_[32];
+	uint64_t t0 = daence_stats_begin();
+	unsigned i, n;
 	int ret;
 
+	n = daence_chunk_split(C, nthreads, mlen);
+
 	/*
-	 * Stream cipher:
+	 * Stream cipher, fused with message compression, in chunks:
 	 *	m[0..mlen] := c[24..24+mlen]
 	 *	    ^ XChacha_k0(t' @ c[0..24])
+	 *	h := Poly1305^2_{k1,k2}(a || m || |a| || |m|)
 	 */
-	crypto_stream_xchacha20_xor(m, c + 24, mlen, c, k0);
+	crypto_core_hchacha20(sk, c, ctx->k0, sigma);
+	poly1305x2ad_init(&poly1305, a, alen, &ctx->k12);
+	K.sk = sk;
+	K.n8 = c + 16;
+	for (i = 0; i < n; i++) {
+		C[i].out = m + C[i].off;
+		C[i].in = c + 24 + C[i].off;
+		C[i].stream = chunk_stream;
+		C[i].key = &K;
+		C[i].k12 = &ctx->k12;
+	}
+	daence_chunk_runall(C, n);
+	chunk_hash(h, &poly1305, C, n, m, mlen, alen);
 
-	/* t := HXChacha_k0(Poly1305^2_{k1,k2}(a,m)) */
-	compressauth(t, m, mlen, a, alen, k);
+	/* t := HXChacha_k0(h) */
+	hxchacha(t, h, ctx->k0);
 
 	/* Verify tag: c[0..24] ?= t (no crypto_verify_24) */
 	memcpy(t_, c, 24);
@@ -172,14 +1031,370 @@ crypto_dae_chachadaence_open(unsigned char *m,
 	ret = crypto_verify_32(t_, t);
 	if (ret)
 		explicit_memset(m, 0, mlen); /* paranoia */
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_OPEN, mlen, t0);
+
+	/* Paranoia: clear temporaries.  */
+	explicit_memset(sk, 0, sizeof sk);
+	explicit_memset(h, 0, sizeof h);
+	explicit_memset(t, 0, sizeof t);
+	explicit_memset(t_, 0, sizeof t_);
+	explicit_memset(C, 0, sizeof C);
+
+	return ret;
+}
+
+/*
+ * Scatter/gather: the message, header, and output are each given as
+ * an array of struct iovec, with segment boundaries anywhere.  The
+ * Poly1305^2 state and the keystream carry across boundaries, so
+ * nothing is copied into a staging buffer.
+ */
+
+/*
+ * out[0..n] := in[0..n] ^ ChaCha_sk(n8)[off..off+n].  A run that
+ * starts in the middle of a ChaCha block costs one extra block for its
+ * head, so segments that are multiples of 64 bytes are best.
+ */
+static void
+chacha20_xor_at(unsigned char *out, const unsigned char *in,
+    unsigned long long n, unsigned long long off,
+    const unsigned char n8[static 8], const unsigned char sk[static 32])
+{
+	unsigned char ks[64];
+	unsigned r = off % 64, i, k;
+
+	if (r) {
+		memset(ks, 0, sizeof ks);
+		crypto_stream_chacha20_xor_ic(ks, ks, sizeof ks, n8, off/64,
+		    sk);
+		k = (n < 64 - r ? n : 64 - r);
+		for (i = 0; i < k; i++)
+			out[i] = in[i] ^ ks[r + i];
+		out += k;
+		in += k;
+		n -= k;
+		off += k;
+		explicit_memset(ks, 0, sizeof ks);
+	}
+	if (n)
+		crypto_stream_chacha20_xor_ic(out, in, n, n8, off/64, sk);
+}
+
+/*
+ * Run the stream cipher from the segments under I to the segments
+ * under O, for len bytes starting at keystream offset 0, in runs
+ * contiguous on both sides; if poly1305 is not null, absorb each run
+ * of output as it is written.
+ */
+static void
+chacha20_xor_iov(struct daence_iovcur *O, struct daence_iovcur *I,
+    unsigned long long len, const unsigned char n8[static 8],
+    const unsigned char sk[static 32], struct poly1305x2 *poly1305)
+{
+	unsigned long long off = 0;
+	unsigned char *op, *ip;
+	size_t on, in;
+
+	while (off < len) {
+		on = daence_iovcur_next(O, &op,
+		    (len - off < TILE ? len - off : TILE));
+		for (; on; op += in, on -= in, off += in) {
+			in = daence_iovcur_next(I, &ip, on);
+			chacha20_xor_at(op, ip, in, off, n8, sk);
+			if (poly1305)
+				poly1305x2_update(poly1305, op, in);
+		}
+	}
+}
+
+static void
+poly1305x2_update_iov(struct poly1305x2 *poly1305, const struct iovec *iov,
+    int iovcnt)
+{
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		poly1305x2_update(poly1305, iov[i].iov_base, iov[i].iov_len);
+}
+
+int
+crypto_dae_chachadaence_ctx_encryptv(const struct iovec *cv, int cvcnt,
+    const struct iovec *mv, int mvcnt,
+    const struct iovec *av, int avcnt,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	unsigned long long mlen = daence_iov_total(mv, mvcnt);
+	unsigned long long alen = daence_iov_total(av, avcnt);
+	struct poly1305x2 poly1305;
+	unsigned char h[32], t[24], sk[32];
+	struct daence_iovcur C = { cv, cvcnt, 0 }, M = { mv, mvcnt, 0 };
+	uint64_t t0 = daence_stats_begin(), t1;
+
+	if (daence_iov_total(cv, cvcnt) != 24 + mlen)
+		return -1;
+
+	/* h := Poly1305^2_{k1,k2}(a || m || |a| || |m|) */
+	t1 = daence_stats_begin();
+	poly1305x2_init(&poly1305, &ctx->k12);
+	poly1305x2_update_iov(&poly1305, av, avcnt);
+	poly1305x2ad_pad(&poly1305, alen);
+	poly1305x2_update_iov(&poly1305, mv, mvcnt);
+	poly1305x2ad_final(&poly1305, h, h + 16, mlen, alen);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_COMPRESS,
+	    mlen + alen, t1);
+
+	/* c[0..24] := t := HXChacha_k0(h) */
+	t1 = daence_stats_begin();
+	hxchacha(t, h, ctx->k0);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_TAG, 0, t1);
+	daence_iovcur_write(&C, t, 24);
+
+	/* c[24..24+mlen] := m[0..mlen] ^ XChacha_k0(t) */
+	t1 = daence_stats_begin();
+	crypto_core_hchacha20(sk, t, ctx->k0, sigma);
+	chacha20_xor_iov(&C, &M, mlen, t + 16, sk, NULL);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_STREAM, mlen, t1);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_SEAL, mlen, t0);
+
+	/* Paranoia: clear temporaries.  */
+	explicit_memset(h, 0, sizeof h);
+	explicit_memset(t, 0, sizeof t);
+	explicit_memset(sk, 0, sizeof sk);
+
+	return 0;
+}
+
+int
+crypto_dae_chachadaence_ctx_openv(const struct iovec *mv, int mvcnt,
+    const struct iovec *cv, int cvcnt,
+    const struct iovec *av, int avcnt,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	unsigned long long mlen = daence_iov_total(mv, mvcnt);
+	unsigned long long alen = daence_iov_total(av, avcnt);
+	struct poly1305x2 poly1305;
+	unsigned char h[32], t[32], t_[32], sk[32];
+	struct daence_iovcur C = { cv, cvcnt, 0 }, M = { mv, mvcnt, 0 };
+	uint64_t t0 = daence_stats_begin(), t1;
+	int i, ret;
+
+	if (daence_iov_total(cv, cvcnt) != 24 + mlen)
+		return -1;
+
+	/* t' := c[0..24] */
+	memset(t_, 0, sizeof t_);
+	daence_iovcur_read(&C, t_, 24);
+
+	t1 = daence_stats_begin();
+	poly1305x2_init(&poly1305, &ctx->k12);
+	poly1305x2_update_iov(&poly1305, av, avcnt);
+	poly1305x2ad_pad(&poly1305, alen);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_COMPRESS, alen, t1);
+
+	/*
+	 * Stream cipher, fused with message compression:
+	 *	m[0..mlen] := c[24..24+mlen] ^ XChacha_k0(t')
+	 *	h := Poly1305^2_{k1,k2}(a || m || |a| || |m|)
+	 */
+	t1 = daence_stats_begin();
+	crypto_core_hchacha20(sk, t_, ctx->k0, sigma);
+	chacha20_xor_iov(&M, &C, mlen, t_ + 16, sk, &poly1305);
+	poly1305x2ad_final(&poly1305, h, h + 16, mlen, alen);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_FUSED, mlen, t1);
+
+	/* t := HXChacha_k0(h) */
+	t1 = daence_stats_begin();
+	hxchacha(t, h, ctx->k0);
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_TAG, 0, t1);
+
+	/* Verify tag: t' ?= t (no crypto_verify_24) */
+	memset(t + 24, 0, 8);
+	ret = crypto_verify_32(t_, t);
+	if (ret) {		/* paranoia */
+		for (i = 0; i < mvcnt; i++)
+			explicit_memset(mv[i].iov_base, 0, mv[i].iov_len);
+	}
+	daence_stats_end(DAENCE_IMPL_CHACHA, DAENCE_PHASE_OPEN, mlen, t0);
 
 	/* Paranoia: clear temporaries.  */
+	explicit_memset(h, 0, sizeof h);
 	explicit_memset(t, 0, sizeof t);
 	explicit_memset(t_, 0, sizeof t_);
+	explicit_memset(sk, 0, sizeof sk);
+
+	return ret;
+}
+
+void
+crypto_dae_chachadaence(unsigned char *c,
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 64])
+{
+	struct crypto_dae_chachadaence_ctx ctx;
+
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+	crypto_dae_chachadaence_ctx_encrypt(c, m, mlen, a, alen, &ctx);
+	crypto_dae_chachadaence_ctx_destroy(&ctx);
+}
+
+int
+crypto_dae_chachadaence_open(unsigned char *m,
+    const unsigned char *c, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 64])
+{
+	struct crypto_dae_chachadaence_ctx ctx;
+	int ret;
+
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+	ret = crypto_dae_chachadaence_ctx_open(m, c, mlen, a, alen, &ctx);
+	crypto_dae_chachadaence_ctx_destroy(&ctx);
 
 	return ret;
 }
 
+int
+crypto_dae_chachadaence_verify(const unsigned char *c,
+    unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 64])
+{
+	struct crypto_dae_chachadaence_ctx ctx;
+	int ret;
+
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+	ret = crypto_dae_chachadaence_ctx_verify(c, mlen, a, alen, &ctx);
+	crypto_dae_chachadaence_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+void
+crypto_dae_chachadaence_tag(unsigned char t[static 24],
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 64])
+{
+	struct crypto_dae_chachadaence_ctx ctx;
+
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+	crypto_dae_chachadaence_ctx_tag(t, m, mlen, a, alen, &ctx);
+	crypto_dae_chachadaence_ctx_destroy(&ctx);
+}
+
+void
+crypto_dae_chachadaence_detached(unsigned char *c, unsigned char t[static 24],
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 64])
+{
+	struct crypto_dae_chachadaence_ctx ctx;
+
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+	crypto_dae_chachadaence_ctx_encrypt_detached(c, t, m, mlen, a, alen,
+	    &ctx);
+	crypto_dae_chachadaence_ctx_destroy(&ctx);
+}
+
+int
+crypto_dae_chachadaence_open_detached(unsigned char *m,
+    const unsigned char *c, unsigned long long mlen,
+    const unsigned char t[static 24],
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 64])
+{
+	struct crypto_dae_chachadaence_ctx ctx;
+	int ret;
+
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+	ret = crypto_dae_chachadaence_ctx_open_detached(m, c, mlen, t, a, alen,
+	    &ctx);
+	crypto_dae_chachadaence_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+int
+crypto_dae_chachadaence_encryptv(const struct iovec *cv, int cvcnt,
+    const struct iovec *mv, int mvcnt,
+    const struct iovec *av, int avcnt,
+    const unsigned char k[static 64])
+{
+	struct crypto_dae_chachadaence_ctx ctx;
+	int ret;
+
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+	ret = crypto_dae_chachadaence_ctx_encryptv(cv, cvcnt, mv, mvcnt,
+	    av, avcnt, &ctx);
+	crypto_dae_chachadaence_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+int
+crypto_dae_chachadaence_openv(const struct iovec *mv, int mvcnt,
+    const struct iovec *cv, int cvcnt,
+    const struct iovec *av, int avcnt,
+    const unsigned char k[static 64])
+{
+	struct crypto_dae_chachadaence_ctx ctx;
+	int ret;
+
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+	ret = crypto_dae_chachadaence_ctx_openv(mv, mvcnt, cv, cvcnt,
+	    av, avcnt, &ctx);
+	crypto_dae_chachadaence_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+static int
+hchacha20_selftest(void)
+{
+	/* https://tools.ietf.org/html/draft-irtf-cfrg-xchacha-03, §2.2.1 */
+	static const unsigned char k[32] = {
+		0x00,0x01,0x02,0x03, 0x04,0x05,0x06,0x07,
+		0x08,0x09,0x0a,0x0b, 0x0c,0x0d,0x0e,0x0f,
+		0x10,0x11,0x12,0x13, 0x14,0x15,0x16,0x17,
+		0x18,0x19,0x1a,0x1b, 0x1c,0x1d,0x1e,0x1f,
+	};
+	static const unsigned char in[16] = {
+		0x00,0x00,0x00,0x09, 0x00,0x00,0x00,0x4a,
+		0x00,0x00,0x00,0x00, 0x31,0x41,0x59,0x27,
+	};
+	static const unsigned char expected[32] = {
+		0x82,0x41,0x3b,0x42, 0x27,0xb2,0x7b,0xfe,
+		0xd3,0x0e,0x42,0x50, 0x8a,0x87,0x7d,0x73,
+		0xa0,0xf9,0xe4,0xd5, 0x8a,0x74,0xa8,0x53,
+		0xc1,0x2e,0xc4,0x13, 0x26,0xd3,0xec,0xdc,
+	};
+	unsigned char buf[BATCH][32];
+	unsigned char *out[BATCH];
+	const unsigned char *inp[BATCH], *key[BATCH];
+	unsigned i;
+
+	for (i = 0; i < BATCH; i++) {
+		out[i] = buf[i]; inp[i] = in; key[i] = k;
+	}
+
+	memset(buf, 0, sizeof buf);
+	hchacha20_lanes_portable(BATCH - 1, out, inp, key);
+	for (i = 0; i < BATCH - 1; i++) {
+		if (memcmp(buf[i], expected, 32) != 0)
+			return -1;
+	}
+
+	memset(buf, 0, sizeof buf);
+	hchacha20_lanes(BATCH, out, inp, key);
+	for (i = 0; i < BATCH; i++) {
+		if (memcmp(buf[i], expected, 32) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
 int
 crypto_dae_chachadaence_selftest(void)
 {
@@ -212,8 +1427,18 @@ crypto_dae_chachadaence_selftest(void)
 		0x0f,0x11,0xf2,0xb2,0xe4,0x72,0x67,0xe5,
 		0x33,0xe9,0x5a,0xa3,0xb2,0xe7,0x1e,0xfb, 0x68,
 	};
+	struct crypto_dae_chachadaence_ctx ctx;
+	struct crypto_dae_chachadaence_hdr hdr;
+	unsigned char hdrbuf[crypto_dae_chachadaence_HDRBYTES];
+	struct crypto_dae_chachadaence_batch b[BATCH + 3];
+	unsigned char bc[BATCH + 3][sizeof c], bm[BATCH + 3][sizeof m];
 	unsigned char c0[sizeof c];
 	unsigned char m0[sizeof m];
+	unsigned i;
+	int ret = -1;
+
+	if (hchacha20_selftest())
+		return -1;
 
 	crypto_dae_chachadaence(c0, m, sizeof m, a, sizeof a, k);
 	if (memcmp(c, c0, sizeof c) != 0)
@@ -227,5 +1452,84 @@ crypto_dae_chachadaence_selftest(void)
 	    == 0)
 		return -1;
 
-	return 0;
+	/* Same again, reusing one expanded key.  */
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+	crypto_dae_chachadaence_ctx_encrypt(c0, m, sizeof m, a, sizeof a,
+	    &ctx);
+	if (memcmp(c, c0, sizeof c) != 0)
+		goto out;
+	if (crypto_dae_chachadaence_ctx_open(m0, c, sizeof m, a, sizeof a,
+		&ctx))
+		goto out;
+	if (memcmp(m, m0, sizeof m) != 0)
+		goto out;
+	c0[18] ^= 0x4;
+	if (crypto_dae_chachadaence_ctx_open(m0, c0, sizeof m, a, sizeof a,
+		&ctx) == 0)
+		goto out;
+
+	/* Same again, in a batch spanning more than one group.  */
+	for (i = 0; i < sizeof bc/sizeof bc[0]; i++) {
+		b[i].c = bc[i];
+		b[i].m = (unsigned char *)(uintptr_t)m;
+		b[i].mlen = sizeof m;
+		b[i].a = a;
+		b[i].alen = sizeof a;
+	}
+	crypto_dae_chachadaence_ctx_batch(b, sizeof b/sizeof b[0], &ctx);
+	for (i = 0; i < sizeof bc/sizeof bc[0]; i++) {
+		if (memcmp(c, bc[i], sizeof c) != 0)
+			goto out;
+		b[i].m = bm[i];
+	}
+	bc[BATCH][18] ^= 0x4;
+	if (crypto_dae_chachadaence_ctx_open_batch(b, sizeof b/sizeof b[0],
+		&ctx) == 0)
+		goto out;
+	for (i = 0; i < sizeof bc/sizeof bc[0]; i++) {
+		if (i == BATCH) {
+			if (b[i].ret == 0)
+				goto out;
+			continue;
+		}
+		if (b[i].ret != 0)
+			goto out;
+		if (memcmp(m, bm[i], sizeof m) != 0)
+			goto out;
+	}
+
+	/*
+	 * Same again, resuming from every split of the header into
+	 * prefix and rest, with the prefix state saved and restored.
+	 */
+	for (i = 0; i <= sizeof a; i++) {
+		crypto_dae_chachadaence_hdr_init(&hdr, a, i, &ctx);
+		crypto_dae_chachadaence_hdr_encrypt(c0, m, sizeof m,
+		    a + i, sizeof a - i, &hdr, &ctx);
+		if (memcmp(c, c0, sizeof c) != 0)
+			goto out;
+		crypto_dae_chachadaence_hdr_export(&hdr, hdrbuf);
+		crypto_dae_chachadaence_hdr_destroy(&hdr);
+		hdrbuf[POLY1305X2_STATEBYTES] ^= 1;	/* |p| off by one */
+		if (crypto_dae_chachadaence_hdr_import(&hdr, hdrbuf,
+			&ctx) == 0)
+			goto out;
+		hdrbuf[POLY1305X2_STATEBYTES] ^= 1;
+		if (crypto_dae_chachadaence_hdr_import(&hdr, hdrbuf, &ctx))
+			goto out;
+		if (crypto_dae_chachadaence_hdr_open(m0, c, sizeof m,
+			a + i, sizeof a - i, &hdr, &ctx))
+			goto out;
+		if (memcmp(m, m0, sizeof m) != 0)
+			goto out;
+		c0[18] ^= 0x4;
+		if (crypto_dae_chachadaence_hdr_open(m0, c0, sizeof m,
+			a + i, sizeof a - i, &hdr, &ctx) == 0)
+			goto out;
+	}
+	ret = 0;
+
+out:	crypto_dae_chachadaence_hdr_destroy(&hdr);
+	crypto_dae_chachadaence_ctx_destroy(&ctx);
+	return ret;
 }
@@ -27,9 +27,25 @@
 #ifndef CHACHADAENCE_H
 #define	CHACHADAENCE_H
 
+#include <sys/uio.h>
+
+#include <stddef.h>
+
+#include "poly1305x2.h"
+
 #define	crypto_dae_chachadaence_KEYBYTES	64u
 #define	crypto_dae_chachadaence_TAGBYTES	24u
 
+/*
+ * Expanded key, for callers that encrypt many messages under one key:
+ * initialize once with crypto_dae_chachadaence_ctx_init, use for any
+ * number of messages, and erase with crypto_dae_chachadaence_ctx_destroy.
+ */
+struct crypto_dae_chachadaence_ctx {
+	unsigned char		k0[32];
+	struct poly1305x2_key	k12;
+};
+
 void crypto_dae_chachadaence(unsigned char */*c*/,
     const unsigned char */*m*/, unsigned long long /*mlen*/,
     const unsigned char */*a*/, unsigned long long /*alen*/,
@@ -40,6 +56,214 @@ int crypto_dae_chachadaence_open(unsigned char */*m*/,
     const unsigned char */*a*/, unsigned long long /*alen*/,
     const unsigned char[static crypto_dae_chachadaence_KEYBYTES]);
 
+void crypto_dae_chachadaence_ctx_init(struct crypto_dae_chachadaence_ctx *,
+    const unsigned char[static crypto_dae_chachadaence_KEYBYTES]);
+
+void crypto_dae_chachadaence_ctx_destroy(struct crypto_dae_chachadaence_ctx *);
+
+void crypto_dae_chachadaence_ctx_encrypt(unsigned char */*c*/,
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_chachadaence_ctx *);
+
+int crypto_dae_chachadaence_ctx_open(unsigned char */*m*/,
+    const unsigned char */*c*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_chachadaence_ctx *);
+
+/*
+ * Verify only: return 0 if c[0..24+mlen] is authentic with header a,
+ * or -1 if it is a forgery, as crypto_dae_chachadaence_open would, but
+ * without writing the plaintext anywhere.  It is decrypted a tile at a
+ * time into a few kilobytes of stack and discarded once hashed, so
+ * scrubbing stored ciphertexts needs no message-sized buffer.
+ */
+int crypto_dae_chachadaence_verify(const unsigned char */*c*/,
+    unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const unsigned char[static crypto_dae_chachadaence_KEYBYTES]);
+
+int crypto_dae_chachadaence_ctx_verify(const unsigned char */*c*/,
+    unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_chachadaence_ctx *);
+
+/*
+ * Detached tag: same as above, but the 24-byte tag t and the mlen-byte
+ * ciphertext c are kept apart instead of as c = t || ciphertext, so a
+ * message can be sealed and opened in place in its own buffer with
+ * c = m.  Otherwise c and m must not overlap.  On forgery, m is
+ * zeroed -- in place, that destroys the ciphertext too.
+ */
+void crypto_dae_chachadaence_detached(unsigned char */*c*/,
+    unsigned char[static crypto_dae_chachadaence_TAGBYTES],
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const unsigned char[static crypto_dae_chachadaence_KEYBYTES]);
+
+int crypto_dae_chachadaence_open_detached(unsigned char */*m*/,
+    const unsigned char */*c*/, unsigned long long /*mlen*/,
+    const unsigned char[static crypto_dae_chachadaence_TAGBYTES],
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const unsigned char[static crypto_dae_chachadaence_KEYBYTES]);
+
+void crypto_dae_chachadaence_ctx_encrypt_detached(unsigned char */*c*/,
+    unsigned char[static crypto_dae_chachadaence_TAGBYTES],
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_chachadaence_ctx *);
+
+int crypto_dae_chachadaence_ctx_open_detached(unsigned char */*m*/,
+    const unsigned char */*c*/, unsigned long long /*mlen*/,
+    const unsigned char[static crypto_dae_chachadaence_TAGBYTES],
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_chachadaence_ctx *);
+
+/*
+ * Tag only: set t to the 24-byte tag that crypto_dae_chachadaence would
+ * put in c[0..24] for m and a, without running the stream cipher or
+ * writing any ciphertext -- e.g. to look a message up by its tag in a
+ * deduplicating store before paying to encrypt it.  The tag is the
+ * message's synthetic IV, so it reveals which messages are equal, as
+ * the ciphertext would.
+ */
+void crypto_dae_chachadaence_tag(
+    unsigned char[static crypto_dae_chachadaence_TAGBYTES],
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const unsigned char[static crypto_dae_chachadaence_KEYBYTES]);
+
+void crypto_dae_chachadaence_ctx_tag(
+    unsigned char[static crypto_dae_chachadaence_TAGBYTES],
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_chachadaence_ctx *);
+
+/*
+ * Precomputed header prefix, for callers whose headers share a common
+ * prefix p: crypto_dae_chachadaence_hdr_init absorbs p once, and
+ * _hdr_encrypt and _hdr_open then process a message with header p || a
+ * by resuming from a copy of that state, so only a is hashed per
+ * message.  a may be empty.  The hdr may be used with only the ctx it
+ * was made from, and may be shared by many threads at once.
+ *
+ * The state can be saved in crypto_dae_chachadaence_HDRBYTES bytes with
+ * _hdr_export and restored with _hdr_import, which returns 0 on success
+ * or -1 if the buffer is malformed, e.g. if |p| disagrees with the
+ * partial block pending in the state.  The saved state is secret: with p,
+ * it can reveal Poly1305 key material.  Erase with _hdr_destroy.
+ */
+#define	crypto_dae_chachadaence_HDRBYTES	(POLY1305X2_STATEBYTES + 8)
+
+struct crypto_dae_chachadaence_hdr {
+	struct poly1305x2	poly1305;	/* p absorbed, not padded */
+	unsigned long long	alen;		/* |p| */
+};
+
+void crypto_dae_chachadaence_hdr_init(struct crypto_dae_chachadaence_hdr *,
+    const unsigned char */*p*/, unsigned long long /*plen*/,
+    const struct crypto_dae_chachadaence_ctx *);
+
+void crypto_dae_chachadaence_hdr_destroy(
+    struct crypto_dae_chachadaence_hdr *);
+
+void crypto_dae_chachadaence_hdr_export(
+    const struct crypto_dae_chachadaence_hdr *,
+    unsigned char[static crypto_dae_chachadaence_HDRBYTES]);
+
+int crypto_dae_chachadaence_hdr_import(struct crypto_dae_chachadaence_hdr *,
+    const unsigned char[static crypto_dae_chachadaence_HDRBYTES],
+    const struct crypto_dae_chachadaence_ctx *);
+
+void crypto_dae_chachadaence_hdr_encrypt(unsigned char */*c*/,
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_chachadaence_hdr *,
+    const struct crypto_dae_chachadaence_ctx *);
+
+int crypto_dae_chachadaence_hdr_open(unsigned char */*m*/,
+    const unsigned char */*c*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_chachadaence_hdr *,
+    const struct crypto_dae_chachadaence_ctx *);
+
+/*
+ * Batch of messages under one key.  To seal, m[0..mlen] and a[0..alen]
+ * are read and c[0..24+mlen] is written; to open, c[0..24+mlen] and
+ * a[0..alen] are read, m[0..mlen] is written, and ret is set to 0 if
+ * the message is authentic or -1 if it is a forgery, as with
+ * crypto_dae_chachadaence_open.  Processing several short messages
+ * together lets their HChaCha computations run side by side.
+ */
+struct crypto_dae_chachadaence_batch {
+	unsigned char		*c;
+	unsigned char		*m;
+	unsigned long long	mlen;
+	const unsigned char	*a;
+	unsigned long long	alen;
+	int			ret;
+};
+
+void crypto_dae_chachadaence_ctx_batch(struct crypto_dae_chachadaence_batch *,
+    size_t, const struct crypto_dae_chachadaence_ctx *);
+
+int crypto_dae_chachadaence_ctx_open_batch(
+    struct crypto_dae_chachadaence_batch *, size_t,
+    const struct crypto_dae_chachadaence_ctx *);
+
+/*
+ * Tags only, for a batch: c[0..24] is set to the tag, as
+ * crypto_dae_chachadaence_ctx_batch would, and the rest of c is left
+ * alone, so the same batch entries can be sealed afterward.
+ */
+void crypto_dae_chachadaence_ctx_tag_batch(
+    struct crypto_dae_chachadaence_batch *, size_t,
+    const struct crypto_dae_chachadaence_ctx *);
+
+/*
+ * Same as crypto_dae_chachadaence_ctx_encrypt and _ctx_open, but for a
+ * single large message split across up to nthreads threads, including
+ * the calling thread.  The output is the same.  Messages too short to
+ * be worth splitting are processed on the calling thread alone.
+ */
+void crypto_dae_chachadaence_ctx_parallel(unsigned char */*c*/,
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_chachadaence_ctx *, unsigned /*nthreads*/);
+
+int crypto_dae_chachadaence_ctx_open_parallel(unsigned char */*m*/,
+    const unsigned char */*c*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_chachadaence_ctx *, unsigned /*nthreads*/);
+
+/*
+ * Scatter/gather: same as crypto_dae_chachadaence and _open, with m,
+ * a, and c each given as an array of segments, which may be any
+ * lengths, e.g. for use with readv and writev.  mlen is the total
+ * length of the m segments, and the c segments must total exactly
+ * 24 + mlen.  To work in place, let the c segments be 24 bytes for
+ * the tag followed by the m segments themselves; c and m must not
+ * otherwise overlap.  Returns -1 if the lengths disagree or,
+ * for _openv, if the message is a forgery, in which case the m
+ * segments are zeroed; 0 otherwise.  Segments that are multiples of
+ * 64 bytes are fastest.
+ */
+int crypto_dae_chachadaence_encryptv(const struct iovec */*cv*/, int,
+    const struct iovec */*mv*/, int, const struct iovec */*av*/, int,
+    const unsigned char[static crypto_dae_chachadaence_KEYBYTES]);
+
+int crypto_dae_chachadaence_openv(const struct iovec */*mv*/, int,
+    const struct iovec */*cv*/, int, const struct iovec */*av*/, int,
+    const unsigned char[static crypto_dae_chachadaence_KEYBYTES]);
+
+int crypto_dae_chachadaence_ctx_encryptv(const struct iovec */*cv*/, int,
+    const struct iovec */*mv*/, int, const struct iovec */*av*/, int,
+    const struct crypto_dae_chachadaence_ctx *);
+
+int crypto_dae_chachadaence_ctx_openv(const struct iovec */*mv*/, int,
+    const struct iovec */*cv*/, int, const struct iovec */*av*/, int,
+    const struct crypto_dae_chachadaence_ctx *);
+
 int crypto_dae_chachadaence_selftest(void);
 
 #endif  /* CHACHADAENCE_H */
@@ -0,0 +1,6 @@
+#define CRYPTO_KEYBYTES 96
+#define CRYPTO_NSECBYTES 0
+#define CRYPTO_NPUBBYTES 0
+#define CRYPTO_ABYTES 24
+#define CRYPTO_VERSION "0.0a20200109.1"
+#define CRYPTO_NOOVERLAP 1
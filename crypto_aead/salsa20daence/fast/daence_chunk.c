@@ -0,0 +1 @@
+../../../daence_chunk.c
\ No newline at end of file
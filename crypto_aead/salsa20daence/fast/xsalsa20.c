@@ -0,0 +1 @@
+../../../xsalsa20.c
\ No newline at end of file
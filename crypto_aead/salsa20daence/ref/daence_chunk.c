@@ -0,0 +1,3 @@
+/* Portable reference build: chunks run in turn, no threads.  */
+#define	DAENCE_PORTABLE
+#include "daence_chunk.inc"
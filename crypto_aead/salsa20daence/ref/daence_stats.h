@@ -0,0 +1 @@
+../../../daence_stats.h
\ No newline at end of file
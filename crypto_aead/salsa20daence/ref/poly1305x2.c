@@ -0,0 +1,3 @@
+/* Portable reference build: radix 2^26 only, no AVX2 or int128.  */
+#define	DAENCE_PORTABLE
+#include "poly1305x2.inc"
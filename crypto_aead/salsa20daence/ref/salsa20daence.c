@@ -1 +0,0 @@
-../../../salsa20daence.c
\ No newline at end of file
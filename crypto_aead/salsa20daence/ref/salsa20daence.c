@@ -0,0 +1,3 @@
+/* Portable reference build: struct daence_chunk without threads.  */
+#define	DAENCE_PORTABLE
+#include "salsa20daence.inc"
@@ -0,0 +1,3 @@
+/* Portable reference build: one block at a time, no SSE2 or AVX2.  */
+#define	DAENCE_PORTABLE
+#include "xsalsa20.inc"
@@ -0,0 +1,3 @@
+#define CRYPTO_BYTES 24
+#define CRYPTO_KEYBYTES 96
+#define CRYPTO_VERSION "0.0a20200109.1"
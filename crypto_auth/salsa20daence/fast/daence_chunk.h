@@ -0,0 +1 @@
+../../../daence_chunk.h
\ No newline at end of file
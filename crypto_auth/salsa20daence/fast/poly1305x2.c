@@ -0,0 +1 @@
+../../../poly1305x2.c
\ No newline at end of file
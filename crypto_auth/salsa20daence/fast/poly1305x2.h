@@ -0,0 +1 @@
+../../../poly1305x2.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../salsa20daence.c
\ No newline at end of file
@@ -0,0 +1 @@
+../../../salsa20daence.h
\ No newline at end of file
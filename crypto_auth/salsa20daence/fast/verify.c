@@ -0,0 +1,13 @@
+#include "crypto_auth.h"
+#include "salsa20daence.h"
+
+int crypto_auth(unsigned char *h,const unsigned char *in,unsigned long long inlen,const unsigned char *k)
+{
+  crypto_dae_salsa20daence_auth(h,in,inlen,k);
+  return 0;
+}
+
+int crypto_auth_verify(const unsigned char *h,const unsigned char *in,unsigned long long inlen,const unsigned char *k)
+{
+  return crypto_dae_salsa20daence_auth_verify(h,in,inlen,k);
+}
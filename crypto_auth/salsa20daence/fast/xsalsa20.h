@@ -0,0 +1 @@
+../../../xsalsa20.h
\ No newline at end of file
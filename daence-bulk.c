@@ -0,0 +1,703 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * daence-bulk: seal or open many files, keeping reads, Daence, and
+ * writes for many of them in flight at once.
+ *
+ *	daence-bulk [-dps] [-c chacha|salsa20] [-a header] [-b bufsize]
+ *	    [-q depth] [-x suffix] keyfile [file ...]
+ *
+ * Each file f is sealed into f.daence (or f with the suffix given by
+ * -x), or with -d each sealed f.daence is opened into f.  File names
+ * come from the command line, or one per line from standard input if
+ * there are none.  Each file must fit in one buffer of bufsize bytes
+ * (default 1 MiB) plus the tag; use daence-file for larger ones.
+ *
+ * There are depth slots (default 32), each with its own buffer, and
+ * each slot carries one file at a time through open, read, seal, and
+ * write.  With io_uring, the buffers are registered with the kernel up
+ * front, so it need not pin pages for every I/O, and a file is sealed
+ * as soon as its read completes while the other slots' reads and
+ * writes proceed.  Without io_uring, or with -p, the same pipeline
+ * runs on plain pread and pwrite.  -s prints the backend, the depth,
+ * and the throughput to standard error at the end.
+ *
+ * As with daence-file, each output is written to a temporary file next
+ * to it, flushed to disk, and only then renamed into place; on any
+ * failure the temporary file is removed and the output is left alone.
+ */
+
+#define	_POSIX_C_SOURCE	200809L
+#ifdef __linux__
+#define	_DEFAULT_SOURCE		/* syscall(2), for io_uring */
+#endif
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "chachadaence.h"
+#include "daence_tool.h"
+#include "salsa20daence.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define	DAENCE_URING
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#define	MAXDEPTH	4096
+
+enum { IDLE, READING, WRITING };
+
+struct slot {
+	unsigned char	*buf;		/* 24 + bufsize bytes */
+	char		*path;		/* input */
+	char		*outpath;
+	char		*tmppath;	/* output until renamed, or NULL */
+	int		infd;
+	int		outfd;
+	int		state;
+	size_t		off;		/* of buf for I/O */
+	size_t		len;		/* bytes to transfer */
+	size_t		done;		/* bytes transferred so far */
+};
+
+struct bulk {
+	int		decrypt;
+	int		salsa20;
+	struct crypto_dae_chachadaence_ctx chacha;
+	struct crypto_dae_salsa20daence_ctx salsa;
+	const unsigned char *a;
+	size_t		alen;
+	const char	*suffix;
+	size_t		bufsize;
+	char		**argv;		/* NULL: read names from stdin */
+	int		argc;
+
+	/* Statistics.  */
+	unsigned long long nfiles, nfailed, nbytes;
+	unsigned	inflight, maxinflight;
+};
+
+/*
+ * I/O backend: submit starts a read or write for slot i, and wait
+ * returns at least one completion as (slot, result) -- bytes moved or
+ * minus errno, as with io_uring.
+ */
+struct completion {
+	unsigned	slot;
+	ssize_t		res;
+};
+
+struct backend {
+	const char	*name;
+	void		(*submit)(struct backend *, struct slot *, unsigned);
+	unsigned	(*wait)(struct backend *, struct completion *,
+			    unsigned);
+	struct completion *pending;	/* pread: completed, not reaped */
+	unsigned	npending;
+#ifdef DAENCE_URING
+	int		fd;
+	int		fixed;		/* buffers registered */
+	unsigned	*sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned	*cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	unsigned	nsubmit;	/* queued, not yet entered */
+#endif
+};
+
+/*
+ * pread/pwrite backend: do the I/O on the spot, and hand the result
+ * back at the next wait.
+ */
+static void
+pread_submit(struct backend *B, struct slot *S, unsigned i)
+{
+	ssize_t n;
+
+	do {
+		if (S[i].state == READING) {
+			n = pread(S[i].infd, S[i].buf + S[i].off + S[i].done,
+			    S[i].len - S[i].done, S[i].done);
+		} else {
+			n = pwrite(S[i].outfd, S[i].buf + S[i].off + S[i].done,
+			    S[i].len - S[i].done, S[i].done);
+		}
+	} while (n == -1 && errno == EINTR);
+	B->pending[B->npending].slot = i;
+	B->pending[B->npending].res = (n == -1 ? -errno : n);
+	B->npending++;
+}
+
+static unsigned
+pread_wait(struct backend *B, struct completion *C, unsigned max)
+{
+	unsigned n = (B->npending < max ? B->npending : max);
+
+	memcpy(C, B->pending, n * sizeof C[0]);
+	memmove(B->pending, B->pending + n,
+	    (B->npending - n) * sizeof C[0]);
+	B->npending -= n;
+	return n;
+}
+
+#ifdef DAENCE_URING
+
+/*
+ * io_uring backend, on the raw system calls so as not to need
+ * liburing.  Each slot has at most one operation outstanding, so with
+ * as many submission queue entries as slots the queue never fills.
+ */
+static void
+uring_submit(struct backend *B, struct slot *S, unsigned i)
+{
+	unsigned tail = *B->sq_tail, idx = tail & *B->sq_mask;
+	struct io_uring_sqe *sqe = &B->sqes[idx];
+	int write = (S[i].state == WRITING);
+
+	memset(sqe, 0, sizeof *sqe);
+	if (B->fixed) {
+		sqe->opcode = write ? IORING_OP_WRITE_FIXED :
+		    IORING_OP_READ_FIXED;
+		sqe->buf_index = i;
+	} else {
+		sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+	}
+	sqe->fd = write ? S[i].outfd : S[i].infd;
+	sqe->addr = (uintptr_t)(S[i].buf + S[i].off + S[i].done);
+	sqe->len = S[i].len - S[i].done;
+	sqe->off = S[i].done;
+	sqe->user_data = i;
+	B->sq_array[idx] = idx;
+	__atomic_store_n(B->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	B->nsubmit++;
+}
+
+static unsigned
+uring_wait(struct backend *B, struct completion *C, unsigned max)
+{
+	unsigned head, n = 0;
+	int ret;
+
+	do {
+		ret = syscall(__NR_io_uring_enter, B->fd, B->nsubmit, 1,
+		    IORING_ENTER_GETEVENTS, NULL, 0);
+	} while (ret == -1 && errno == EINTR);
+	if (ret == -1)
+		err(1, "io_uring_enter");
+	B->nsubmit -= ret;
+
+	head = *B->cq_head;
+	while (n < max && head != __atomic_load_n(B->cq_tail,
+		__ATOMIC_ACQUIRE)) {
+		const struct io_uring_cqe *cqe = &B->cqes[head & *B->cq_mask];
+
+		C[n].slot = cqe->user_data;
+		C[n].res = cqe->res;
+		n++;
+		head++;
+	}
+	__atomic_store_n(B->cq_head, head, __ATOMIC_RELEASE);
+
+	return n;
+}
+
+/*
+ * Set up a ring with depth entries and register the slot buffers.
+ * Returns 0 on success, or -1 if io_uring is unavailable, in which
+ * case the caller falls back to pread.  If only registration fails,
+ * e.g. for want of RLIMIT_MEMLOCK, carry on with unregistered buffers.
+ */
+static int
+uring_init(struct backend *B, struct slot *S, unsigned depth,
+    size_t slotsize)
+{
+	struct io_uring_params p;
+	struct iovec *iov;
+	size_t sqsize, cqsize;
+	unsigned char *sq, *cq;
+	unsigned i;
+
+	memset(&p, 0, sizeof p);
+	if ((B->fd = syscall(__NR_io_uring_setup, depth, &p)) == -1)
+		return -1;
+	if ((p.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+		(void)close(B->fd);
+		return -1;
+	}
+
+	sqsize = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+	cqsize = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+	if (cqsize > sqsize)
+		sqsize = cqsize;
+	sq = mmap(NULL, sqsize, PROT_READ|PROT_WRITE,
+	    MAP_SHARED, B->fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED) {
+		(void)close(B->fd);
+		return -1;
+	}
+	cq = sq;
+	B->sqes = mmap(NULL, p.sq_entries*sizeof(struct io_uring_sqe),
+	    PROT_READ|PROT_WRITE, MAP_SHARED, B->fd,
+	    IORING_OFF_SQES);
+	if (B->sqes == MAP_FAILED) {
+		(void)munmap(sq, sqsize);
+		(void)close(B->fd);
+		return -1;
+	}
+	B->sq_head = (unsigned *)(sq + p.sq_off.head);
+	B->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	B->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	B->sq_array = (unsigned *)(sq + p.sq_off.array);
+	B->cq_head = (unsigned *)(cq + p.cq_off.head);
+	B->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	B->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	B->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	B->nsubmit = 0;
+
+	if ((iov = calloc(depth, sizeof iov[0])) == NULL)
+		err(1, "calloc");
+	for (i = 0; i < depth; i++) {
+		iov[i].iov_base = S[i].buf;
+		iov[i].iov_len = slotsize;
+	}
+	B->fixed = syscall(__NR_io_uring_register, B->fd,
+	    IORING_REGISTER_BUFFERS, iov, depth) == 0;
+	free(iov);
+
+	B->name = B->fixed ? "io_uring" : "io_uring (unregistered buffers)";
+	B->submit = uring_submit;
+	B->wait = uring_wait;
+	return 0;
+}
+
+#endif	/* DAENCE_URING */
+
+static char *
+nextpath(struct bulk *K)
+{
+	static char *line;
+	static size_t linesize;
+	ssize_t n;
+	char *path;
+
+	if (K->argv) {
+		if (K->argc == 0)
+			return NULL;
+		K->argc--;
+		path = strdup(*K->argv++);
+	} else {
+		do {
+			if ((n = getline(&line, &linesize, stdin)) == -1) {
+				if (ferror(stdin))
+					err(1, "stdin");
+				free(line);
+				line = NULL;
+				return NULL;
+			}
+			if (n && line[n - 1] == '\n')
+				line[--n] = '\0';
+		} while (n == 0);
+		path = strdup(line);
+	}
+	if (path == NULL)
+		err(1, "strdup");
+	return path;
+}
+
+static char *
+outname(const struct bulk *K, const char *path)
+{
+	size_t n = strlen(path), s = strlen(K->suffix);
+	char *out;
+
+	if (K->decrypt) {
+		if (n <= s || strcmp(path + n - s, K->suffix) != 0)
+			return NULL;
+		if ((out = strdup(path)) == NULL)
+			err(1, "strdup");
+		out[n - s] = '\0';
+	} else {
+		if ((out = malloc(n + s + 1)) == NULL)
+			err(1, "malloc");
+		memcpy(out, path, n);
+		memcpy(out + n, K->suffix, s + 1);
+	}
+	return out;
+}
+
+static void
+finish(struct bulk *K, struct slot *S, const char *fmt, int error)
+{
+
+	if (fmt) {
+		if (error) {
+			errno = error;
+			warn(fmt, S->path);
+		} else {
+			warnx(fmt, S->path);
+		}
+		K->nfailed++;
+		if (S->outfd != -1)
+			(void)close(S->outfd);
+	} else if (daence_tool_commit(S->outfd, S->tmppath, S->outpath)
+	    == -1) {
+		warn("write %s", S->outpath);
+		K->nfailed++;
+	} else {
+		K->nfiles++;
+		K->nbytes += S->len - (K->decrypt ? 0 : 24); /* plaintext */
+		free(S->tmppath);
+		S->tmppath = NULL;
+	}
+	if (S->tmppath)
+		(void)unlink(S->tmppath);
+	if (S->infd != -1)
+		(void)close(S->infd);
+	if (S->state != IDLE)
+		K->inflight--;
+	free(S->path);
+	free(S->outpath);
+	free(S->tmppath);
+	S->path = S->outpath = S->tmppath = NULL;
+	S->infd = S->outfd = -1;
+	S->state = IDLE;
+}
+
+/*
+ * Start the next file in an idle slot: open it and submit the read.
+ * Returns 0 if there are no more files.
+ */
+static int
+start(struct bulk *K, struct backend *B, struct slot *S, unsigned i)
+{
+	struct stat st;
+
+	for (;;) {
+		if ((S[i].path = nextpath(K)) == NULL)
+			return 0;
+		S[i].state = READING;
+		K->inflight++;
+		if (K->inflight > K->maxinflight)
+			K->maxinflight = K->inflight;
+		if ((S[i].outpath = outname(K, S[i].path)) == NULL) {
+			finish(K, &S[i], "%s: no suffix", 0);
+			continue;
+		}
+		if ((S[i].infd = open(S[i].path, O_RDONLY)) == -1) {
+			finish(K, &S[i], "open %s", errno);
+			continue;
+		}
+		if (fstat(S[i].infd, &st) == -1) {
+			finish(K, &S[i], "fstat %s", errno);
+			continue;
+		}
+		if (!S_ISREG(st.st_mode)) {
+			finish(K, &S[i], "%s: not a regular file", 0);
+			continue;
+		}
+		if ((unsigned long long)st.st_size >
+		    K->bufsize + (K->decrypt ? 24 : 0)) {
+			finish(K, &S[i], "%s: larger than buffer", 0);
+			continue;
+		}
+		if (K->decrypt && st.st_size < 24) {
+			finish(K, &S[i], "%s: too short", 0);
+			continue;
+		}
+
+		/*
+		 * Seal: read m into buf[24..], leaving room for the
+		 * tag.  Open: read t || c into buf[0..].
+		 */
+		S[i].off = K->decrypt ? 0 : 24;
+		S[i].len = st.st_size;
+		S[i].done = 0;
+		if (S[i].len == 0)
+			return 1;	/* nothing to read; caller seals */
+		B->submit(B, S, i);
+		return 1;
+	}
+}
+
+/*
+ * The read of slot i is complete: seal or open in place, then create the
+ * temporary output and submit the write.
+ */
+static void
+seal(struct bulk *K, struct backend *B, struct slot *S, unsigned i)
+{
+	unsigned char *t = S[i].buf, *x = S[i].buf + 24;
+	size_t mlen = S[i].len - (K->decrypt ? 24 : 0);
+	int ret = 0;
+
+	if (K->decrypt && K->salsa20) {
+		ret = crypto_dae_salsa20daence_ctx_open_detached(x, x, mlen,
+		    t, K->a, K->alen, &K->salsa);
+	} else if (K->decrypt) {
+		ret = crypto_dae_chachadaence_ctx_open_detached(x, x, mlen,
+		    t, K->a, K->alen, &K->chacha);
+	} else if (K->salsa20) {
+		crypto_dae_salsa20daence_ctx_encrypt_detached(x, t, x, mlen,
+		    K->a, K->alen, &K->salsa);
+	} else {
+		crypto_dae_chachadaence_ctx_encrypt_detached(x, t, x, mlen,
+		    K->a, K->alen, &K->chacha);
+	}
+	if (ret) {
+		finish(K, &S[i], "%s: forgery", 0);
+		return;
+	}
+
+	S[i].outfd = daence_tool_mktemp(S[i].outpath, &S[i].tmppath);
+	if (S[i].outfd == -1) {
+		finish(K, &S[i], "open output for %s", errno);
+		return;
+	}
+	S[i].state = WRITING;
+	S[i].off = K->decrypt ? 24 : 0;
+	S[i].len = K->decrypt ? mlen : 24 + mlen;
+	S[i].done = 0;
+	if (S[i].len == 0) {
+		finish(K, &S[i], NULL, 0);
+		return;
+	}
+	B->submit(B, S, i);
+}
+
+static void
+complete(struct bulk *K, struct backend *B, struct slot *S,
+    const struct completion *C)
+{
+	unsigned i = C->slot;
+
+	if (C->res < 0) {
+		finish(K, &S[i], S[i].state == READING ? "read %s" :
+		    "write output for %s", -C->res);
+		return;
+	}
+	if (C->res == 0) {
+		finish(K, &S[i], S[i].state == READING ?
+		    "%s: file shrank" : "%s: short write", 0);
+		return;
+	}
+	S[i].done += C->res;
+	if (S[i].done < S[i].len) {
+		B->submit(B, S, i);
+		return;
+	}
+	if (S[i].state == READING) {
+		seal(K, B, S, i);
+		return;
+	}
+	finish(K, &S[i], NULL, 0);
+}
+
+static void __attribute__((__noreturn__))
+usage(void)
+{
+
+	fprintf(stderr, "usage: daence-bulk [-dps] [-c chacha|salsa20]"
+	    " [-a header] [-b bufsize]\n"
+	    "           [-q depth] [-x suffix] keyfile [file ...]\n");
+	exit(1);
+}
+
+static unsigned long long
+number(const char *s, unsigned long long max)
+{
+	unsigned long long v;
+	char *end;
+
+	errno = 0;
+	v = strtoull(s, &end, 0);
+	if (end == s || *end != '\0' || errno || v == 0 || v > max)
+		usage();
+	return v;
+}
+
+int
+main(int argc, char **argv)
+{
+	static struct bulk K;
+	struct backend B;
+	struct completion *C;
+	struct slot *S;
+	unsigned char k[96], *pool;
+	const char *cipher = "chacha";
+	struct timespec t0, t1;
+	size_t slotsize, pagesize;
+	unsigned depth = 32, i, n, busy;
+	int pread_only = 0, stats = 0, more, ch;
+	double s;
+
+	K.a = (const unsigned char *)"";
+	K.suffix = ".daence";
+	K.bufsize = 1048576;
+	while ((ch = getopt(argc, argv, "a:b:c:dpq:sx:")) != -1) {
+		switch (ch) {
+		case 'a':
+			K.a = (const unsigned char *)optarg;
+			break;
+		case 'b':
+			K.bufsize = number(optarg, 1ull << 30);
+			break;
+		case 'c':
+			cipher = optarg;
+			break;
+		case 'd':
+			K.decrypt = 1;
+			break;
+		case 'p':
+			pread_only = 1;
+			break;
+		case 'q':
+			depth = number(optarg, MAXDEPTH);
+			break;
+		case 's':
+			stats = 1;
+			break;
+		case 'x':
+			K.suffix = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc < 1)
+		usage();
+	if (argc > 1) {
+		K.argv = argv + 1;
+		K.argc = argc - 1;
+	}
+	K.alen = strlen((const char *)K.a);
+
+	if (strcmp(cipher, "chacha") == 0)
+		K.salsa20 = 0;
+	else if (strcmp(cipher, "salsa20") == 0)
+		K.salsa20 = 1;
+	else
+		usage();
+	daence_tool_readkey(k, K.salsa20 ? crypto_dae_salsa20daence_KEYBYTES :
+	    crypto_dae_chachadaence_KEYBYTES, argv[0]);
+	if (K.salsa20)
+		crypto_dae_salsa20daence_ctx_init(&K.salsa, k);
+	else
+		crypto_dae_chachadaence_ctx_init(&K.chacha, k);
+	daence_tool_explicit_memset(k, 0, sizeof k);
+
+	/* One page-aligned buffer per slot, from a single allocation.  */
+	pagesize = sysconf(_SC_PAGESIZE);
+	slotsize = (24 + K.bufsize + pagesize - 1) & ~(pagesize - 1);
+	if ((errno = posix_memalign((void **)&pool, pagesize,
+		    depth*slotsize)) != 0)
+		err(1, "posix_memalign");
+	if ((S = calloc(depth, sizeof S[0])) == NULL ||
+	    (C = calloc(depth, sizeof C[0])) == NULL ||
+	    (B.pending = calloc(depth, sizeof C[0])) == NULL)
+		err(1, "calloc");
+	for (i = 0; i < depth; i++) {
+		S[i].buf = pool + i*slotsize;
+		S[i].infd = S[i].outfd = -1;
+		S[i].state = IDLE;
+	}
+
+	B.npending = 0;
+	B.name = "pread";
+	B.submit = pread_submit;
+	B.wait = pread_wait;
+#ifdef DAENCE_URING
+	if (!pread_only)
+		(void)uring_init(&B, S, depth, slotsize);
+#else
+	(void)pread_only;
+#endif
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	more = 1;
+	for (;;) {
+		/*
+		 * Fill idle slots.  Empty files skip straight to seal,
+		 * which may fail and leave the slot idle again, so keep
+		 * at each slot until it is busy or there are no more.
+		 */
+		for (i = 0; more && i < depth; i++) {
+			while (more && S[i].state == IDLE) {
+				if (!(more = start(&K, &B, S, i)))
+					break;
+				if (S[i].state == READING && S[i].len == 0)
+					seal(&K, &B, S, i);
+			}
+		}
+		for (i = busy = 0; i < depth; i++)
+			busy += (S[i].state != IDLE);
+		if (busy == 0) {
+			if (!more)
+				break;
+			continue;
+		}
+		n = B.wait(&B, C, depth);
+		for (i = 0; i < n; i++)
+			complete(&K, &B, S, &C[i]);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	if (stats) {
+		s = (t1.tv_sec - t0.tv_sec) + 1e-9*(t1.tv_nsec - t0.tv_nsec);
+		fprintf(stderr, "%s, depth %u (max in flight %u):"
+		    " %llu files, %llu failed, %llu bytes in %.3f s,"
+		    " %.1f MB/s, %.0f files/s\n",
+		    B.name, depth, K.maxinflight, K.nfiles, K.nfailed,
+		    K.nbytes, s, s > 0 ? K.nbytes/s/1e6 : 0,
+		    s > 0 ? K.nfiles/s : 0);
+	}
+
+	daence_tool_explicit_memset(pool, 0, depth*slotsize);
+	free(pool);
+	if (K.salsa20)
+		crypto_dae_salsa20daence_ctx_destroy(&K.salsa);
+	else
+		crypto_dae_chachadaence_ctx_destroy(&K.chacha);
+
+	return K.nfailed ? 1 : 0;
+}
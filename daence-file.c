@@ -0,0 +1,294 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * daence-file: seal or open a file with ChaCha-Daence or Salsa20-Daence.
+ *
+ *	daence-file [-d] [-c chacha|salsa20] [-a header] [-j nthreads]
+ *	    keyfile in out
+ *
+ * The input is mapped into memory and the output is preallocated and
+ * mapped too, so nothing is copied through a buffer and peak memory is
+ * whatever the page cache lends us.  Large files are split across
+ * threads for both the Poly1305 pass and the stream cipher pass.  The
+ * keyfile holds the raw key: 64 bytes for chacha, 96 for salsa20.  The
+ * sealed file is the 24-byte tag followed by the ciphertext.
+ *
+ * The output is written to a temporary file next to it and renamed into
+ * place only once it is authentic and on disk, so out may be the same
+ * file as in, and nothing unauthenticated ever appears under its name.
+ * On forgery or any other failure, the temporary file is removed, out
+ * is left alone, and the exit status is 1.
+ */
+
+#define	_POSIX_C_SOURCE	200809L
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chachadaence.h"
+#include "daence_tool.h"
+#include "salsa20daence.h"
+
+#define	MAXMLEN	(1ull << 38)	/* Daence message limit */
+
+static char *tmppath;		/* output until renamed, or NULL */
+
+static void __attribute__((__noreturn__))
+usage(void)
+{
+
+	fprintf(stderr, "usage: daence-file [-d] [-c chacha|salsa20]"
+	    " [-a header] [-j nthreads]\n"
+	    "           keyfile in out\n");
+	exit(1);
+}
+
+static void
+rmtmp(void)
+{
+
+	if (tmppath)
+		(void)unlink(tmppath);
+}
+
+/*
+ * Allocate len bytes of fd so that running out of space is an error
+ * here, not a SIGBUS while writing through the mapping: with
+ * posix_fallocate, or where the file system can't, by writing zeros.
+ */
+static void
+prealloc(int fd, size_t len, const char *path)
+{
+	static const unsigned char zero[65536];
+	size_t off, n;
+	ssize_t nwrit;
+	int error;
+
+	if (len == 0)
+		return;
+	if ((error = posix_fallocate(fd, 0, len)) == 0)
+		return;
+	if (error != EINVAL && error != EOPNOTSUPP) {
+		errno = error;
+		err(1, "posix_fallocate %s", path);
+	}
+	for (off = 0; off < len; off += nwrit) {
+		n = (len - off < sizeof zero ? len - off : sizeof zero);
+		if ((nwrit = pwrite(fd, zero, n, off)) == -1) {
+			if (errno == EINTR) {
+				nwrit = 0;
+				continue;
+			}
+			err(1, "write %s", path);
+		}
+	}
+}
+
+/*
+ * Map len bytes of fd, or return a pointer to nothing if len is zero,
+ * which mmap won't do.  We touch each chunk of the mapping from start
+ * to end, so tell the kernel to read ahead aggressively.
+ */
+static unsigned char *
+map(int fd, size_t len, int prot, const char *path)
+{
+	static unsigned char empty[1];
+	void *p;
+
+	if (len == 0)
+		return empty;
+	p = mmap(NULL, len, prot,
+	    (prot & PROT_WRITE ? MAP_SHARED : MAP_PRIVATE), fd, 0);
+	if (p == MAP_FAILED)
+		err(1, "mmap %s", path);
+	(void)posix_madvise(p, len, POSIX_MADV_SEQUENTIAL);
+
+	return p;
+}
+
+static void
+unmap(unsigned char *p, size_t len, const char *path)
+{
+
+	if (len == 0)
+		return;
+	if (munmap(p, len) == -1)
+		err(1, "munmap %s", path);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct crypto_dae_chachadaence_ctx chacha;
+	struct crypto_dae_salsa20daence_ctx salsa;
+	unsigned char k[96];
+	const char *cipher = "chacha", *a = "", *keypath, *inpath, *outpath;
+	unsigned char *in, *out;
+	unsigned long long mlen;
+	size_t inlen, outlen;
+	struct stat st;
+	unsigned long nthreads;
+	long ncpu;
+	char *end;
+	int decrypt = 0, salsa20, infd, outfd, ret = 0, ch;
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	nthreads = (ncpu > 0 ? (unsigned long)ncpu : 1);
+
+	while ((ch = getopt(argc, argv, "a:c:dj:")) != -1) {
+		switch (ch) {
+		case 'a':
+			a = optarg;
+			break;
+		case 'c':
+			cipher = optarg;
+			break;
+		case 'd':
+			decrypt = 1;
+			break;
+		case 'j':
+			errno = 0;
+			nthreads = strtoul(optarg, &end, 0);
+			if (end == optarg || *end != '\0' || errno ||
+			    nthreads == 0 || nthreads > 1024)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 3)
+		usage();
+	keypath = argv[0];
+	inpath = argv[1];
+	outpath = argv[2];
+
+	if (strcmp(cipher, "chacha") == 0)
+		salsa20 = 0;
+	else if (strcmp(cipher, "salsa20") == 0)
+		salsa20 = 1;
+	else
+		usage();
+
+	daence_tool_readkey(k, salsa20 ? crypto_dae_salsa20daence_KEYBYTES :
+	    crypto_dae_chachadaence_KEYBYTES, keypath);
+
+	/* Map the input and work out the sizes.  */
+	if ((infd = open(inpath, O_RDONLY)) == -1)
+		err(1, "open %s", inpath);
+	if (fstat(infd, &st) == -1)
+		err(1, "fstat %s", inpath);
+	if (!S_ISREG(st.st_mode))
+		errx(1, "%s: not a regular file", inpath);
+	if ((unsigned long long)st.st_size > MAXMLEN + 24 ||
+	    (unsigned long long)st.st_size > SIZE_MAX - 24)
+		errx(1, "%s: too large", inpath);
+	inlen = st.st_size;
+	if (decrypt) {
+		if (inlen < 24)
+			errx(1, "%s: too short", inpath);
+		mlen = inlen - 24;
+		outlen = mlen;
+	} else {
+		if (inlen > MAXMLEN)
+			errx(1, "%s: too large", inpath);
+		mlen = inlen;
+		outlen = 24 + mlen;
+	}
+	in = map(infd, inlen, PROT_READ, inpath);
+
+	/* Create, preallocate, and map the temporary output.  */
+	if ((outfd = daence_tool_mktemp(outpath, &tmppath)) == -1)
+		err(1, "mkstemp %s", outpath);
+	if (atexit(rmtmp) != 0)
+		errx(1, "atexit");
+	prealloc(outfd, outlen, tmppath);
+	out = map(outfd, outlen, PROT_READ|PROT_WRITE, tmppath);
+
+	if (salsa20) {
+		crypto_dae_salsa20daence_ctx_init(&salsa, k);
+		if (decrypt) {
+			ret = crypto_dae_salsa20daence_ctx_open_parallel(out,
+			    in, mlen, (const unsigned char *)a, strlen(a),
+			    &salsa, nthreads);
+		} else {
+			crypto_dae_salsa20daence_ctx_parallel(out, in, mlen,
+			    (const unsigned char *)a, strlen(a), &salsa,
+			    nthreads);
+		}
+		crypto_dae_salsa20daence_ctx_destroy(&salsa);
+	} else {
+		crypto_dae_chachadaence_ctx_init(&chacha, k);
+		if (decrypt) {
+			ret = crypto_dae_chachadaence_ctx_open_parallel(out,
+			    in, mlen, (const unsigned char *)a, strlen(a),
+			    &chacha, nthreads);
+		} else {
+			crypto_dae_chachadaence_ctx_parallel(out, in, mlen,
+			    (const unsigned char *)a, strlen(a), &chacha,
+			    nthreads);
+		}
+		crypto_dae_chachadaence_ctx_destroy(&chacha);
+	}
+	daence_tool_explicit_memset(k, 0, sizeof k);
+
+	/*
+	 * On forgery the output has already been zeroed; truncate it
+	 * too, in case unlinking fails, and let rmtmp remove it.
+	 */
+	if (ret) {
+		(void)ftruncate(outfd, 0);
+		errx(1, "%s: forgery", inpath);
+	}
+
+	/*
+	 * Write the output back and check that it made it, metadata
+	 * and all, before it takes the place of whatever was at out.
+	 */
+	if (outlen && msync(out, outlen, MS_SYNC) == -1)
+		err(1, "msync %s", tmppath);
+	unmap(in, inlen, inpath);
+	unmap(out, outlen, tmppath);
+	(void)close(infd);
+	if (daence_tool_commit(outfd, tmppath, outpath) == -1)
+		err(1, "write %s", outpath);
+	free(tmppath);
+	tmppath = NULL;
+
+	return 0;
+}
@@ -0,0 +1,181 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#define	_POSIX_C_SOURCE	200809L
+
+#include "daence_chunk.h"
+
+#include <string.h>
+
+#define	TILE	4096		/* bytes of stream before hashing them */
+
+static void *
+chunk_run(void *cookie)
+{
+	struct daence_chunk *C = cookie;
+	const unsigned char *p = C->in;
+	unsigned long long i, n;
+
+	if (C->k12)
+		poly1305x2_init(&C->poly1305, C->k12);
+	for (i = 0; i < C->len; i += n) {
+		n = (C->len - i < TILE ? C->len - i : TILE);
+		if (C->stream) {
+			C->stream(C->key, C->out + i, C->in + i, n,
+			    (C->off + i)/64);
+			p = C->out;
+		}
+		if (C->k12) {
+			poly1305x2_update(&C->poly1305, p + i,
+			    (n & ~15ull));
+		}
+	}
+
+	return NULL;
+}
+
+unsigned
+daence_chunk_split(struct daence_chunk *C, unsigned nthreads,
+    unsigned long long mlen)
+{
+	unsigned long long size;
+	unsigned i, n;
+
+	if (nthreads > DAENCE_CHUNK_MAXTHREADS)
+		nthreads = DAENCE_CHUNK_MAXTHREADS;
+	if (nthreads > mlen/DAENCE_CHUNK_MINLEN)
+		nthreads = mlen/DAENCE_CHUNK_MINLEN;
+	if (nthreads == 0)
+		nthreads = 1;
+	size = ((mlen + nthreads - 1)/nthreads + 63) & ~63ull;
+
+	for (i = n = 0; i < nthreads && (i == 0 || size*i < mlen); i++, n++) {
+		memset(&C[i], 0, sizeof C[i]);
+		C[i].off = size*i;
+		C[i].len = (mlen - C[i].off < size ? mlen - C[i].off : size);
+	}
+
+	return n;
+}
+
+void
+daence_chunk_runall(struct daence_chunk *C, unsigned n)
+{
+	unsigned i;
+
+#ifdef DAENCE_PORTABLE
+	for (i = 0; i < n; i++)
+		(void)chunk_run(&C[i]);
+#else
+	/* Run chunks 1..n-1 on new threads, chunk 0 on this one.  */
+	for (i = 1; i < n; i++) {
+		C[i].running =
+		    pthread_create(&C[i].thread, NULL, chunk_run, &C[i]) == 0;
+		if (!C[i].running)
+			(void)chunk_run(&C[i]);
+	}
+	(void)chunk_run(&C[0]);
+	for (i = 1; i < n; i++) {
+		if (C[i].running)
+			(void)pthread_join(C[i].thread, NULL);
+	}
+#endif
+}
+
+void
+daence_chunk_join(struct poly1305x2 *P, struct daence_chunk *C, unsigned n,
+    const unsigned char *m, unsigned long long mlen)
+{
+	unsigned long long done = 0;
+	unsigned i;
+
+	for (i = 0; i < n; i++) {
+		poly1305x2_combine(P, &C[i].poly1305, C[i].len/16);
+		poly1305x2_clear(&C[i].poly1305);
+		done += C[i].len & ~15ull;
+	}
+	poly1305x2_update(P, m + done, mlen - done);
+}
+
+unsigned long long
+daence_iov_total(const struct iovec *iov, int iovcnt)
+{
+	unsigned long long n = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		n += iov[i].iov_len;
+
+	return n;
+}
+
+size_t
+daence_iovcur_next(struct daence_iovcur *C, unsigned char **pp,
+    unsigned long long max)
+{
+	size_t n;
+
+	while (C->iovcnt && C->off == C->iov->iov_len) {
+		C->iov++;
+		C->iovcnt--;
+		C->off = 0;
+	}
+	if (C->iovcnt == 0)
+		return 0;
+
+	n = C->iov->iov_len - C->off;
+	if (n > max)
+		n = max;
+	*pp = (unsigned char *)C->iov->iov_base + C->off;
+	C->off += n;
+
+	return n;
+}
+
+void
+daence_iovcur_write(struct daence_iovcur *C, const unsigned char *buf,
+    size_t len)
+{
+	unsigned char *p;
+	size_t n;
+
+	for (; len; buf += n, len -= n) {
+		n = daence_iovcur_next(C, &p, len);
+		memcpy(p, buf, n);
+	}
+}
+
+void
+daence_iovcur_read(struct daence_iovcur *C, unsigned char *buf, size_t len)
+{
+	unsigned char *p;
+	size_t n;
+
+	for (; len; buf += n, len -= n) {
+		n = daence_iovcur_next(C, &p, len);
+		memcpy(buf, p, n);
+	}
+}
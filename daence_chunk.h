@@ -0,0 +1,126 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef DAENCE_CHUNK_H
+#define	DAENCE_CHUNK_H
+
+/*
+ * Helpers shared by chachadaence.c and salsa20daence.c for long
+ * messages: splitting one message into chunks processed on parallel
+ * threads, and walking scatter/gather arrays of struct iovec.
+ */
+
+#include <sys/uio.h>
+
+#ifndef DAENCE_PORTABLE
+#include <pthread.h>
+#endif
+#include <stdint.h>
+
+#include "poly1305x2.h"
+
+#define	DAENCE_CHUNK_MAXTHREADS	64
+#define	DAENCE_CHUNK_MINLEN	65536	/* don't spawn threads for less */
+
+/*
+ * Parallel processing of one large message.  The message is cut into
+ * one chunk per thread, at multiples of 64 bytes so each chunk starts
+ * on a cipher block boundary and a Poly1305 block boundary.  Each
+ * thread runs the stream cipher over its chunk and/or hashes its
+ * chunk's whole 16-byte blocks from a fresh Poly1305^2 state; the
+ * calling thread then joins the chunk states in order with
+ * daence_chunk_join.  With DAENCE_PORTABLE defined, the chunks all run
+ * in turn on the calling thread, so no threads library is needed.
+ */
+
+/*
+ * out[0..n] := in[0..n] ^ the keystream for key from 64-byte block blk
+ * on.  Must be safe to call from several threads at once.
+ */
+typedef void daence_chunk_stream_fn(const void */*key*/,
+    unsigned char */*out*/, const unsigned char */*in*/,
+    unsigned long long /*n*/, uint64_t /*blk*/);
+
+struct daence_chunk {
+	unsigned char			*out;	/* NULL: hash only */
+	const unsigned char		*in;
+	unsigned long long		off;
+	unsigned long long		len;
+	daence_chunk_stream_fn		*stream; /* NULL: no stream */
+	const void			*key;	/* for stream */
+	const struct poly1305x2_key	*k12;	/* NULL: no hash */
+	struct poly1305x2		poly1305;
+#ifndef DAENCE_PORTABLE
+	pthread_t			thread;
+	int				running;
+#endif
+};
+
+/*
+ * Zero C[0..n] and set their offsets and lengths for an mlen-byte
+ * message on up to nthreads threads; return n, at most
+ * DAENCE_CHUNK_MAXTHREADS.  The caller fills in the rest.
+ */
+unsigned daence_chunk_split(struct daence_chunk *, unsigned /*nthreads*/,
+    unsigned long long /*mlen*/);
+
+/* Run C[0..n], chunk 0 on this thread and the rest on new ones.  */
+void daence_chunk_runall(struct daence_chunk *, unsigned /*n*/);
+
+/*
+ * Join the chunk hashes of C[0..n] onto P in order, clearing them, and
+ * absorb the last few bytes of the mlen-byte hashed text m that no
+ * chunk hashed.
+ */
+void daence_chunk_join(struct poly1305x2 *, struct daence_chunk *,
+    unsigned /*n*/, const unsigned char */*m*/, unsigned long long /*mlen*/);
+
+/*
+ * Scatter/gather cursor over an array of struct iovec, with segment
+ * boundaries anywhere.
+ */
+struct daence_iovcur {
+	const struct iovec	*iov;
+	int			iovcnt;
+	size_t			off;	/* bytes of iov[0] already used */
+};
+
+/* Total length of iov[0..iovcnt].  */
+unsigned long long daence_iov_total(const struct iovec *, int);
+
+/*
+ * Set *pp to the next contiguous run of at most max bytes under the
+ * cursor, advance past it, and return its length, or 0 at the end.
+ */
+size_t daence_iovcur_next(struct daence_iovcur *, unsigned char **,
+    unsigned long long /*max*/);
+
+/* Copy len bytes into or out of the segments under the cursor.  */
+void daence_iovcur_write(struct daence_iovcur *, const unsigned char *,
+    size_t);
+void daence_iovcur_read(struct daence_iovcur *, unsigned char *, size_t);
+
+#endif	/* DAENCE_CHUNK_H */
@@ -0,0 +1,118 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "daence_stats.h"
+
+#include <string.h>
+
+#ifdef DAENCE_STATS
+struct daence_stats daence_stats_global;
+#endif
+
+int
+daence_stats_enabled(void)
+{
+
+#ifdef DAENCE_STATS
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+void
+daence_stats_snapshot(struct daence_stats *S)
+{
+#ifdef DAENCE_STATS
+	const struct daence_stats_counter *C;
+	unsigned i, j;
+
+	for (i = 0; i < DAENCE_NIMPL; i++) {
+		for (j = 0; j < DAENCE_NPHASE; j++) {
+			C = &daence_stats_global.c[i][j];
+			S->c[i][j].calls =
+			    __atomic_load_n(&C->calls, __ATOMIC_RELAXED);
+			S->c[i][j].bytes =
+			    __atomic_load_n(&C->bytes, __ATOMIC_RELAXED);
+			S->c[i][j].cycles =
+			    __atomic_load_n(&C->cycles, __ATOMIC_RELAXED);
+		}
+	}
+#else
+	memset(S, 0, sizeof *S);
+#endif
+}
+
+void
+daence_stats_reset(void)
+{
+#ifdef DAENCE_STATS
+	struct daence_stats_counter *C;
+	unsigned i, j;
+
+	for (i = 0; i < DAENCE_NIMPL; i++) {
+		for (j = 0; j < DAENCE_NPHASE; j++) {
+			C = &daence_stats_global.c[i][j];
+			__atomic_store_n(&C->calls, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&C->bytes, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&C->cycles, 0, __ATOMIC_RELAXED);
+		}
+	}
+#endif
+}
+
+const char *
+daence_stats_impl_name(enum daence_impl impl)
+{
+	static const char *const names[DAENCE_NIMPL] = {
+		[DAENCE_IMPL_CHACHA] = "chachadaence",
+		[DAENCE_IMPL_SALSA20] = "salsa20daence",
+		[DAENCE_IMPL_BEAR] = "beardaence",
+	};
+
+	if ((unsigned)impl >= DAENCE_NIMPL)
+		return NULL;
+	return names[impl];
+}
+
+const char *
+daence_stats_phase_name(enum daence_phase phase)
+{
+	static const char *const names[DAENCE_NPHASE] = {
+		[DAENCE_PHASE_SEAL] = "seal",
+		[DAENCE_PHASE_OPEN] = "open",
+		[DAENCE_PHASE_COMPRESS] = "compress",
+		[DAENCE_PHASE_TAG] = "tag",
+		[DAENCE_PHASE_STREAM] = "stream",
+		[DAENCE_PHASE_FUSED] = "fused",
+		[DAENCE_PHASE_VERIFY] = "verify",
+		[DAENCE_PHASE_AUTH] = "auth",
+	};
+
+	if ((unsigned)phase >= DAENCE_NPHASE)
+		return NULL;
+	return names[phase];
+}
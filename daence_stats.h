@@ -0,0 +1,147 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef DAENCE_STATS_H
+#define	DAENCE_STATS_H
+
+/*
+ * Optional instrumentation of the C implementations: for each
+ * implementation and phase, the number of calls, bytes processed, and
+ * cycles spent, plus USDT probes for perf and bpftrace where
+ * <sys/sdt.h> is available.
+ *
+ * Compile everything with -DDAENCE_STATS to turn it on.  Otherwise the
+ * hooks below are empty inline functions that the compiler discards,
+ * and daence_stats_snapshot reports all zeros.
+ *
+ * The counters are shared by all threads and updated with relaxed
+ * atomic additions, so a snapshot taken while other threads are busy
+ * is not an exact instant, and heavy multithreaded use will contend
+ * for them -- this is for diagnosis, not for production builds that
+ * care about the last few percent.
+ */
+
+#include <stdint.h>
+
+#ifdef DAENCE_STATS
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define	DAENCE_STATS_RDTSC
+#else
+#include <time.h>
+#endif
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define	DAENCE_STATS_USDT
+#endif
+#endif
+#endif
+
+enum daence_impl {
+	DAENCE_IMPL_CHACHA,	/* chachadaence.c */
+	DAENCE_IMPL_SALSA20,	/* salsa20daence.c */
+	DAENCE_IMPL_BEAR,	/* beardaence.c */
+	DAENCE_NIMPL
+};
+
+enum daence_phase {
+	DAENCE_PHASE_SEAL,	/* whole seal, end to end */
+	DAENCE_PHASE_OPEN,	/* whole open, end to end */
+	DAENCE_PHASE_COMPRESS,	/* Poly1305 layers */
+	DAENCE_PHASE_TAG,	/* two HChaCha/HSalsa20 for the tag */
+	DAENCE_PHASE_STREAM,	/* XChaCha/XSalsa20 stream cipher */
+	DAENCE_PHASE_FUSED,	/* stream and compress fused, in open */
+	DAENCE_PHASE_VERIFY,	/* whole verify-only open, end to end */
+	DAENCE_PHASE_AUTH,	/* whole tag-only computation, end to end */
+	DAENCE_NPHASE
+};
+
+struct daence_stats {
+	struct daence_stats_counter {
+		uint64_t	calls;
+		uint64_t	bytes;
+		uint64_t	cycles;
+	}		c[DAENCE_NIMPL][DAENCE_NPHASE];
+};
+
+int daence_stats_enabled(void);
+void daence_stats_snapshot(struct daence_stats *);
+void daence_stats_reset(void);
+const char *daence_stats_impl_name(enum daence_impl);
+const char *daence_stats_phase_name(enum daence_phase);
+
+#ifdef DAENCE_STATS
+extern struct daence_stats daence_stats_global;
+#endif
+
+/*
+ * Hooks for the implementations:
+ *
+ *	uint64_t t0 = daence_stats_begin();
+ *	...phase...
+ *	daence_stats_end(DAENCE_IMPL_..., DAENCE_PHASE_..., nbytes, t0);
+ *
+ * The USDT probe is daence:phase(impl, phase, nbytes, cycles).
+ */
+static inline uint64_t
+daence_stats_begin(void)
+{
+#if defined(DAENCE_STATS_RDTSC)
+	return __rdtsc();
+#elif defined(DAENCE_STATS)
+	struct timespec t;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec*1000000000 + t.tv_nsec;
+#else
+	return 0;
+#endif
+}
+
+static inline void
+daence_stats_end(enum daence_impl impl, enum daence_phase phase,
+    unsigned long long nbytes, uint64_t t0)
+{
+#ifdef DAENCE_STATS
+	struct daence_stats_counter *C = &daence_stats_global.c[impl][phase];
+	uint64_t dt = daence_stats_begin() - t0;
+
+	__atomic_fetch_add(&C->calls, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&C->bytes, nbytes, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&C->cycles, dt, __ATOMIC_RELAXED);
+#ifdef DAENCE_STATS_USDT
+	DTRACE_PROBE4(daence, phase, (int)impl, (int)phase, nbytes, dt);
+#endif
+#else
+	(void)impl;
+	(void)phase;
+	(void)nbytes;
+	(void)t0;
+#endif
+}
+
+#endif	/* DAENCE_STATS_H */
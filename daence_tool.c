@@ -0,0 +1,117 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#define	_POSIX_C_SOURCE	200809L
+
+#include "daence_tool.h"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void *(*volatile explicit_memset)(void *, int, size_t) = memset;
+
+void
+daence_tool_readkey(unsigned char *k, size_t klen, const char *path)
+{
+	unsigned char extra;
+	size_t n = 0;
+	ssize_t nread;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		err(1, "open key %s", path);
+	while (n < klen) {
+		if ((nread = read(fd, k + n, klen - n)) == -1) {
+			if (errno == EINTR)
+				continue;
+			err(1, "read key %s", path);
+		}
+		if (nread == 0)
+			break;
+		n += nread;
+	}
+	if (n != klen || read(fd, &extra, 1) != 0)
+		errx(1, "key %s: must be exactly %zu bytes", path, klen);
+	(void)close(fd);
+}
+
+int
+daence_tool_mktemp(const char *path, char **tmpp)
+{
+	char *tmp;
+	int fd, error;
+
+	*tmpp = NULL;
+	if ((tmp = malloc(strlen(path) + sizeof ".XXXXXX")) == NULL)
+		return -1;
+	strcpy(tmp, path);
+	strcat(tmp, ".XXXXXX");
+	if ((fd = mkstemp(tmp)) == -1) {
+		error = errno;
+		free(tmp);
+		errno = error;
+		return -1;
+	}
+	*tmpp = tmp;
+	return fd;
+}
+
+int
+daence_tool_commit(int fd, const char *tmp, const char *path)
+{
+	int error;
+
+	if (fsync(fd) == -1) {
+		error = errno;
+		(void)close(fd);
+		errno = error;
+		return -1;
+	}
+	if (close(fd) == -1)
+		return -1;
+	return rename(tmp, path);
+}
+
+void
+daence_tool_explicit_memset(void *p, int c, size_t n)
+{
+
+	(void)explicit_memset(p, c, n);
+}
+
+void
+randombytes(unsigned char *p, unsigned long long n)
+{
+
+	(void)p;
+	(void)n;
+	abort();
+}
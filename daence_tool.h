@@ -0,0 +1,64 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef DAENCE_TOOL_H
+#define	DAENCE_TOOL_H
+
+/*
+ * Helpers shared by the command-line tools daence-file and daence-bulk.
+ * Unless noted, errors here are fatal: they print a message and exit
+ * with status 1.
+ */
+
+#include <stddef.h>
+
+/* Read exactly klen bytes of key from path, or die.  */
+void daence_tool_readkey(unsigned char *, size_t /*klen*/,
+    const char */*path*/);
+
+/*
+ * Create and open a temporary file path.XXXXXX next to path, so it can
+ * be renamed over path once complete; set *tmpp to its malloced name
+ * and return its descriptor.  On failure, set *tmpp to NULL and return
+ * -1 with errno set.
+ */
+int daence_tool_mktemp(const char */*path*/, char **/*tmpp*/);
+
+/*
+ * Flush the temporary file fd to disk, close it, and rename tmp over
+ * path.  fd is closed either way.  On failure, return -1 with errno
+ * set, leaving tmp for the caller to unlink.
+ */
+int daence_tool_commit(int /*fd*/, const char */*tmp*/,
+    const char */*path*/);
+
+/* memset that the compiler won't elide, for wiping keys.  */
+void daence_tool_explicit_memset(void *, int, size_t);
+
+/* Needed to link tweetnacl; the tools never call it, so it aborts.  */
+void randombytes(unsigned char *, unsigned long long);
+
+#endif	/* DAENCE_TOOL_H */
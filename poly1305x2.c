@@ -0,0 +1,802 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Poly1305^2 -- two-key Poly1305 with zero addend, one pass
+ *
+ *      Given 16-byte r1, r2 and message m:
+ *
+ *              h1 := Poly1305_{r1,0}(m)
+ *              h2 := Poly1305_{r2,0}(m)
+ *
+ *      Arithmetic is in radix 2^26 with 32x32->64-bit products, as in
+ *      poly1305-donna-32.  Each block is decoded once and fed into both
+ *      accumulators.  On x86 CPUs with AVX2, long runs of blocks go
+ *      through a vector kernel that evaluates both keys at once,
+ *      selected at run time.  Otherwise, where the compiler has 128-bit
+ *      integers, runs of blocks go through radix 2^44 with 64x64->128-bit
+ *      products, as in poly1305-donna-64, which takes a third as many
+ *      multiplications.  Define DAENCE_PORTABLE to build only the
+ *      radix 2^26 code.
+ */
+
+#define	_POSIX_C_SOURCE	200809L
+
+#include "poly1305x2.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    !defined(DAENCE_PORTABLE)
+#define	POLY1305X2_AVX2
+#define	POLY1305X2_AVX2_MINBLOCKS	16	/* below this, not worth it */
+#include <immintrin.h>
+#endif
+
+#if defined(__SIZEOF_INT128__) && !defined(DAENCE_PORTABLE)
+#define	POLY1305X2_INT128
+#define	POLY1305X2_INT128_MINBLOCKS	4	/* below this, not worth it */
+__extension__ typedef unsigned __int128 uint128_t;
+#endif
+
+static void *(*volatile explicit_memset)(void *, int, size_t) = memset;
+
+static inline uint32_t
+le32dec(const void *buf)
+{
+	const unsigned char *p = buf;
+	uint32_t v = 0;
+
+	v |= (uint32_t)p[0] << 0;
+	v |= (uint32_t)p[1] << 8;
+	v |= (uint32_t)p[2] << 16;
+	v |= (uint32_t)p[3] << 24;
+
+	return v;
+}
+
+static inline void
+le32enc(void *buf, uint32_t v)
+{
+	unsigned char *p = buf;
+
+	p[0] = v >> 0;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static inline uint64_t
+le64dec(const void *buf)
+{
+	const unsigned char *p = buf;
+
+	return (uint64_t)le32dec(p) | (uint64_t)le32dec(p + 4) << 32;
+}
+
+static void
+poly1305_decode(uint32_t r[static 5], const unsigned char k[static 16])
+{
+
+	/* Decode and clamp r.  */
+	r[0] = (le32dec(k +  0) >> 0) & 0x3ffffff;
+	r[1] = (le32dec(k +  3) >> 2) & 0x3ffff03;
+	r[2] = (le32dec(k +  6) >> 4) & 0x3ffc0ff;
+	r[3] = (le32dec(k +  9) >> 6) & 0x3f03fff;
+	r[4] = (le32dec(k + 12) >> 8) & 0x00fffff;
+}
+
+/*
+ * d += x*r, unreduced.  The limbs of x may be slightly over 26 bits and
+ * the limbs of r at most a little over 26 bits, so each call adds less
+ * than 2^58 to each limb of d and up to four calls can be summed before
+ * carrying.
+ */
+static inline void
+poly1305_mac(uint64_t d[static 5], const uint32_t x[static 5],
+    const uint32_t r[static 5])
+{
+	const uint32_t s1 = 5*r[1], s2 = 5*r[2], s3 = 5*r[3], s4 = 5*r[4];
+
+	d[0] += (uint64_t)x[0]*r[0] + (uint64_t)x[1]*s4 +
+	    (uint64_t)x[2]*s3 + (uint64_t)x[3]*s2 + (uint64_t)x[4]*s1;
+	d[1] += (uint64_t)x[0]*r[1] + (uint64_t)x[1]*r[0] +
+	    (uint64_t)x[2]*s4 + (uint64_t)x[3]*s3 + (uint64_t)x[4]*s2;
+	d[2] += (uint64_t)x[0]*r[2] + (uint64_t)x[1]*r[1] +
+	    (uint64_t)x[2]*r[0] + (uint64_t)x[3]*s4 + (uint64_t)x[4]*s3;
+	d[3] += (uint64_t)x[0]*r[3] + (uint64_t)x[1]*r[2] +
+	    (uint64_t)x[2]*r[1] + (uint64_t)x[3]*r[0] + (uint64_t)x[4]*s4;
+	d[4] += (uint64_t)x[0]*r[4] + (uint64_t)x[1]*r[3] +
+	    (uint64_t)x[2]*r[2] + (uint64_t)x[3]*r[1] + (uint64_t)x[4]*r[0];
+}
+
+/*
+ * h := d mod 2^130 - 5, partially reduced: every limb is below 2^26
+ * except h[1], which may exceed it slightly.
+ */
+static inline void
+poly1305_carry(uint32_t h[static 5], const uint64_t d[static 5])
+{
+	uint64_t d0 = d[0], d1 = d[1], d2 = d[2], d3 = d[3], d4 = d[4];
+
+	d1 += d0 >> 26; d0 &= 0x3ffffff;
+	d2 += d1 >> 26; d1 &= 0x3ffffff;
+	d3 += d2 >> 26; d2 &= 0x3ffffff;
+	d4 += d3 >> 26; d3 &= 0x3ffffff;
+	d0 += 5*(d4 >> 26); d4 &= 0x3ffffff;
+	d1 += d0 >> 26; d0 &= 0x3ffffff;
+
+	h[0] = d0; h[1] = d1; h[2] = d2; h[3] = d3; h[4] = d4;
+}
+
+/*
+ * Convert between radix 2^26 (five limbs) and radix 2^44 (limbs of 44,
+ * 44, and 42 bits), for partially reduced inputs.  The top radix-2^44
+ * limb may come out a bit over 42 bits, and h[1] over 26 bits.
+ */
+static inline void
+poly1305_to44(uint64_t g[static 3], const uint32_t h[static 5])
+{
+	uint64_t t;
+
+	t = (uint64_t)h[0] + ((uint64_t)h[1] << 26);
+	g[0] = t & 0xfffffffffff; t >>= 44;
+	t += ((uint64_t)h[2] << 8) + ((uint64_t)h[3] << 34);
+	g[1] = t & 0xfffffffffff; t >>= 44;
+	t += (uint64_t)h[4] << 16;
+	g[2] = t;
+}
+
+static inline void
+poly1305_from44(uint32_t h[static 5], const uint64_t g[static 3])
+{
+	uint64_t t;
+
+	t = g[0];
+	h[0] = t & 0x3ffffff; t >>= 26;
+	t += g[1] << 18;
+	h[1] = t & 0x3ffffff; t >>= 26;
+	h[2] = t & 0x3ffffff; t >>= 26;
+	t += g[2] << 10;
+	h[3] = t & 0x3ffffff; t >>= 26;
+	h[4] = t & 0x3ffffff; t >>= 26;
+	t = h[0] + 5*t;
+	h[0] = t & 0x3ffffff;
+	h[1] += t >> 26;
+}
+
+static inline void
+poly1305_load(uint32_t x[static 5], const unsigned char m[static 16],
+    uint32_t hibit)
+{
+
+	x[0] = (le32dec(m +  0) >> 0) & 0x3ffffff;
+	x[1] = (le32dec(m +  3) >> 2) & 0x3ffffff;
+	x[2] = (le32dec(m +  6) >> 4) & 0x3ffffff;
+	x[3] = (le32dec(m +  9) >> 6) & 0x3ffffff;
+	x[4] = (le32dec(m + 12) >> 8) | hibit;
+}
+
+static void
+poly1305x2_blocks_portable(struct poly1305x2 *P, const unsigned char *m,
+    unsigned long long n, uint32_t hibit)
+{
+	const struct poly1305x2_key *K = P->key;
+	uint32_t x[4][5], y[5];
+	uint64_t d[2][5];
+	unsigned i, j, l;
+
+	/*
+	 * Four blocks at a time:
+	 *
+	 *	h := (h + m_0) r^4 + m_1 r^3 + m_2 r^2 + m_3 r,
+	 *
+	 * for each of the two keys, with all eight products
+	 * independent of one another and a single carry at the end.
+	 */
+	for (; n >= 4; n -= 4, m += 64) {
+		for (j = 0; j < 4; j++)
+			poly1305_load(x[j], m + 16*j, hibit);
+		for (i = 0; i < 2; i++) {
+			for (l = 0; l < 5; l++) {
+				y[l] = P->h[i][l] + x[0][l];
+				d[i][l] = 0;
+			}
+			poly1305_mac(d[i], y, K->r[i][3]);
+			poly1305_mac(d[i], x[1], K->r[i][2]);
+			poly1305_mac(d[i], x[2], K->r[i][1]);
+			poly1305_mac(d[i], x[3], K->r[i][0]);
+			poly1305_carry(P->h[i], d[i]);
+		}
+	}
+
+	/* Remaining blocks one at a time: h := (h + m) r.  */
+	for (; n --> 0; m += 16) {
+		poly1305_load(x[0], m, hibit);
+		for (i = 0; i < 2; i++) {
+			for (l = 0; l < 5; l++) {
+				y[l] = P->h[i][l] + x[0][l];
+				d[i][l] = 0;
+			}
+			poly1305_mac(d[i], y, K->r[i][0]);
+			poly1305_carry(P->h[i], d[i]);
+		}
+	}
+
+	explicit_memset(x, 0, sizeof x);
+	explicit_memset(y, 0, sizeof y);
+	explicit_memset(d, 0, sizeof d);
+}
+
+#ifdef POLY1305X2_INT128
+
+/* d += x*r in radix 2^44, unreduced; up to four calls may be summed.  */
+static inline void
+poly1305_mac44(uint128_t d[static 3], const uint64_t x[static 3],
+    const uint64_t r[static 3])
+{
+	const uint64_t s1 = 20*r[1], s2 = 20*r[2];
+
+	d[0] += (uint128_t)x[0]*r[0] + (uint128_t)x[1]*s2 +
+	    (uint128_t)x[2]*s1;
+	d[1] += (uint128_t)x[0]*r[1] + (uint128_t)x[1]*r[0] +
+	    (uint128_t)x[2]*s2;
+	d[2] += (uint128_t)x[0]*r[2] + (uint128_t)x[1]*r[1] +
+	    (uint128_t)x[2]*r[0];
+}
+
+static inline void
+poly1305_carry44(uint64_t h[static 3], const uint128_t d[static 3])
+{
+	uint128_t d0 = d[0], d1 = d[1], d2 = d[2];
+	uint64_t c;
+
+	d1 += (uint64_t)(d0 >> 44); d0 &= 0xfffffffffff;
+	d2 += (uint64_t)(d1 >> 44); d1 &= 0xfffffffffff;
+	c = d2 >> 42; d2 &= 0x3ffffffffff;
+	d0 += 5*(uint128_t)c;
+	d1 += (uint64_t)(d0 >> 44); d0 &= 0xfffffffffff;
+
+	h[0] = d0; h[1] = d1; h[2] = d2;
+}
+
+static inline void
+poly1305_load44(uint64_t x[static 3], const unsigned char m[static 16],
+    uint64_t hibit)
+{
+	uint64_t t0 = le64dec(m), t1 = le64dec(m + 8);
+
+	x[0] = t0 & 0xfffffffffff;
+	x[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffffffff;
+	x[2] = (t1 >> 24) | hibit;
+}
+
+/*
+ * Same as poly1305x2_blocks_portable, in radix 2^44.  The accumulators
+ * are converted on the way in and out, so this pays off only for more
+ * than a few blocks at a time.
+ */
+static void
+poly1305x2_blocks_int128(struct poly1305x2 *P, const unsigned char *m,
+    unsigned long long n, uint32_t hibit)
+{
+	const struct poly1305x2_key *K = P->key;
+	const uint64_t hibit44 = (uint64_t)hibit << 16;	/* 2^128 */
+	uint64_t h[2][3], x[4][3], y[3];
+	uint128_t d[3];
+	unsigned i, j, l;
+
+	for (i = 0; i < 2; i++)
+		poly1305_to44(h[i], P->h[i]);
+
+	/* h := (h + m_0) r^4 + m_1 r^3 + m_2 r^2 + m_3 r */
+	for (; n >= 4; n -= 4, m += 64) {
+		for (j = 0; j < 4; j++)
+			poly1305_load44(x[j], m + 16*j, hibit44);
+		for (i = 0; i < 2; i++) {
+			for (l = 0; l < 3; l++) {
+				y[l] = h[i][l] + x[0][l];
+				d[l] = 0;
+			}
+			poly1305_mac44(d, y, K->r44[i][3]);
+			poly1305_mac44(d, x[1], K->r44[i][2]);
+			poly1305_mac44(d, x[2], K->r44[i][1]);
+			poly1305_mac44(d, x[3], K->r44[i][0]);
+			poly1305_carry44(h[i], d);
+		}
+	}
+
+	/* h := (h + m) r */
+	for (; n --> 0; m += 16) {
+		poly1305_load44(x[0], m, hibit44);
+		for (i = 0; i < 2; i++) {
+			for (l = 0; l < 3; l++) {
+				y[l] = h[i][l] + x[0][l];
+				d[l] = 0;
+			}
+			poly1305_mac44(d, y, K->r44[i][0]);
+			poly1305_carry44(h[i], d);
+		}
+	}
+
+	for (i = 0; i < 2; i++)
+		poly1305_from44(P->h[i], h[i]);
+
+	explicit_memset(h, 0, sizeof h);
+	explicit_memset(x, 0, sizeof x);
+	explicit_memset(y, 0, sizeof y);
+	explicit_memset(d, 0, sizeof d);
+}
+
+#endif	/* POLY1305X2_INT128 */
+
+#ifdef POLY1305X2_AVX2
+
+/*
+ * AVX2: both keys in one register.  Each 256-bit vector holds one limb
+ * in four 64-bit lanes,
+ *
+ *	[ key 1 even, key 1 odd, key 2 even, key 2 odd ],
+ *
+ * so a single vpmuludq advances both polynomials, each with two blocks
+ * in flight.  Each 16-byte block is decoded once and broadcast to both
+ * keys' lanes.  Four blocks are absorbed per iteration:
+ *
+ *	H := H r^4 + (m_0, m_1) r^2 + (m_2, m_3),
+ *
+ * and at the end the even lane is multiplied by r^2 and the odd lane by
+ * r, and the two are summed, giving each key's Horner evaluation.
+ */
+
+#define	AVX2	__attribute__((__target__("avx2")))
+
+static AVX2 inline __m256i
+avx2_pair(uint32_t a, uint32_t b)
+{
+
+	return _mm256_set_epi64x(b, b, a, a);
+}
+
+static AVX2 inline void
+avx2_load(__m256i x[static 5], const unsigned char m[static 32],
+    uint32_t hibit)
+{
+	const __m128i mask = _mm_set1_epi64x(0x3ffffff);
+	__m128i b0 = _mm_loadu_si128((const void *)(m + 0));
+	__m128i b1 = _mm_loadu_si128((const void *)(m + 16));
+	__m128i lo = _mm_unpacklo_epi64(b0, b1);
+	__m128i hi = _mm_unpackhi_epi64(b0, b1);
+
+	x[0] = _mm256_broadcastsi128_si256(_mm_and_si128(lo, mask));
+	x[1] = _mm256_broadcastsi128_si256(
+	    _mm_and_si128(_mm_srli_epi64(lo, 26), mask));
+	x[2] = _mm256_broadcastsi128_si256(_mm_and_si128(
+		_mm_or_si128(_mm_srli_epi64(lo, 52), _mm_slli_epi64(hi, 12)),
+		mask));
+	x[3] = _mm256_broadcastsi128_si256(
+	    _mm_and_si128(_mm_srli_epi64(hi, 14), mask));
+	x[4] = _mm256_broadcastsi128_si256(
+	    _mm_or_si128(_mm_srli_epi64(hi, 40), _mm_set1_epi64x(hibit)));
+}
+
+/* d += x*r, where s = 5r */
+static AVX2 inline void
+avx2_mac(__m256i d[static 5], const __m256i x[static 5],
+    const __m256i r[static 5], const __m256i s[static 5])
+{
+#define	M(a, b)	_mm256_mul_epu32(a, b)
+#define	A(a, b)	_mm256_add_epi64(a, b)
+	d[0] = A(d[0], A(A(A(A(M(x[0], r[0]), M(x[1], s[4])),
+			M(x[2], s[3])), M(x[3], s[2])), M(x[4], s[1])));
+	d[1] = A(d[1], A(A(A(A(M(x[0], r[1]), M(x[1], r[0])),
+			M(x[2], s[4])), M(x[3], s[3])), M(x[4], s[2])));
+	d[2] = A(d[2], A(A(A(A(M(x[0], r[2]), M(x[1], r[1])),
+			M(x[2], r[0])), M(x[3], s[4])), M(x[4], s[3])));
+	d[3] = A(d[3], A(A(A(A(M(x[0], r[3]), M(x[1], r[2])),
+			M(x[2], r[1])), M(x[3], r[0])), M(x[4], s[4])));
+	d[4] = A(d[4], A(A(A(A(M(x[0], r[4]), M(x[1], r[3])),
+			M(x[2], r[2])), M(x[3], r[1])), M(x[4], r[0])));
+#undef	A
+#undef	M
+}
+
+static AVX2 inline void
+avx2_carry(__m256i h[static 5], const __m256i d[static 5])
+{
+	const __m256i mask = _mm256_set1_epi64x(0x3ffffff);
+	__m256i d0 = d[0], d1 = d[1], d2 = d[2], d3 = d[3], d4 = d[4], c;
+
+	d1 = _mm256_add_epi64(d1, _mm256_srli_epi64(d0, 26));
+	d0 = _mm256_and_si256(d0, mask);
+	d2 = _mm256_add_epi64(d2, _mm256_srli_epi64(d1, 26));
+	d1 = _mm256_and_si256(d1, mask);
+	d3 = _mm256_add_epi64(d3, _mm256_srli_epi64(d2, 26));
+	d2 = _mm256_and_si256(d2, mask);
+	d4 = _mm256_add_epi64(d4, _mm256_srli_epi64(d3, 26));
+	d3 = _mm256_and_si256(d3, mask);
+	c = _mm256_srli_epi64(d4, 26);
+	d4 = _mm256_and_si256(d4, mask);
+	d0 = _mm256_add_epi64(d0, _mm256_add_epi64(c, _mm256_slli_epi64(c, 2)));
+	d1 = _mm256_add_epi64(d1, _mm256_srli_epi64(d0, 26));
+	d0 = _mm256_and_si256(d0, mask);
+
+	h[0] = d0; h[1] = d1; h[2] = d2; h[3] = d3; h[4] = d4;
+}
+
+/* Absorb n blocks, n a positive multiple of 4.  */
+static AVX2 void
+poly1305x2_blocks_avx2(struct poly1305x2 *P, const unsigned char *m,
+    unsigned long long n, uint32_t hibit)
+{
+	const struct poly1305x2_key *K = P->key;
+	__m256i r2[5], s2[5], r4[5], s4[5], rf[5], sf[5];
+	__m256i h[5], x[5], d[5];
+	uint64_t v[4];
+	uint64_t e[2][5];
+	unsigned l;
+
+	for (l = 0; l < 5; l++) {
+		r2[l] = avx2_pair(K->r[0][1][l], K->r[1][1][l]);
+		r4[l] = avx2_pair(K->r[0][3][l], K->r[1][3][l]);
+		rf[l] = _mm256_set_epi64x(K->r[1][0][l], K->r[1][1][l],
+		    K->r[0][0][l], K->r[0][1][l]);
+		s2[l] = _mm256_add_epi64(r2[l], _mm256_slli_epi64(r2[l], 2));
+		s4[l] = _mm256_add_epi64(r4[l], _mm256_slli_epi64(r4[l], 2));
+		sf[l] = _mm256_add_epi64(rf[l], _mm256_slli_epi64(rf[l], 2));
+	}
+
+	/*
+	 * First four blocks: the incoming accumulators join m_0 in the
+	 * even lanes, H := ((h, 0) + (m_0, m_1)) r^2 + (m_2, m_3).
+	 */
+	avx2_load(x, m, hibit);
+	avx2_load(d, m + 32, hibit);
+	for (l = 0; l < 5; l++) {
+		x[l] = _mm256_add_epi64(x[l],
+		    _mm256_set_epi64x(0, P->h[1][l], 0, P->h[0][l]));
+	}
+	avx2_mac(d, x, r2, s2);
+	avx2_carry(h, d);
+
+	for (m += 64, n -= 4; n >= 4; m += 64, n -= 4) {
+		avx2_load(x, m, hibit);
+		avx2_load(d, m + 32, hibit);
+		avx2_mac(d, h, r4, s4);
+		avx2_mac(d, x, r2, s2);
+		avx2_carry(h, d);
+	}
+
+	/* H := H (r^2, r); h_i := even_i + odd_i */
+	for (l = 0; l < 5; l++)
+		d[l] = _mm256_setzero_si256();
+	avx2_mac(d, h, rf, sf);
+	avx2_carry(h, d);
+	for (l = 0; l < 5; l++) {
+		_mm256_storeu_si256((void *)v, h[l]);
+		e[0][l] = v[0] + v[1];
+		e[1][l] = v[2] + v[3];
+	}
+	poly1305_carry(P->h[0], e[0]);
+	poly1305_carry(P->h[1], e[1]);
+
+	explicit_memset(h, 0, sizeof h);
+	explicit_memset(x, 0, sizeof x);
+	explicit_memset(d, 0, sizeof d);
+	explicit_memset(v, 0, sizeof v);
+	explicit_memset(e, 0, sizeof e);
+}
+
+#undef	AVX2
+
+#endif	/* POLY1305X2_AVX2 */
+
+static int poly1305x2_portable_only;	/* see poly1305x2_force_portable */
+
+static void
+poly1305x2_blocks(struct poly1305x2 *P, const unsigned char *m,
+    unsigned long long n, uint32_t hibit)
+{
+#ifdef POLY1305X2_AVX2
+	unsigned long long n4;
+
+	if (n >= POLY1305X2_AVX2_MINBLOCKS && poly1305x2_portable_only < 1 &&
+	    __builtin_cpu_supports("avx2")) {
+		n4 = n & ~3ull;
+		poly1305x2_blocks_avx2(P, m, n4, hibit);
+		m += 16*n4;
+		n -= n4;
+	}
+#endif
+#ifdef POLY1305X2_INT128
+	if (n >= POLY1305X2_INT128_MINBLOCKS && poly1305x2_portable_only < 2) {
+		poly1305x2_blocks_int128(P, m, n, hibit);
+		return;
+	}
+#endif
+	poly1305x2_blocks_portable(P, m, n, hibit);
+}
+
+const char *
+poly1305x2_impl(void)
+{
+
+#ifdef POLY1305X2_AVX2
+	if (poly1305x2_portable_only < 1 && __builtin_cpu_supports("avx2"))
+		return "avx2";
+#endif
+#ifdef POLY1305X2_INT128
+	if (poly1305x2_portable_only < 2)
+		return "int128";
+#endif
+	return "portable";
+}
+
+void
+poly1305x2_force_portable(int portable_only)
+{
+
+	poly1305x2_portable_only = portable_only;
+}
+
+static void
+poly1305_done(uint32_t h[static 5], unsigned char out[static 16])
+{
+	uint32_t h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+	uint32_t g0, g1, g2, g3, g4, c, mask;
+
+	/* Fully carry h.  */
+	c = h1 >> 26; h1 &= 0x3ffffff; h2 += c;
+	c = h2 >> 26; h2 &= 0x3ffffff; h3 += c;
+	c = h3 >> 26; h3 &= 0x3ffffff; h4 += c;
+	c = h4 >> 26; h4 &= 0x3ffffff; h0 += 5*c;
+	c = h0 >> 26; h0 &= 0x3ffffff; h1 += c;
+
+	/* g := h + -p = h - (2^130 - 5) */
+	g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+	g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+	g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+	g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+	g4 = h4 + c - (1u << 26);
+
+	/* h := (h >= p ? g : h), in constant time */
+	mask = (g4 >> 31) - 1;
+	h0 = (h0 & ~mask) | (g0 & mask);
+	h1 = (h1 & ~mask) | (g1 & mask);
+	h2 = (h2 & ~mask) | (g2 & mask);
+	h3 = (h3 & ~mask) | (g3 & mask);
+	h4 = (h4 & ~mask) | (g4 & mask);
+
+	/* h mod 2^128, zero addend */
+	le32enc(out +  0, h0 | (h1 << 26));
+	le32enc(out +  4, (h1 >> 6) | (h2 << 20));
+	le32enc(out +  8, (h2 >> 12) | (h3 << 14));
+	le32enc(out + 12, (h3 >> 18) | (h4 << 8));
+}
+
+void
+poly1305x2_setkey(struct poly1305x2_key *K,
+    const unsigned char k1[static 16], const unsigned char k2[static 16])
+{
+	uint64_t d[5];
+	unsigned i, j, l;
+
+	poly1305_decode(K->r[0][0], k1);
+	poly1305_decode(K->r[1][0], k2);
+
+	/* r^(j+1) := r^j * r */
+	for (i = 0; i < 2; i++) {
+		for (j = 1; j < POLY1305X2_NPOWERS; j++) {
+			for (l = 0; l < 5; l++)
+				d[l] = 0;
+			poly1305_mac(d, K->r[i][j - 1], K->r[i][0]);
+			poly1305_carry(K->r[i][j], d);
+		}
+		for (j = 0; j < POLY1305X2_NPOWERS; j++)
+			poly1305_to44(K->r44[i][j], K->r[i][j]);
+	}
+
+	explicit_memset(d, 0, sizeof d);
+}
+
+void
+poly1305x2_clearkey(struct poly1305x2_key *K)
+{
+
+	explicit_memset(K, 0, sizeof *K);
+}
+
+void
+poly1305x2_init(struct poly1305x2 *P, const struct poly1305x2_key *K)
+{
+
+	memset(P, 0, sizeof *P);
+	P->key = K;
+}
+
+void
+poly1305x2_update(struct poly1305x2 *P,
+    const unsigned char *m, unsigned long long mlen)
+{
+	unsigned long long n;
+
+	/* Fill and absorb the pending partial block, if any.  */
+	if (P->nbuf) {
+		n = 16 - P->nbuf;
+		if (n > mlen)
+			n = mlen;
+		memcpy(P->buf + P->nbuf, m, n);
+		P->nbuf += n;
+		m += n;
+		mlen -= n;
+		if (P->nbuf < 16)
+			return;
+		poly1305x2_blocks(P, P->buf, 1, 1u << 24);
+		P->nbuf = 0;
+	}
+
+	/* Absorb as many whole blocks as we can straight from m.  */
+	if (mlen >= 16) {
+		n = mlen/16;
+		poly1305x2_blocks(P, m, n, 1u << 24);
+		m += 16*n;
+		mlen -= 16*n;
+	}
+
+	/* Buffer the remainder.  */
+	memcpy(P->buf, m, mlen);
+	P->nbuf = mlen;
+}
+
+/* y := r^n */
+static void
+poly1305_pow(uint32_t y[static 5], const uint32_t r[static 5],
+    unsigned long long n)
+{
+	uint32_t x[5];
+	uint64_t d[5];
+	unsigned l;
+
+	memcpy(x, r, sizeof x);
+	y[0] = 1; y[1] = y[2] = y[3] = y[4] = 0;
+	for (; n; n >>= 1) {
+		if (n & 1) {
+			for (l = 0; l < 5; l++)
+				d[l] = 0;
+			poly1305_mac(d, y, x);
+			poly1305_carry(y, d);
+		}
+		for (l = 0; l < 5; l++)
+			d[l] = 0;
+		poly1305_mac(d, x, x);
+		poly1305_carry(x, d);
+	}
+
+	explicit_memset(x, 0, sizeof x);
+	explicit_memset(d, 0, sizeof d);
+}
+
+void
+poly1305x2_combine(struct poly1305x2 *P, const struct poly1305x2 *Q,
+    unsigned long long n)
+{
+	uint32_t rn[5];
+	uint64_t d[5];
+	unsigned i, l;
+
+	/* h_i := h_i r_i^n + q_i */
+	for (i = 0; i < 2; i++) {
+		poly1305_pow(rn, P->key->r[i][0], n);
+		for (l = 0; l < 5; l++)
+			d[l] = Q->h[i][l];
+		poly1305_mac(d, P->h[i], rn);
+		poly1305_carry(P->h[i], d);
+	}
+
+	explicit_memset(rn, 0, sizeof rn);
+	explicit_memset(d, 0, sizeof d);
+}
+
+/*
+ * Serialized state: the ten accumulator limbs as little-endian 32-bit
+ * words, the partial block padded with zeros to 16 bytes, its length,
+ * and zeros to pad to 64 bytes.  Only the nbuf bytes of the partial
+ * block are input; the rest of buf may hold stale input, which must not
+ * leak into the blob or make equal states serialize differently.
+ */
+void
+poly1305x2_export(const struct poly1305x2 *P,
+    unsigned char buf[static POLY1305X2_STATEBYTES])
+{
+	unsigned i, l;
+
+	for (i = 0; i < 2; i++) {
+		for (l = 0; l < 5; l++)
+			le32enc(buf + 4*(5*i + l), P->h[i][l]);
+	}
+	memcpy(buf + 40, P->buf, P->nbuf);
+	memset(buf + 40 + P->nbuf, 0, 16 - P->nbuf);
+	buf[56] = P->nbuf;
+	memset(buf + 57, 0, POLY1305X2_STATEBYTES - 57);
+}
+
+int
+poly1305x2_import(struct poly1305x2 *P, const struct poly1305x2_key *K,
+    const unsigned char buf[static POLY1305X2_STATEBYTES])
+{
+	uint64_t d[5];
+	unsigned char z = 0;
+	unsigned i, l;
+
+	if (buf[56] >= 16)
+		return -1;
+	for (i = 40 + buf[56]; i < 56; i++)
+		z |= buf[i];
+	for (i = 57; i < POLY1305X2_STATEBYTES; i++)
+		z |= buf[i];
+	if (z)
+		return -1;
+
+	/*
+	 * Carry each accumulator so that whatever was in the limbs,
+	 * they are within the bounds the block functions assume.
+	 */
+	poly1305x2_init(P, K);
+	for (i = 0; i < 2; i++) {
+		for (l = 0; l < 5; l++)
+			d[l] = le32dec(buf + 4*(5*i + l));
+		poly1305_carry(P->h[i], d);
+	}
+	memcpy(P->buf, buf + 40, 16);
+	P->nbuf = buf[56];
+
+	explicit_memset(d, 0, sizeof d);
+	return 0;
+}
+
+void
+poly1305x2_final(struct poly1305x2 *P,
+    unsigned char h1[static 16], unsigned char h2[static 16])
+{
+
+	/* Pad the last partial block with 1 and then zeros.  */
+	if (P->nbuf) {
+		P->buf[P->nbuf] = 1;
+		memset(P->buf + P->nbuf + 1, 0, 16 - P->nbuf - 1);
+		poly1305x2_blocks(P, P->buf, 1, 0);
+	}
+
+	poly1305_done(P->h[0], h1);
+	poly1305_done(P->h[1], h2);
+
+	explicit_memset(P, 0, sizeof *P);
+}
+
+void
+poly1305x2_clear(struct poly1305x2 *P)
+{
+
+	explicit_memset(P, 0, sizeof *P);
+}
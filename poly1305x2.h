@@ -0,0 +1,105 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef POLY1305X2_H
+#define	POLY1305X2_H
+
+#include <stdint.h>
+
+/*
+ * Poly1305^2 with zero addend: two Poly1305 evaluations of the same
+ * message under independent evaluation points, in a single pass over
+ * the input.  Every 16-byte block is loaded once and absorbed into
+ * both accumulators, so the two multiply chains can overlap.
+ */
+
+#define	POLY1305X2_NPOWERS	4
+
+/*
+ * Expanded key: clamped r1 and r2 and their powers r^2, r^3, r^4, so
+ * that four blocks at a time can be absorbed with independent
+ * multiplications, in both radix 2^26 and radix 2^44.  Computed once by
+ * poly1305x2_setkey and reusable for any number of messages.
+ */
+struct poly1305x2_key {
+	uint32_t	r[2][POLY1305X2_NPOWERS][5]; /* r[i][j] = r_i^(j+1) */
+	uint64_t	r44[2][POLY1305X2_NPOWERS][3]; /* same, radix 2^44 */
+};
+
+struct poly1305x2 {
+	const struct poly1305x2_key *key;
+	uint32_t	h[2][5];	/* accumulators, radix 2^26 */
+	unsigned char	buf[16];	/* partial block */
+	unsigned	nbuf;		/* bytes in buf */
+};
+
+void poly1305x2_setkey(struct poly1305x2_key *,
+    const unsigned char[static 16], const unsigned char[static 16]);
+void poly1305x2_clearkey(struct poly1305x2_key *);
+
+void poly1305x2_init(struct poly1305x2 *, const struct poly1305x2_key *);
+void poly1305x2_update(struct poly1305x2 *,
+    const unsigned char */*m*/, unsigned long long /*mlen*/);
+void poly1305x2_final(struct poly1305x2 *,
+    unsigned char[static 16], unsigned char[static 16]);
+
+/* Wipe a computation that will not be finished.  */
+void poly1305x2_clear(struct poly1305x2 *);
+
+/*
+ * Join two pieces of one message hashed separately, e.g. on different
+ * threads: P := P r^n + Q, where Q has absorbed exactly n whole 16-byte
+ * blocks since poly1305x2_init with the same key, and neither P nor Q
+ * has a partial block pending.  Q is left alone; finalize or clear it
+ * as usual.
+ */
+void poly1305x2_combine(struct poly1305x2 *, const struct poly1305x2 *,
+    unsigned long long);
+
+/*
+ * Save and restore the state of a computation in progress, e.g. after
+ * absorbing a common prefix, in a fixed machine-independent format.
+ * The key is not included; import with the same key as was used to
+ * export.  Together with the input absorbed so far, the state can
+ * reveal the key, so protect it like the key.  poly1305x2_import
+ * returns 0 on success or -1 if buf is malformed.
+ */
+#define	POLY1305X2_STATEBYTES	64
+
+void poly1305x2_export(const struct poly1305x2 *,
+    unsigned char[static POLY1305X2_STATEBYTES]);
+int poly1305x2_import(struct poly1305x2 *, const struct poly1305x2_key *,
+    const unsigned char[static POLY1305X2_STATEBYTES]);
+
+/*
+ * Name of the block function in use ("avx2", "int128", or "portable"),
+ * and a knob for testing: 0 picks the best available, 1 avoids vector
+ * units, and 2 uses only 32x32->64-bit multiplies.  Not thread-safe.
+ */
+const char *poly1305x2_impl(void);
+void poly1305x2_force_portable(int);
+
+#endif	/* POLY1305X2_H */
@@ -45,110 +45,931 @@
 
 #include "salsa20daence.h"
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "crypto_core_hsalsa20.h"
-#include "crypto_onetimeauth_poly1305.h"
-#include "crypto_stream_xsalsa20.h"
 #include "crypto_verify_32.h"
+#include "daence_chunk.h"
+#include "daence_stats.h"
+#include "poly1305x2.h"
+#include "xsalsa20.h"
+
+#define	TILE	4096		/* bytes per fused decrypt/MAC tile */
 
 static void *(*volatile explicit_memset)(void *, int, size_t) = memset;
 
 static const unsigned char sigma[16] = "expand 32-byte k";
 
+/* ha := Poly1305^2_{k1,k2}(a) */
 static void
-compressauth(unsigned char t[static 24],
-    const unsigned char *m, unsigned long long mlen,
+compresshdr(unsigned char ha[static 32],
     const unsigned char *a, unsigned long long alen,
-    const unsigned char k[static 96])
+    const struct crypto_dae_salsa20daence_ctx *ctx)
 {
-	const unsigned char *k0 = k;	/* k0 := k[0..32] */
-	unsigned char k1[32], k2[32], k3[32], k4[32], ham[64];
-	unsigned char *ha1 = ham +  0, *ha2 = ham + 16;
-	unsigned char *hm1 = ham + 32, *hm2 = ham + 48;
-	unsigned char h[32], *h3 = h, *h4 = h + 16;
+	struct poly1305x2 poly1305;
+	uint64_t t0 = daence_stats_begin();
+
+	poly1305x2_init(&poly1305, &ctx->k12);
+	poly1305x2_update(&poly1305, a, alen);
+	poly1305x2_final(&poly1305, ha, ha + 16);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_COMPRESS, alen, t0);
+}
+
+/*
+ * Second layer, given ha = Poly1305^2_{k1,k2}(a) and poly1305 which has
+ * absorbed all of m under k1, k2:
+ *	hm := Poly1305^2_{k1,k2}(m)
+ *	h := Poly1305^2_{k3,k4}(ha || hm)
+ */
+static void
+compress2(unsigned char h[static 32], struct poly1305x2 *poly1305,
+    const unsigned char ha[static 32],
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	unsigned char ham[64];
+
+	memcpy(ham, ha, 32);
+	poly1305x2_final(poly1305, ham + 32, ham + 48);
+	poly1305x2_init(poly1305, &ctx->k34);
+	poly1305x2_update(poly1305, ham, 64);
+	poly1305x2_final(poly1305, h, h + 16);
+
+	explicit_memset(ham, 0, sizeof ham); /* paranoia */
+}
+
+/* Tag generation: t, _ := HXSalsa20_k0(h3 || h4) */
+static void
+hxsalsa20(unsigned char t[static 24], const unsigned char h[static 32],
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	const unsigned char *h3 = h, *h4 = h + 16;
 	unsigned char u[32];
+	uint64_t t0 = daence_stats_begin();
+
+	crypto_core_hsalsa20(u, h3, ctx->k0, sigma);
+	crypto_core_hsalsa20(u, h4, u, sigma);
+	memcpy(t, u, 24);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_TAG, 0, t0);
 
-	/* Poly1305: Set evaluation point; zero addend.  */
-	memcpy(k1, k + 32, 16); memset(k1 + 16, 0, 16);
-	memcpy(k2, k + 48, 16); memset(k2 + 16, 0, 16);
-	memcpy(k3, k + 64, 16); memset(k3 + 16, 0, 16);
-	memcpy(k4, k + 80, 16); memset(k4 + 16, 0, 16);
+	explicit_memset(u, 0, sizeof u); /* paranoia */
+}
+
+static void
+compressauth(unsigned char t[static 24],
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char ha[static 32],
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	struct poly1305x2 poly1305;
+	unsigned char h[32];
+	uint64_t t0;
 
 	/*
-	 * Message compression:
-	 *	ha := Poly1305^2_{k1,k2}(a)
+	 * Message compression, given ha = Poly1305^2_{k1,k2}(a):
 	 *	hm := Poly1305^2_{k1,k2}(m)
 	 *	h := Poly1305^2_{k3,k4}(ha || hm)
+	 *
+	 * m is read only once, feeding both keys' accumulators
+	 * together.
 	 */
-	crypto_onetimeauth_poly1305(ha1, a, alen, k1);
-	crypto_onetimeauth_poly1305(ha2, a, alen, k2);
-	crypto_onetimeauth_poly1305(hm1, m, mlen, k1);
-	crypto_onetimeauth_poly1305(hm2, m, mlen, k2);
-	crypto_onetimeauth_poly1305(h3, ham, 64, k3);
-	crypto_onetimeauth_poly1305(h4, ham, 64, k4);
-
-	/* Tag generation: t, _ := HXSalsa20_k0(h3 || h4) */
-	crypto_core_hsalsa20(u, h3, k0, sigma);
-	crypto_core_hsalsa20(u, h4, u, sigma);
-	memcpy(t, u, 24);
+	t0 = daence_stats_begin();
+	poly1305x2_init(&poly1305, &ctx->k12);
+	poly1305x2_update(&poly1305, m, mlen);
+	compress2(h, &poly1305, ha, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_COMPRESS, mlen, t0);
+
+	hxsalsa20(t, h, ctx);
+
+	explicit_memset(h, 0, sizeof h); /* paranoia */
+}
+
+/*
+ * Seal with the tag and ciphertext in separate places: t[0..24] and
+ * x[0..mlen].  x may equal m.
+ */
+static void
+encrypt_detached_ha(unsigned char *x, unsigned char t[static 24],
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char ha[static 32],
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	uint64_t t0;
+
+	/* t := HXSalsa20_k0(Poly1305^2(a,m)) */
+	compressauth(t, m, mlen, ha, ctx);
+
+	/* Stream cipher: x[0..mlen] := m[0..mlen] ^ XSalsa20_k0(t) */
+	t0 = daence_stats_begin();
+	xsalsa20_xor(x, m, mlen, t, ctx->k0);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_STREAM, mlen, t0);
+}
+
+static void
+encrypt_ha(unsigned char *c, const unsigned char *m, unsigned long long mlen,
+    const unsigned char ha[static 32],
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+
+	/* c[0..24] := t, c[24..24+mlen] := m ^ XSalsa20_k0(t) */
+	encrypt_detached_ha(c + 24, c, m, mlen, ha, ctx);
+}
+
+/*
+ * Open with the purported tag t'[0..24] and the ciphertext x[0..mlen]
+ * in separate places.  m may equal x.
+ */
+static int
+open_detached_ha(unsigned char *m, const unsigned char *x,
+    unsigned long long mlen, const unsigned char tag[static 24],
+    const unsigned char ha[static 32],
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	unsigned char t[32], t_[32];
+	uint64_t t0;
+	int ret;
+
+	/* Stream cipher: m[0..mlen] := x[0..mlen] ^ XSalsa20_k0(t') */
+	t0 = daence_stats_begin();
+	memcpy(t_, tag, 24);
+	xsalsa20_xor(m, x, mlen, t_, ctx->k0);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_STREAM, mlen, t0);
+
+	/* t := HXSalsa20_k0(Poly1305^2(a,m)) */
+	compressauth(t, m, mlen, ha, ctx);
+
+	/* Verify tag: t' ?= t (no crypto_verify_24) */
+	memset(t + 24, 0, 8);
+	memset(t_ + 24, 0, 8);
+	ret = crypto_verify_32(t_, t);
+	if (ret)
+		explicit_memset(m, 0, mlen); /* paranoia */
+
+	/* Paranoia: clear temporaries.  */
+	explicit_memset(t, 0, sizeof t);
+	explicit_memset(t_, 0, sizeof t_);
+
+	return ret;
+}
+
+/*
+ * Verify only, with the plaintext going through a tile-sized buffer on
+ * the stack: decrypt a tile, absorb it into the Poly1305^2 state, and
+ * discard it.  Same result as open_ha, but nothing is written out.
+ */
+static int
+verify_ha(const unsigned char *c, unsigned long long mlen,
+    const unsigned char ha[static 32],
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	struct xsalsa20 S;
+	struct poly1305x2 poly1305;
+	unsigned char tile[TILE], h[32], t[32], t_[32];
+	unsigned long long i, n;
+	uint64_t t0;
+	int ret;
+
+	/*
+	 * Stream cipher, fused with message compression:
+	 *	m := c[24..24+mlen] ^ XSalsa20_k0(t' @ c[0..24])
+	 *	hm := Poly1305^2_{k1,k2}(m)
+	 *	h := Poly1305^2_{k3,k4}(ha || hm)
+	 */
+	t0 = daence_stats_begin();
+	memcpy(t_, c, 24);
+	xsalsa20_init(&S, t_, ctx->k0);
+	poly1305x2_init(&poly1305, &ctx->k12);
+	for (i = 0; i < mlen; i += n) {
+		n = (mlen - i < TILE ? mlen - i : TILE);
+		xsalsa20_update(&S, tile, c + 24 + i, n);
+		poly1305x2_update(&poly1305, tile, n);
+	}
+	xsalsa20_clear(&S);
+	compress2(h, &poly1305, ha, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_FUSED, mlen, t0);
+
+	/* t := HXSalsa20_k0(h) */
+	hxsalsa20(t, h, ctx);
+
+	/* Verify tag: t' ?= t (no crypto_verify_24) */
+	memset(t + 24, 0, 8);
+	memset(t_ + 24, 0, 8);
+	ret = crypto_verify_32(t_, t);
+
+	/* Paranoia: clear temporaries.  */
+	if (mlen)
+		explicit_memset(tile, 0, sizeof tile);
+	explicit_memset(h, 0, sizeof h);
+	explicit_memset(t, 0, sizeof t);
+	explicit_memset(t_, 0, sizeof t_);
+
+	return ret;
+}
+
+static int
+open_ha(unsigned char *m, const unsigned char *c, unsigned long long mlen,
+    const unsigned char ha[static 32],
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+
+	return open_detached_ha(m, c + 24, mlen, c, ha, ctx);
+}
+
+void
+crypto_dae_salsa20daence_ctx_init(struct crypto_dae_salsa20daence_ctx *ctx,
+    const unsigned char k[static 96])
+{
+	const unsigned char *k0 = k;	/* k0 := k[0..32] */
+	const unsigned char *k1 = k + 32, *k2 = k + 48;
+	const unsigned char *k3 = k + 64, *k4 = k + 80;
+
+	memcpy(ctx->k0, k0, 32);
+	poly1305x2_setkey(&ctx->k12, k1, k2);
+	poly1305x2_setkey(&ctx->k34, k3, k4);
+}
+
+void
+crypto_dae_salsa20daence_ctx_destroy(struct crypto_dae_salsa20daence_ctx *ctx)
+{
+
+	explicit_memset(ctx->k0, 0, sizeof ctx->k0);
+	poly1305x2_clearkey(&ctx->k12);
+	poly1305x2_clearkey(&ctx->k34);
+}
+
+void
+crypto_dae_salsa20daence_ctx_encrypt(unsigned char *c,
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	unsigned char ha[32];
+	uint64_t t0 = daence_stats_begin();
+
+	compresshdr(ha, a, alen, ctx);
+	encrypt_ha(c, m, mlen, ha, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_SEAL, mlen, t0);
+	explicit_memset(ha, 0, sizeof ha); /* paranoia */
+}
+
+int
+crypto_dae_salsa20daence_ctx_open(unsigned char *m,
+    const unsigned char *c, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	unsigned char ha[32];
+	uint64_t t0 = daence_stats_begin();
+	int ret;
+
+	compresshdr(ha, a, alen, ctx);
+	ret = open_ha(m, c, mlen, ha, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_OPEN, mlen, t0);
+	explicit_memset(ha, 0, sizeof ha); /* paranoia */
+
+	return ret;
+}
+
+int
+crypto_dae_salsa20daence_ctx_verify(const unsigned char *c,
+    unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	unsigned char ha[32];
+	uint64_t t0 = daence_stats_begin();
+	int ret;
+
+	compresshdr(ha, a, alen, ctx);
+	ret = verify_ha(c, mlen, ha, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_VERIFY, mlen, t0);
+	explicit_memset(ha, 0, sizeof ha); /* paranoia */
+
+	return ret;
+}
+
+/*
+ * Authentication only, with an empty message: hm = Poly1305^2_{k1,k2}
+ * of the empty string is zero, so the tag depends on a alone through
+ *
+ *	t := HXSalsa20_k0(Poly1305^2_{k3,k4}(ha || 0^32)),
+ *
+ * and there is no stream cipher to set up at all.
+ */
+static void
+authtag(unsigned char t[static 24],
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	struct poly1305x2 poly1305;
+	unsigned char ham[64] = {0}, h[32];
+	uint64_t t0;
+
+	compresshdr(ham, a, alen, ctx);
+	t0 = daence_stats_begin();
+	poly1305x2_init(&poly1305, &ctx->k34);
+	poly1305x2_update(&poly1305, ham, 64);
+	poly1305x2_final(&poly1305, h, h + 16);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_COMPRESS, 0, t0);
+	hxsalsa20(t, h, ctx);
 
 	/* paranoia */
-	explicit_memset(k1, 0, sizeof k1);
-	explicit_memset(k2, 0, sizeof k2);
-	explicit_memset(k3, 0, sizeof k3);
-	explicit_memset(k4, 0, sizeof k4);
 	explicit_memset(ham, 0, sizeof ham);
 	explicit_memset(h, 0, sizeof h);
+}
+
+static int
+authtag_verify(const unsigned char t[static 24],
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	unsigned char u[32] = {0}, u_[32] = {0};
+	int ret;
+
+	authtag(u, a, alen, ctx);
+	memcpy(u_, t, 24);
+	ret = crypto_verify_32(u_, u);
+
+	/* paranoia */
 	explicit_memset(u, 0, sizeof u);
+	explicit_memset(u_, 0, sizeof u_);
+
+	return ret;
 }
 
 void
-crypto_dae_salsa20daence(unsigned char *c,
+crypto_dae_salsa20daence_ctx_auth(unsigned char t[static 24],
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	uint64_t t0 = daence_stats_begin();
+
+	authtag(t, a, alen, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_AUTH, 0, t0);
+}
+
+int
+crypto_dae_salsa20daence_ctx_auth_verify(const unsigned char t[static 24],
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	uint64_t t0 = daence_stats_begin();
+	int ret;
+
+	ret = authtag_verify(t, a, alen, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_VERIFY, 0, t0);
+
+	return ret;
+}
+
+void
+crypto_dae_salsa20daence_ctx_auth_batch(
+    struct crypto_dae_salsa20daence_authbatch *b, size_t n,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	uint64_t t0 = daence_stats_begin();
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		authtag(b[i].t, b[i].a, b[i].alen, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_AUTH, 0, t0);
+}
+
+int
+crypto_dae_salsa20daence_ctx_auth_verify_batch(
+    struct crypto_dae_salsa20daence_authbatch *b, size_t n,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	uint64_t t0 = daence_stats_begin();
+	size_t i;
+	int ret = 0;
+
+	for (i = 0; i < n; i++)
+		ret |= b[i].ret = authtag_verify(b[i].t, b[i].a, b[i].alen,
+		    ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_VERIFY, 0, t0);
+
+	return ret;
+}
+
+void
+crypto_dae_salsa20daence_ctx_tag(unsigned char t[static 24],
     const unsigned char *m, unsigned long long mlen,
     const unsigned char *a, unsigned long long alen,
-    const unsigned char k[static 96])
+    const struct crypto_dae_salsa20daence_ctx *ctx)
 {
-	const unsigned char *k0 = k;	/* k0 := k[0..32] */
+	unsigned char ha[32];
+	uint64_t t0 = daence_stats_begin();
 
-	/* c[0..24] := HXSalsa20_k0(Poly1305^2(a,m)) */
-	compressauth(c, m, mlen, a, alen, k);
+	/* t := HXSalsa20_k0(Poly1305^2(a,m)), and no stream */
+	compresshdr(ha, a, alen, ctx);
+	compressauth(t, m, mlen, ha, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_AUTH, mlen, t0);
+	explicit_memset(ha, 0, sizeof ha); /* paranoia */
+}
 
-	/*
-	 * Stream cipher:
-	 *	c[24..24+mlen] := m[0..mlen]
-	 *	    ^ XSalsa20_k0(t @ c[0..24])
-	 */
-	crypto_stream_xsalsa20_xor(c + 24, m, mlen, c, k0);
+/*
+ * There is no multi-lane HSalsa20 here to share across a batch, so
+ * this is just a loop; it still keeps the stats to one entry.
+ */
+void
+crypto_dae_salsa20daence_ctx_tag_batch(
+    struct crypto_dae_salsa20daence_tagbatch *b, size_t n,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	unsigned char ha[32];
+	unsigned long long nbytes = 0;
+	uint64_t t0 = daence_stats_begin();
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		nbytes += b[i].mlen;
+		compresshdr(ha, b[i].a, b[i].alen, ctx);
+		compressauth(b[i].t, b[i].m, b[i].mlen, ha, ctx);
+	}
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_AUTH, nbytes, t0);
+	explicit_memset(ha, 0, sizeof ha); /* paranoia */
+}
+
+void
+crypto_dae_salsa20daence_ctx_encrypt_detached(unsigned char *c,
+    unsigned char t[static 24],
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	unsigned char ha[32];
+	uint64_t t0 = daence_stats_begin();
+
+	compresshdr(ha, a, alen, ctx);
+	encrypt_detached_ha(c, t, m, mlen, ha, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_SEAL, mlen, t0);
+	explicit_memset(ha, 0, sizeof ha); /* paranoia */
 }
 
 int
-crypto_dae_salsa20daence_open(unsigned char *m,
+crypto_dae_salsa20daence_ctx_open_detached(unsigned char *m,
     const unsigned char *c, unsigned long long mlen,
+    const unsigned char t[static 24],
     const unsigned char *a, unsigned long long alen,
-    const unsigned char k[static 96])
+    const struct crypto_dae_salsa20daence_ctx *ctx)
 {
-	const unsigned char *k0 = k;	/* k0 := k[0..32] */
-	unsigned char t[32], t_[32];
+	unsigned char ha[32];
+	uint64_t t0 = daence_stats_begin();
+	int ret;
+
+	compresshdr(ha, a, alen, ctx);
+	ret = open_detached_ha(m, c, mlen, t, ha, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_OPEN, mlen, t0);
+	explicit_memset(ha, 0, sizeof ha); /* paranoia */
+
+	return ret;
+}
+
+void
+crypto_dae_salsa20daence_hdr_init(struct crypto_dae_salsa20daence_hdr *hdr,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+
+	compresshdr(hdr->ha, a, alen, ctx);
+}
+
+void
+crypto_dae_salsa20daence_hdr_destroy(struct crypto_dae_salsa20daence_hdr *hdr)
+{
+
+	explicit_memset(hdr->ha, 0, sizeof hdr->ha);
+}
+
+void
+crypto_dae_salsa20daence_hdr_encrypt(unsigned char *c,
+    const unsigned char *m, unsigned long long mlen,
+    const struct crypto_dae_salsa20daence_hdr *hdr,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	uint64_t t0 = daence_stats_begin();
+
+	encrypt_ha(c, m, mlen, hdr->ha, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_SEAL, mlen, t0);
+}
+
+int
+crypto_dae_salsa20daence_hdr_open(unsigned char *m,
+    const unsigned char *c, unsigned long long mlen,
+    const struct crypto_dae_salsa20daence_hdr *hdr,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	uint64_t t0 = daence_stats_begin();
 	int ret;
 
+	ret = open_ha(m, c, mlen, hdr->ha, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_OPEN, mlen, t0);
+
+	return ret;
+}
+
+/*
+ * Header cache: up to n headers with their hashes, kept in an array
+ * ordered from most to least recently used.  Lookup is a linear scan
+ * comparing lengths first and then bytes, which is much cheaper than
+ * hashing the header for the small sets of headers this is meant for.
+ * The header is public, so comparing it in variable time is fine.
+ */
+struct crypto_dae_salsa20daence_hdrcache {
+	const struct crypto_dae_salsa20daence_ctx *ctx;
+	unsigned			n, nused;
+	struct hdrcache_entry {
+		unsigned char		*a;
+		unsigned long long	alen;
+		struct crypto_dae_salsa20daence_hdr hdr;
+	}				*ent[];
+};
+
+struct crypto_dae_salsa20daence_hdrcache *
+crypto_dae_salsa20daence_hdrcache_create(
+    const struct crypto_dae_salsa20daence_ctx *ctx, unsigned n)
+{
+	struct crypto_dae_salsa20daence_hdrcache *cache;
+
+	if (n == 0)
+		return NULL;
+	cache = calloc(1, offsetof(struct crypto_dae_salsa20daence_hdrcache,
+		ent[n]));
+	if (cache == NULL)
+		return NULL;
+	cache->ctx = ctx;
+	cache->n = n;
+	cache->nused = 0;
+
+	return cache;
+}
+
+static void
+hdrcache_free(struct hdrcache_entry *E)
+{
+
+	crypto_dae_salsa20daence_hdr_destroy(&E->hdr);
+	free(E->a);
+	free(E);
+}
+
+void
+crypto_dae_salsa20daence_hdrcache_destroy(
+    struct crypto_dae_salsa20daence_hdrcache *cache)
+{
+	unsigned i;
+
+	if (cache == NULL)
+		return;
+	for (i = 0; i < cache->nused; i++)
+		hdrcache_free(cache->ent[i]);
+	free(cache);
+}
+
+/*
+ * Find the hash of a, computing and caching it if need be, and move it
+ * to the front.  If we can't allocate memory, hash into *tmp instead.
+ */
+static const struct crypto_dae_salsa20daence_hdr *
+hdrcache_lookup(struct crypto_dae_salsa20daence_hdrcache *cache,
+    const unsigned char *a, unsigned long long alen,
+    struct crypto_dae_salsa20daence_hdr *tmp)
+{
+	struct hdrcache_entry *E;
+	unsigned i;
+
+	for (i = 0; i < cache->nused; i++) {
+		E = cache->ent[i];
+		if (E->alen == alen &&
+		    (alen == 0 || memcmp(E->a, a, alen) == 0))
+			goto hit;
+	}
+
+	/* Miss: evict the least recently used entry if we're full.  */
+	if (alen > SIZE_MAX ||
+	    (E = malloc(sizeof *E)) == NULL)
+		goto fail;
+	if ((E->a = malloc(alen ? alen : 1)) == NULL) {
+		free(E);
+		goto fail;
+	}
+	if (alen)
+		memcpy(E->a, a, alen);
+	E->alen = alen;
+	crypto_dae_salsa20daence_hdr_init(&E->hdr, a, alen, cache->ctx);
+	if (cache->nused == cache->n)
+		hdrcache_free(cache->ent[--cache->nused]);
+	i = cache->nused++;
+
+hit:	memmove(&cache->ent[1], &cache->ent[0], i * sizeof cache->ent[0]);
+	cache->ent[0] = E;
+	return &E->hdr;
+
+fail:	crypto_dae_salsa20daence_hdr_init(tmp, a, alen, cache->ctx);
+	return tmp;
+}
+
+void
+crypto_dae_salsa20daence_hdrcache_encrypt(unsigned char *c,
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    struct crypto_dae_salsa20daence_hdrcache *cache)
+{
+	struct crypto_dae_salsa20daence_hdr tmp;
+	uint64_t t0 = daence_stats_begin();
+
+	encrypt_ha(c, m, mlen, hdrcache_lookup(cache, a, alen, &tmp)->ha,
+	    cache->ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_SEAL, mlen, t0);
+	crypto_dae_salsa20daence_hdr_destroy(&tmp);
+}
+
+int
+crypto_dae_salsa20daence_hdrcache_open(unsigned char *m,
+    const unsigned char *c, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    struct crypto_dae_salsa20daence_hdrcache *cache)
+{
+	struct crypto_dae_salsa20daence_hdr tmp;
+	uint64_t t0 = daence_stats_begin();
+	int ret;
+
+	ret = open_ha(m, c, mlen, hdrcache_lookup(cache, a, alen, &tmp)->ha,
+	    cache->ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_OPEN, mlen, t0);
+	crypto_dae_salsa20daence_hdr_destroy(&tmp);
+
+	return ret;
+}
+
+/*
+ * Parallel processing of one large message, with the chunks of
+ * daence_chunk.c: XSalsa20 is run from each chunk's first block, on a
+ * copy of the stream state set up for the tag.
+ */
+
+static void
+chunk_stream(const void *cookie, unsigned char *out, const unsigned char *in,
+    unsigned long long n, uint64_t blk)
+{
+	struct xsalsa20 xs = *(const struct xsalsa20 *)cookie;
+
+	xsalsa20_seek(&xs, blk);
+	xsalsa20_update(&xs, out, in, n);
+	xsalsa20_clear(&xs);
+}
+
+/*
+ * Join the chunk hashes into hm, absorbing the last few bytes of the
+ * plaintext m that no chunk hashed, and finish h := HXSalsa20 of
+ * Poly1305^2_{k3,k4}(ha || hm) into t.
+ */
+static void
+chunk_auth(unsigned char t[static 24], struct daence_chunk *C, unsigned n,
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char ha[static 32],
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	struct poly1305x2 poly1305;
+	unsigned char h[32];
+
+	poly1305x2_init(&poly1305, &ctx->k12);
+	daence_chunk_join(&poly1305, C, n, m, mlen);
+	compress2(h, &poly1305, ha, ctx);
+	hxsalsa20(t, h, ctx);
+
+	explicit_memset(h, 0, sizeof h); /* paranoia */
+}
+
+void
+crypto_dae_salsa20daence_ctx_parallel(unsigned char *c,
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_salsa20daence_ctx *ctx, unsigned nthreads)
+{
+	struct daence_chunk C[DAENCE_CHUNK_MAXTHREADS];
+	struct xsalsa20 xs;
+	unsigned char ha[32];
+	uint64_t t0 = daence_stats_begin();
+	unsigned i, n;
+
+	n = daence_chunk_split(C, nthreads, mlen);
+
+	/* c[0..24] := t := HXSalsa20_k0(Poly1305^2(a,m)), m in chunks */
+	compresshdr(ha, a, alen, ctx);
+	for (i = 0; i < n; i++) {
+		C[i].in = m + C[i].off;
+		C[i].k12 = &ctx->k12;
+	}
+	daence_chunk_runall(C, n);
+	chunk_auth(c, C, n, m, mlen, ha, ctx);
+
+	/* Stream cipher, in chunks: c[24..24+mlen] := m ^ XSalsa20_k0(t) */
+	xsalsa20_init(&xs, c, ctx->k0);
+	for (i = 0; i < n; i++) {
+		C[i].out = c + 24 + C[i].off;
+		C[i].stream = chunk_stream;
+		C[i].key = &xs;
+		C[i].k12 = NULL;
+	}
+	daence_chunk_runall(C, n);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_SEAL, mlen, t0);
+
+	/* paranoia */
+	explicit_memset(ha, 0, sizeof ha);
+	xsalsa20_clear(&xs);
+	explicit_memset(C, 0, sizeof C);
+}
+
+int
+crypto_dae_salsa20daence_ctx_open_parallel(unsigned char *m,
+    const unsigned char *c, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const struct crypto_dae_salsa20daence_ctx *ctx, unsigned nthreads)
+{
+	struct daence_chunk C[DAENCE_CHUNK_MAXTHREADS];
+	struct xsalsa20 xs;
+	unsigned char ha[32], t[32] = {0}, t_[32] = {0};
+	uint64_t t0 = daence_stats_begin();
+	unsigned i, n;
+	int ret;
+
+	n = daence_chunk_split(C, nthreads, mlen);
+
 	/*
-	 * Stream cipher:
-	 *	m[0..mlen] := c[24..24+mlen]
-	 *	    ^ XSalsa20_k0(t' @ c[0..24])
+	 * Stream cipher, fused with message compression, in chunks:
+	 *	m[0..mlen] := c[24..24+mlen] ^ XSalsa20_k0(t')
+	 *	t := HXSalsa20_k0(Poly1305^2(a,m))
 	 */
-	crypto_stream_xsalsa20_xor(m, c + 24, mlen, c, k0);
+	compresshdr(ha, a, alen, ctx);
+	memcpy(t_, c, 24);
+	xsalsa20_init(&xs, t_, ctx->k0);
+	for (i = 0; i < n; i++) {
+		C[i].out = m + C[i].off;
+		C[i].in = c + 24 + C[i].off;
+		C[i].stream = chunk_stream;
+		C[i].key = &xs;
+		C[i].k12 = &ctx->k12;
+	}
+	daence_chunk_runall(C, n);
+	chunk_auth(t, C, n, m, mlen, ha, ctx);
+
+	/* Verify tag: t' ?= t (no crypto_verify_24) */
+	ret = crypto_verify_32(t_, t);
+	if (ret)
+		explicit_memset(m, 0, mlen); /* paranoia */
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_OPEN, mlen, t0);
+
+	/* Paranoia: clear temporaries.  */
+	explicit_memset(ha, 0, sizeof ha);
+	explicit_memset(t, 0, sizeof t);
+	explicit_memset(t_, 0, sizeof t_);
+	xsalsa20_clear(&xs);
+	explicit_memset(C, 0, sizeof C);
+
+	return ret;
+}
+
+/*
+ * Scatter/gather: the message, header, and output are each given as
+ * an array of struct iovec, with segment boundaries anywhere.  The
+ * Poly1305^2 states and the XSalsa20 keystream carry across
+ * boundaries, so nothing is copied into a staging buffer.
+ */
+
+/*
+ * Run the stream cipher S from the segments under I to the segments
+ * under O for len bytes, in runs contiguous on both sides.
+ */
+static void
+xsalsa20_iov(struct daence_iovcur *O, struct daence_iovcur *I,
+    unsigned long long len, struct xsalsa20 *S)
+{
+	unsigned long long off = 0;
+	unsigned char *op, *ip;
+	size_t on, in;
+
+	while (off < len) {
+		on = daence_iovcur_next(O, &op, len - off);
+		for (; on; op += in, on -= in, off += in) {
+			in = daence_iovcur_next(I, &ip, on);
+			xsalsa20_update(S, op, ip, in);
+		}
+	}
+}
+
+static void
+poly1305x2_update_iov(struct poly1305x2 *poly1305, const struct iovec *iov,
+    int iovcnt)
+{
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		poly1305x2_update(poly1305, iov[i].iov_base, iov[i].iov_len);
+}
+
+/* t := HXSalsa20_k0(Poly1305^2_{k3,k4}(ha || Poly1305^2_{k1,k2}(m))) */
+static void
+compressauth_iov(unsigned char t[static 24], const struct iovec *mv,
+    int mvcnt, unsigned long long mlen,
+    const struct iovec *av, int avcnt, unsigned long long alen,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	struct poly1305x2 poly1305;
+	unsigned char ha[32], h[32];
+	uint64_t t0 = daence_stats_begin();
+
+	poly1305x2_init(&poly1305, &ctx->k12);
+	poly1305x2_update_iov(&poly1305, av, avcnt);
+	poly1305x2_final(&poly1305, ha, ha + 16);
+	poly1305x2_init(&poly1305, &ctx->k12);
+	poly1305x2_update_iov(&poly1305, mv, mvcnt);
+	compress2(h, &poly1305, ha, ctx);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_COMPRESS,
+	    mlen + alen, t0);
+
+	hxsalsa20(t, h, ctx);
+
+	/* paranoia */
+	explicit_memset(ha, 0, sizeof ha);
+	explicit_memset(h, 0, sizeof h);
+}
+
+int
+crypto_dae_salsa20daence_ctx_encryptv(const struct iovec *cv, int cvcnt,
+    const struct iovec *mv, int mvcnt,
+    const struct iovec *av, int avcnt,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	unsigned long long mlen = daence_iov_total(mv, mvcnt);
+	unsigned long long alen = daence_iov_total(av, avcnt);
+	struct daence_iovcur C = { cv, cvcnt, 0 }, M = { mv, mvcnt, 0 };
+	struct xsalsa20 S;
+	unsigned char t[24];
+	uint64_t t0 = daence_stats_begin(), t1;
+
+	if (daence_iov_total(cv, cvcnt) != 24 + mlen)
+		return -1;
+
+	/* c[0..24] := t := HXSalsa20_k0(Poly1305^2(a,m)) */
+	compressauth_iov(t, mv, mvcnt, mlen, av, avcnt, alen, ctx);
+	daence_iovcur_write(&C, t, 24);
+
+	/* c[24..24+mlen] := m[0..mlen] ^ XSalsa20_k0(t) */
+	t1 = daence_stats_begin();
+	xsalsa20_init(&S, t, ctx->k0);
+	xsalsa20_iov(&C, &M, mlen, &S);
+	xsalsa20_clear(&S);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_STREAM, mlen, t1);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_SEAL, mlen, t0);
+
+	explicit_memset(t, 0, sizeof t); /* paranoia */
+
+	return 0;
+}
+
+int
+crypto_dae_salsa20daence_ctx_openv(const struct iovec *mv, int mvcnt,
+    const struct iovec *cv, int cvcnt,
+    const struct iovec *av, int avcnt,
+    const struct crypto_dae_salsa20daence_ctx *ctx)
+{
+	unsigned long long mlen = daence_iov_total(mv, mvcnt);
+	unsigned long long alen = daence_iov_total(av, avcnt);
+	struct daence_iovcur C = { cv, cvcnt, 0 }, M = { mv, mvcnt, 0 };
+	struct xsalsa20 S;
+	unsigned char t[32], t_[32];
+	uint64_t t0 = daence_stats_begin(), t1;
+	int i, ret;
+
+	if (daence_iov_total(cv, cvcnt) != 24 + mlen)
+		return -1;
+
+	/* t' := c[0..24] */
+	memset(t_, 0, sizeof t_);
+	daence_iovcur_read(&C, t_, 24);
+
+	/* m[0..mlen] := c[24..24+mlen] ^ XSalsa20_k0(t') */
+	t1 = daence_stats_begin();
+	xsalsa20_init(&S, t_, ctx->k0);
+	xsalsa20_iov(&M, &C, mlen, &S);
+	xsalsa20_clear(&S);
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_STREAM, mlen, t1);
 
 	/* t := HXSalsa20_k0(Poly1305^2(a,m)) */
-	compressauth(t, m, mlen, a, alen, k);
+	compressauth_iov(t, mv, mvcnt, mlen, av, avcnt, alen, ctx);
 
-	/* Verify tag: c[0..24] ?= t (no crypto_verify_24) */
-	memcpy(t_, c, 24);
+	/* Verify tag: t' ?= t (no crypto_verify_24) */
 	memset(t + 24, 0, 8);
-	memset(t_ + 24, 0, 8);
 	ret = crypto_verify_32(t_, t);
-	if (ret)
-		explicit_memset(m, 0, mlen); /* paranoia */
+	if (ret) {		/* paranoia */
+		for (i = 0; i < mvcnt; i++)
+			explicit_memset(mv[i].iov_base, 0, mv[i].iov_len);
+	}
+	daence_stats_end(DAENCE_IMPL_SALSA20, DAENCE_PHASE_OPEN, mlen, t0);
 
 	/* Paranoia: clear temporaries.  */
 	explicit_memset(t, 0, sizeof t);
@@ -157,6 +978,158 @@ crypto_dae_salsa20daence_open(unsigned char *m,
 	return ret;
 }
 
+void
+crypto_dae_salsa20daence(unsigned char *c,
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 96])
+{
+	struct crypto_dae_salsa20daence_ctx ctx;
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	crypto_dae_salsa20daence_ctx_encrypt(c, m, mlen, a, alen, &ctx);
+	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+}
+
+int
+crypto_dae_salsa20daence_open(unsigned char *m,
+    const unsigned char *c, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 96])
+{
+	struct crypto_dae_salsa20daence_ctx ctx;
+	int ret;
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	ret = crypto_dae_salsa20daence_ctx_open(m, c, mlen, a, alen, &ctx);
+	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+int
+crypto_dae_salsa20daence_verify(const unsigned char *c,
+    unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 96])
+{
+	struct crypto_dae_salsa20daence_ctx ctx;
+	int ret;
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	ret = crypto_dae_salsa20daence_ctx_verify(c, mlen, a, alen, &ctx);
+	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+void
+crypto_dae_salsa20daence_auth(unsigned char t[static 24],
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 96])
+{
+	struct crypto_dae_salsa20daence_ctx ctx;
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	crypto_dae_salsa20daence_ctx_auth(t, a, alen, &ctx);
+	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+}
+
+int
+crypto_dae_salsa20daence_auth_verify(const unsigned char t[static 24],
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 96])
+{
+	struct crypto_dae_salsa20daence_ctx ctx;
+	int ret;
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	ret = crypto_dae_salsa20daence_ctx_auth_verify(t, a, alen, &ctx);
+	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+void
+crypto_dae_salsa20daence_tag(unsigned char t[static 24],
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 96])
+{
+	struct crypto_dae_salsa20daence_ctx ctx;
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	crypto_dae_salsa20daence_ctx_tag(t, m, mlen, a, alen, &ctx);
+	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+}
+
+void
+crypto_dae_salsa20daence_detached(unsigned char *c,
+    unsigned char t[static 24],
+    const unsigned char *m, unsigned long long mlen,
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 96])
+{
+	struct crypto_dae_salsa20daence_ctx ctx;
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	crypto_dae_salsa20daence_ctx_encrypt_detached(c, t, m, mlen, a, alen,
+	    &ctx);
+	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+}
+
+int
+crypto_dae_salsa20daence_open_detached(unsigned char *m,
+    const unsigned char *c, unsigned long long mlen,
+    const unsigned char t[static 24],
+    const unsigned char *a, unsigned long long alen,
+    const unsigned char k[static 96])
+{
+	struct crypto_dae_salsa20daence_ctx ctx;
+	int ret;
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	ret = crypto_dae_salsa20daence_ctx_open_detached(m, c, mlen, t, a,
+	    alen, &ctx);
+	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+int
+crypto_dae_salsa20daence_encryptv(const struct iovec *cv, int cvcnt,
+    const struct iovec *mv, int mvcnt,
+    const struct iovec *av, int avcnt,
+    const unsigned char k[static 96])
+{
+	struct crypto_dae_salsa20daence_ctx ctx;
+	int ret;
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	ret = crypto_dae_salsa20daence_ctx_encryptv(cv, cvcnt, mv, mvcnt,
+	    av, avcnt, &ctx);
+	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+int
+crypto_dae_salsa20daence_openv(const struct iovec *mv, int mvcnt,
+    const struct iovec *cv, int cvcnt,
+    const struct iovec *av, int avcnt,
+    const unsigned char k[static 96])
+{
+	struct crypto_dae_salsa20daence_ctx ctx;
+	int ret;
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	ret = crypto_dae_salsa20daence_ctx_openv(mv, mvcnt, cv, cvcnt,
+	    av, avcnt, &ctx);
+	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+
+	return ret;
+}
+
 int
 crypto_dae_salsa20daence_selftest(void)
 {
@@ -193,8 +1166,13 @@ crypto_dae_salsa20daence_selftest(void)
 		0x19,0x35,0x56,0x63,0x18,0x55,0x38,0x71,
 		0xb9,0x0c,0xc9,0x08,0x29,0xa9,0xd9,0x60, 0xf9,
 	};
+	struct crypto_dae_salsa20daence_ctx ctx;
+	struct crypto_dae_salsa20daence_hdr hdr;
+	struct crypto_dae_salsa20daence_hdrcache *cache = NULL;
 	unsigned char c0[sizeof c];
 	unsigned char m0[sizeof m];
+	unsigned i;
+	int ret = -1;
 
 	crypto_dae_salsa20daence(c0, m, sizeof m, a, sizeof a, k);
 	if (memcmp(c, c0, sizeof c) != 0)
@@ -208,5 +1186,58 @@ crypto_dae_salsa20daence_selftest(void)
 	    == 0)
 		return -1;
 
-	return 0;
+	/* Same again, reusing one expanded key.  */
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	crypto_dae_salsa20daence_ctx_encrypt(c0, m, sizeof m, a, sizeof a,
+	    &ctx);
+	if (memcmp(c, c0, sizeof c) != 0)
+		goto out;
+	if (crypto_dae_salsa20daence_ctx_open(m0, c, sizeof m, a, sizeof a,
+		&ctx))
+		goto out;
+	if (memcmp(m, m0, sizeof m) != 0)
+		goto out;
+	c0[18] ^= 0x4;
+	if (crypto_dae_salsa20daence_ctx_open(m0, c0, sizeof m, a, sizeof a,
+		&ctx) == 0)
+		goto out;
+
+	/* Same again, with a precomputed header hash.  */
+	crypto_dae_salsa20daence_hdr_init(&hdr, a, sizeof a, &ctx);
+	crypto_dae_salsa20daence_hdr_encrypt(c0, m, sizeof m, &hdr, &ctx);
+	if (memcmp(c, c0, sizeof c) != 0)
+		goto out;
+	if (crypto_dae_salsa20daence_hdr_open(m0, c, sizeof m, &hdr, &ctx))
+		goto out;
+	if (memcmp(m, m0, sizeof m) != 0)
+		goto out;
+	c0[18] ^= 0x4;
+	if (crypto_dae_salsa20daence_hdr_open(m0, c0, sizeof m, &hdr, &ctx)
+	    == 0)
+		goto out;
+
+	/*
+	 * Same again, through a two-entry header cache, with other
+	 * headers (prefixes of a) pushing a out of it in between.
+	 */
+	if ((cache = crypto_dae_salsa20daence_hdrcache_create(&ctx, 2))
+	    == NULL)
+		goto out;
+	for (i = 0; i < 4; i++) {
+		crypto_dae_salsa20daence_hdrcache_encrypt(c0, m, sizeof m,
+		    a, sizeof a - i, cache);
+		if ((memcmp(c, c0, sizeof c) == 0) != (i == 0))
+			goto out;
+		if (crypto_dae_salsa20daence_hdrcache_open(m0, c, sizeof m,
+			a, sizeof a - i, cache) != -(i != 0))
+			goto out;
+		if (i == 0 && memcmp(m, m0, sizeof m) != 0)
+			goto out;
+	}
+	ret = 0;
+
+out:	crypto_dae_salsa20daence_hdrcache_destroy(cache);
+	crypto_dae_salsa20daence_hdr_destroy(&hdr);
+	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+	return ret;
 }
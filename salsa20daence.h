@@ -27,9 +27,24 @@
 #ifndef SALSA20DAENCE_H
 #define	SALSA20DAENCE_H
 
+#include <sys/uio.h>
+
+#include "poly1305x2.h"
+
 #define	crypto_dae_salsa20daence_KEYBYTES	96u
 #define	crypto_dae_salsa20daence_TAGBYTES	24u
 
+/*
+ * Expanded key, for callers that encrypt many messages under one key:
+ * initialize once with crypto_dae_salsa20daence_ctx_init, use for any
+ * number of messages, and erase with crypto_dae_salsa20daence_ctx_destroy.
+ */
+struct crypto_dae_salsa20daence_ctx {
+	unsigned char		k0[32];
+	struct poly1305x2_key	k12;
+	struct poly1305x2_key	k34;
+};
+
 void crypto_dae_salsa20daence(unsigned char */*c*/,
     const unsigned char */*m*/, unsigned long long /*mlen*/,
     const unsigned char */*a*/, unsigned long long /*alen*/,
@@ -40,6 +55,243 @@ int crypto_dae_salsa20daence_open(unsigned char */*m*/,
     const unsigned char */*a*/, unsigned long long /*alen*/,
     const unsigned char[static crypto_dae_salsa20daence_KEYBYTES]);
 
+void crypto_dae_salsa20daence_ctx_init(struct crypto_dae_salsa20daence_ctx *,
+    const unsigned char[static crypto_dae_salsa20daence_KEYBYTES]);
+
+void crypto_dae_salsa20daence_ctx_destroy(
+    struct crypto_dae_salsa20daence_ctx *);
+
+void crypto_dae_salsa20daence_ctx_encrypt(unsigned char */*c*/,
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+int crypto_dae_salsa20daence_ctx_open(unsigned char */*m*/,
+    const unsigned char */*c*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+/*
+ * Verify only: return 0 if c[0..24+mlen] is authentic with header a,
+ * or -1 if it is a forgery, as crypto_dae_salsa20daence_open would,
+ * but without writing the plaintext anywhere.  It is decrypted a tile
+ * at a time into a few kilobytes of stack and discarded once hashed,
+ * so scrubbing stored ciphertexts needs no message-sized buffer.
+ */
+int crypto_dae_salsa20daence_verify(const unsigned char */*c*/,
+    unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const unsigned char[static crypto_dae_salsa20daence_KEYBYTES]);
+
+int crypto_dae_salsa20daence_ctx_verify(const unsigned char */*c*/,
+    unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+/*
+ * Authentication only: the tag of an empty message with header a, as
+ * crypto_dae_salsa20daence(t, NULL, 0, a, alen, k) would write, but
+ * without the length handling or the stream cipher setup.  _auth_verify
+ * returns 0 if t is the tag of a, -1 if not.  The batch calls process
+ * n headers under one ctx, so the key is expanded once for all; in
+ * _auth_verify_batch, each ret is set to 0 or -1, and the return value
+ * is 0 only if every tag is good.
+ */
+struct crypto_dae_salsa20daence_authbatch {
+	unsigned char		*t;
+	const unsigned char	*a;
+	unsigned long long	alen;
+	int			ret;
+};
+
+void crypto_dae_salsa20daence_auth(
+    unsigned char[static crypto_dae_salsa20daence_TAGBYTES],
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const unsigned char[static crypto_dae_salsa20daence_KEYBYTES]);
+
+int crypto_dae_salsa20daence_auth_verify(
+    const unsigned char[static crypto_dae_salsa20daence_TAGBYTES],
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const unsigned char[static crypto_dae_salsa20daence_KEYBYTES]);
+
+void crypto_dae_salsa20daence_ctx_auth(
+    unsigned char[static crypto_dae_salsa20daence_TAGBYTES],
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+int crypto_dae_salsa20daence_ctx_auth_verify(
+    const unsigned char[static crypto_dae_salsa20daence_TAGBYTES],
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+void crypto_dae_salsa20daence_ctx_auth_batch(
+    struct crypto_dae_salsa20daence_authbatch *, size_t,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+int crypto_dae_salsa20daence_ctx_auth_verify_batch(
+    struct crypto_dae_salsa20daence_authbatch *, size_t,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+/*
+ * Detached tag: same as above, but the 24-byte tag t and the mlen-byte
+ * ciphertext c are kept apart instead of as c = t || ciphertext, so a
+ * message can be sealed and opened in place in its own buffer with
+ * c = m.  Otherwise c and m must not overlap.  On forgery, m is
+ * zeroed -- in place, that destroys the ciphertext too.
+ */
+void crypto_dae_salsa20daence_detached(unsigned char */*c*/,
+    unsigned char[static crypto_dae_salsa20daence_TAGBYTES],
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const unsigned char[static crypto_dae_salsa20daence_KEYBYTES]);
+
+int crypto_dae_salsa20daence_open_detached(unsigned char */*m*/,
+    const unsigned char */*c*/, unsigned long long /*mlen*/,
+    const unsigned char[static crypto_dae_salsa20daence_TAGBYTES],
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const unsigned char[static crypto_dae_salsa20daence_KEYBYTES]);
+
+void crypto_dae_salsa20daence_ctx_encrypt_detached(unsigned char */*c*/,
+    unsigned char[static crypto_dae_salsa20daence_TAGBYTES],
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+int crypto_dae_salsa20daence_ctx_open_detached(unsigned char */*m*/,
+    const unsigned char */*c*/, unsigned long long /*mlen*/,
+    const unsigned char[static crypto_dae_salsa20daence_TAGBYTES],
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+/*
+ * Tag only: set t to the 24-byte tag that crypto_dae_salsa20daence
+ * would put in c[0..24] for m and a, without running the stream cipher
+ * or writing any ciphertext, e.g. to probe a deduplicating store before
+ * paying to encrypt.  Like the ciphertext, the tag reveals which
+ * messages are equal.  The batch call sets each t for n messages under
+ * one ctx.
+ */
+struct crypto_dae_salsa20daence_tagbatch {
+	unsigned char		*t;
+	const unsigned char	*m;
+	unsigned long long	mlen;
+	const unsigned char	*a;
+	unsigned long long	alen;
+};
+
+void crypto_dae_salsa20daence_tag(
+    unsigned char[static crypto_dae_salsa20daence_TAGBYTES],
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const unsigned char[static crypto_dae_salsa20daence_KEYBYTES]);
+
+void crypto_dae_salsa20daence_ctx_tag(
+    unsigned char[static crypto_dae_salsa20daence_TAGBYTES],
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+void crypto_dae_salsa20daence_ctx_tag_batch(
+    struct crypto_dae_salsa20daence_tagbatch *, size_t,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+/*
+ * Precomputed header hash, for callers that send many messages with
+ * the same header a: Poly1305^2_{k1,k2}(a) depends only on the key and
+ * a, so it can be computed once with crypto_dae_salsa20daence_hdr_init
+ * and reused with the ctx it was made from.  Erase with
+ * crypto_dae_salsa20daence_hdr_destroy.
+ */
+struct crypto_dae_salsa20daence_hdr {
+	unsigned char		ha[32];
+};
+
+void crypto_dae_salsa20daence_hdr_init(struct crypto_dae_salsa20daence_hdr *,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+void crypto_dae_salsa20daence_hdr_destroy(
+    struct crypto_dae_salsa20daence_hdr *);
+
+void crypto_dae_salsa20daence_hdr_encrypt(unsigned char */*c*/,
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const struct crypto_dae_salsa20daence_hdr *,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+int crypto_dae_salsa20daence_hdr_open(unsigned char */*m*/,
+    const unsigned char */*c*/, unsigned long long /*mlen*/,
+    const struct crypto_dae_salsa20daence_hdr *,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+/*
+ * Cache of header hashes keyed by header bytes, holding at most n
+ * entries and evicting the least recently used.  Meant for a handful
+ * of distinct headers; lookup is a linear scan.  The ctx must outlive
+ * the cache.  Not thread-safe.  Returns NULL if n is zero or out of
+ * memory.
+ */
+struct crypto_dae_salsa20daence_hdrcache;
+
+struct crypto_dae_salsa20daence_hdrcache *
+crypto_dae_salsa20daence_hdrcache_create(
+    const struct crypto_dae_salsa20daence_ctx *, unsigned /*n*/);
+
+void crypto_dae_salsa20daence_hdrcache_destroy(
+    struct crypto_dae_salsa20daence_hdrcache *);
+
+void crypto_dae_salsa20daence_hdrcache_encrypt(unsigned char */*c*/,
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    struct crypto_dae_salsa20daence_hdrcache *);
+
+int crypto_dae_salsa20daence_hdrcache_open(unsigned char */*m*/,
+    const unsigned char */*c*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    struct crypto_dae_salsa20daence_hdrcache *);
+
+/*
+ * Same as crypto_dae_salsa20daence_ctx_encrypt and _ctx_open, but for a
+ * single large message split across up to nthreads threads, including
+ * the calling thread.  The output is the same.  Messages too short to
+ * be worth splitting are processed on the calling thread alone.
+ */
+void crypto_dae_salsa20daence_ctx_parallel(unsigned char */*c*/,
+    const unsigned char */*m*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_salsa20daence_ctx *, unsigned /*nthreads*/);
+
+int crypto_dae_salsa20daence_ctx_open_parallel(unsigned char */*m*/,
+    const unsigned char */*c*/, unsigned long long /*mlen*/,
+    const unsigned char */*a*/, unsigned long long /*alen*/,
+    const struct crypto_dae_salsa20daence_ctx *, unsigned /*nthreads*/);
+
+/*
+ * Scatter/gather: same as crypto_dae_salsa20daence and _open, with m,
+ * a, and c each given as an array of segments, which may be any
+ * lengths, e.g. for use with readv and writev.  mlen is the total
+ * length of the m segments, and the c segments must total exactly
+ * 24 + mlen.  To work in place, let the c segments be 24 bytes for
+ * the tag followed by the m segments themselves; c and m must not
+ * otherwise overlap.  Returns -1 if the lengths disagree or, for
+ * _openv, if the message is a forgery, in which case the m segments
+ * are zeroed; 0 otherwise.
+ */
+int crypto_dae_salsa20daence_encryptv(const struct iovec */*cv*/, int,
+    const struct iovec */*mv*/, int, const struct iovec */*av*/, int,
+    const unsigned char[static crypto_dae_salsa20daence_KEYBYTES]);
+
+int crypto_dae_salsa20daence_openv(const struct iovec */*mv*/, int,
+    const struct iovec */*cv*/, int, const struct iovec */*av*/, int,
+    const unsigned char[static crypto_dae_salsa20daence_KEYBYTES]);
+
+int crypto_dae_salsa20daence_ctx_encryptv(const struct iovec */*cv*/, int,
+    const struct iovec */*mv*/, int, const struct iovec */*av*/, int,
+    const struct crypto_dae_salsa20daence_ctx *);
+
+int crypto_dae_salsa20daence_ctx_openv(const struct iovec */*mv*/, int,
+    const struct iovec */*cv*/, int, const struct iovec */*av*/, int,
+    const struct crypto_dae_salsa20daence_ctx *);
+
 int crypto_dae_salsa20daence_selftest(void);
 
 #endif  /* SALSA20DAENCE_H */
@@ -0,0 +1,389 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#define	_POSIX_C_SOURCE	200809L
+
+#include "segdaence.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chachadaence.h"
+
+#define	SEG_MAXSIZE	(1ull << 38)	/* Daence message limit */
+#define	SEG_MAXTHREADS	64
+
+static void *(*volatile explicit_memset)(void *, int, size_t) = memset;
+
+/* Domain separation for the two kinds of header.  */
+static const unsigned char index_domain[16] = "daence seg index";
+static const unsigned char segment_domain[16] = "daence seg data\0";
+
+static inline void
+le64enc(void *buf, uint64_t v)
+{
+	unsigned char *p = buf;
+	unsigned i;
+
+	for (i = 0; i < 8; i++)
+		p[i] = v >> (8*i);
+}
+
+static inline uint64_t
+le64dec(const void *buf)
+{
+	const unsigned char *p = buf;
+	uint64_t v = 0;
+	unsigned i;
+
+	for (i = 0; i < 8; i++)
+		v |= (uint64_t)p[i] << (8*i);
+	return v;
+}
+
+/*
+ * Index header: domain || id.
+ */
+static void
+index_header(unsigned char a[static 48], const struct crypto_dae_seg *seg)
+{
+
+	memcpy(a, index_domain, 16);
+	memcpy(a + 16, seg->id, 32);
+}
+
+/*
+ * Segment header: domain || id || len || segsize || nseg || i.  Binding
+ * the whole geometry into every segment, not just the index, means a
+ * segment of one object is no good in another object of different
+ * length with the same id.
+ */
+static void
+segment_header(unsigned char a[static 80], const struct crypto_dae_seg *seg,
+    unsigned long long i)
+{
+
+	memcpy(a, segment_domain, 16);
+	memcpy(a + 16, seg->id, 32);
+	le64enc(a + 48, seg->len);
+	le64enc(a + 56, seg->segsize);
+	le64enc(a + 64, seg->nseg);
+	le64enc(a + 72, i);
+}
+
+static int
+geometry(struct crypto_dae_seg *seg, unsigned long long len,
+    unsigned long long segsize)
+{
+	unsigned long long nseg;
+
+	if (segsize == 0 || segsize % 64 || segsize > SEG_MAXSIZE)
+		return -1;
+	nseg = len/segsize + (len % segsize != 0);
+	if (len > ULLONG_MAX - crypto_dae_seg_INDEXBYTES ||
+	    24*nseg > ULLONG_MAX - crypto_dae_seg_INDEXBYTES - len)
+		return -1;
+
+	seg->len = len;
+	seg->segsize = segsize;
+	seg->nseg = nseg;
+	return 0;
+}
+
+int
+crypto_dae_seg_init(struct crypto_dae_seg *seg,
+    const unsigned char id[static crypto_dae_seg_IDBYTES],
+    unsigned long long len, unsigned long long segsize,
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+
+	memset(seg, 0, sizeof *seg);
+	seg->ctx = ctx;
+	memcpy(seg->id, id, crypto_dae_seg_IDBYTES);
+	return geometry(seg, len, segsize);
+}
+
+void
+crypto_dae_seg_index(const struct crypto_dae_seg *seg,
+    unsigned char ix[static crypto_dae_seg_INDEXBYTES])
+{
+	unsigned char a[48], m[32];
+
+	index_header(a, seg);
+	le64enc(m, seg->len);
+	le64enc(m + 8, seg->segsize);
+	le64enc(m + 16, seg->nseg);
+	le64enc(m + 24, 0);	/* reserved */
+	crypto_dae_chachadaence_ctx_encrypt(ix, m, sizeof m, a, sizeof a,
+	    seg->ctx);
+}
+
+int
+crypto_dae_seg_open_index(struct crypto_dae_seg *seg,
+    const unsigned char ix[static crypto_dae_seg_INDEXBYTES],
+    const unsigned char id[static crypto_dae_seg_IDBYTES],
+    const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	unsigned char a[48], m[32];
+
+	memset(seg, 0, sizeof *seg);
+	seg->ctx = ctx;
+	memcpy(seg->id, id, crypto_dae_seg_IDBYTES);
+	index_header(a, seg);
+	if (crypto_dae_chachadaence_ctx_open(m, ix, sizeof m, a, sizeof a,
+		ctx))
+		return -1;
+
+	/*
+	 * Authentic, but check it anyway: a writer with the key could
+	 * have put anything here, and we compute offsets from it.
+	 */
+	if (geometry(seg, le64dec(m), le64dec(m + 8)) ||
+	    le64dec(m + 16) != seg->nseg ||
+	    le64dec(m + 24) != 0)
+		return -1;
+
+	return 0;
+}
+
+unsigned long long
+crypto_dae_seg_sealedlen(const struct crypto_dae_seg *seg)
+{
+
+	return crypto_dae_seg_INDEXBYTES + 24*seg->nseg + seg->len;
+}
+
+unsigned long long
+crypto_dae_seg_seglen(const struct crypto_dae_seg *seg, unsigned long long i)
+{
+
+	if (i >= seg->nseg)
+		return 0;
+	if (i < seg->nseg - 1)
+		return seg->segsize;
+	return seg->len - i*seg->segsize;
+}
+
+unsigned long long
+crypto_dae_seg_offset(const struct crypto_dae_seg *seg, unsigned long long i)
+{
+
+	return crypto_dae_seg_INDEXBYTES + i*(24 + seg->segsize);
+}
+
+void
+crypto_dae_seg_seal_segment(const struct crypto_dae_seg *seg,
+    unsigned char *c, const unsigned char *m, unsigned long long i)
+{
+	unsigned char a[80];
+
+	segment_header(a, seg, i);
+	crypto_dae_chachadaence_ctx_encrypt(c, m, crypto_dae_seg_seglen(seg, i),
+	    a, sizeof a, seg->ctx);
+}
+
+int
+crypto_dae_seg_open_segment(const struct crypto_dae_seg *seg,
+    unsigned char *m, const unsigned char *c, unsigned long long i)
+{
+	unsigned char a[80];
+
+	if (i >= seg->nseg)
+		return -1;
+	segment_header(a, seg, i);
+	return crypto_dae_chachadaence_ctx_open(m, c,
+	    crypto_dae_seg_seglen(seg, i), a, sizeof a, seg->ctx);
+}
+
+int
+crypto_dae_seg_verify_segment(const struct crypto_dae_seg *seg,
+    const unsigned char *c, unsigned long long i)
+{
+	unsigned char a[80];
+
+	if (i >= seg->nseg)
+		return -1;
+	segment_header(a, seg, i);
+	return crypto_dae_chachadaence_ctx_verify(c,
+	    crypto_dae_seg_seglen(seg, i), a, sizeof a, seg->ctx);
+}
+
+/*
+ * Whole objects: each thread takes a contiguous run of segments, so
+ * that it streams through one region of the input and the output.
+ */
+
+struct segrun {
+	const struct crypto_dae_seg	*seg;
+	unsigned char			*m;
+	unsigned char			*sealed;
+	unsigned long long		start;
+	unsigned long long		end;
+	int				open;
+	int				ret;
+	pthread_t			thread;
+	int				running;
+};
+
+static void *
+segrun_run(void *cookie)
+{
+	struct segrun *R = cookie;
+	const struct crypto_dae_seg *seg = R->seg;
+	unsigned long long i;
+
+	for (i = R->start; i < R->end; i++) {
+		unsigned char *c = R->sealed + crypto_dae_seg_offset(seg, i);
+		unsigned char *m = R->m + i*seg->segsize;
+
+		if (R->open)
+			R->ret |= crypto_dae_seg_open_segment(seg, m, c, i);
+		else
+			crypto_dae_seg_seal_segment(seg, c, m, i);
+	}
+
+	return NULL;
+}
+
+static int
+segrun_all(const struct crypto_dae_seg *seg, unsigned char *m,
+    unsigned char *sealed, int open, unsigned nthreads)
+{
+	struct segrun R[SEG_MAXTHREADS];
+	unsigned i;
+	int ret = 0;
+
+	if (nthreads > SEG_MAXTHREADS)
+		nthreads = SEG_MAXTHREADS;
+	if (nthreads > seg->nseg)
+		nthreads = seg->nseg;
+	if (nthreads == 0)
+		nthreads = 1;
+
+	for (i = 0; i < nthreads; i++) {
+		memset(&R[i], 0, sizeof R[i]);
+		R[i].seg = seg;
+		R[i].m = m;
+		R[i].sealed = sealed;
+		R[i].start = seg->nseg*i/nthreads;
+		R[i].end = seg->nseg*(i + 1)/nthreads;
+		R[i].open = open;
+	}
+
+	/* Run 1..n-1 on new threads, 0 on this one.  */
+	for (i = 1; i < nthreads; i++) {
+		R[i].running =
+		    pthread_create(&R[i].thread, NULL, segrun_run, &R[i]) == 0;
+		if (!R[i].running)
+			(void)segrun_run(&R[i]);
+	}
+	(void)segrun_run(&R[0]);
+	for (i = 0; i < nthreads; i++) {
+		if (R[i].running)
+			(void)pthread_join(R[i].thread, NULL);
+		ret |= R[i].ret;
+	}
+
+	return ret;
+}
+
+void
+crypto_dae_seg_seal(const struct crypto_dae_seg *seg, unsigned char *sealed,
+    const unsigned char *m, unsigned nthreads)
+{
+
+	crypto_dae_seg_index(seg, sealed);
+	(void)segrun_all(seg, (unsigned char *)(uintptr_t)m, sealed, 0,
+	    nthreads);
+}
+
+int
+crypto_dae_seg_open(const struct crypto_dae_seg *seg, unsigned char *m,
+    const unsigned char *sealed, unsigned nthreads)
+{
+
+	if (segrun_all(seg, m, (unsigned char *)(uintptr_t)sealed, 1,
+		nthreads)) {
+		explicit_memset(m, 0, seg->len);
+		return -1;
+	}
+	return 0;
+}
+
+int
+crypto_dae_seg_read_range(const struct crypto_dae_seg *seg,
+    unsigned char *buf, unsigned long long off, size_t n,
+    const unsigned char *sealed)
+{
+	unsigned char *scratch = NULL;
+	unsigned long long i, last, segoff, seglen, lo, hi;
+	int ret = -1;
+
+	if (off > seg->len || n > seg->len - off)
+		return -1;
+	if (n == 0)
+		return 0;
+
+	last = (off + n - 1)/seg->segsize;
+	for (i = off/seg->segsize; i <= last; i++) {
+		const unsigned char *c = sealed + crypto_dae_seg_offset(seg, i);
+
+		segoff = i*seg->segsize;
+		seglen = crypto_dae_seg_seglen(seg, i);
+		lo = (off > segoff ? off - segoff : 0);
+		hi = (off + n < segoff + seglen ? off + n - segoff : seglen);
+
+		/*
+		 * A whole segment can be opened right into buf; a
+		 * partial one must be opened in full before any of it
+		 * can be trusted, so open it into scratch space.
+		 */
+		if (lo == 0 && hi == seglen) {
+			if (crypto_dae_seg_open_segment(seg,
+				buf + (segoff - off), c, i))
+				goto fail;
+			continue;
+		}
+		if (scratch == NULL &&
+		    (scratch = malloc(seg->segsize)) == NULL)
+			goto out;
+		if (crypto_dae_seg_open_segment(seg, scratch, c, i))
+			goto fail;
+		memcpy(buf + (segoff + lo - off), scratch + lo, hi - lo);
+	}
+	ret = 0;
+	goto out;
+
+fail:	explicit_memset(buf, 0, n);
+out:	if (scratch) {
+		explicit_memset(scratch, 0, seg->segsize);
+		free(scratch);
+	}
+	return ret;
+}
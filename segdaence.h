@@ -0,0 +1,147 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SEGDAENCE_H
+#define	SEGDAENCE_H
+
+#include <stddef.h>
+
+#include "chachadaence.h"
+
+/*
+ * Segmented objects: a large plaintext of len bytes is cut into
+ * segments of segsize bytes each (the last may be shorter), and each
+ * segment is sealed separately with ChaCha-Daence under a header that
+ * binds the object id, the object length, the segment size, the segment
+ * count, and the segment's index.  A short sealed index block in front
+ * records the length and segment size.  A reader can then open any
+ * byte range by opening only the segments it covers, and trusts each
+ * byte as soon as its segment is authenticated, rather than after the
+ * whole object.
+ *
+ * The sealed object is laid out as
+ *
+ *	index (crypto_dae_seg_INDEXBYTES) || c_0 || c_1 || ... || c_{n-1},
+ *
+ * where c_i is the 24-byte tag and ciphertext of segment i, at offset
+ * crypto_dae_seg_offset(seg, i).  Segments cannot be reordered, dropped,
+ * truncated, or moved between objects with different ids without
+ * detection.  Daence is deterministic, so sealing the same id and
+ * plaintext twice gives the same bytes; use a new id for each version
+ * of an object if readers must not be fooled into accepting a stale
+ * version, or mixing segments of two versions, under the same id.
+ */
+
+#define	crypto_dae_seg_IDBYTES		32u
+#define	crypto_dae_seg_INDEXBYTES	(24u + 32u)
+
+struct crypto_dae_seg {
+	const struct crypto_dae_chachadaence_ctx *ctx;
+	unsigned char		id[crypto_dae_seg_IDBYTES];
+	unsigned long long	len;		/* plaintext bytes */
+	unsigned long long	segsize;	/* plaintext bytes per segment */
+	unsigned long long	nseg;		/* number of segments */
+};
+
+/*
+ * Set up for writing an object of len bytes in segments of segsize
+ * bytes, a nonzero multiple of 64 up to 2^38.  Returns 0 on success,
+ * or -1 if segsize is unacceptable or the sealed object would not fit
+ * in an unsigned long long.  The seg refers to ctx, which must outlive
+ * it, and holds no secrets of its own.
+ */
+int crypto_dae_seg_init(struct crypto_dae_seg *,
+    const unsigned char[static crypto_dae_seg_IDBYTES],
+    unsigned long long /*len*/, unsigned long long /*segsize*/,
+    const struct crypto_dae_chachadaence_ctx *);
+
+/*
+ * Set up for reading: open the sealed index block of the object with
+ * the given id.  Returns 0 on success, or -1 if it is a forgery or was
+ * made for another id.
+ */
+int crypto_dae_seg_open_index(struct crypto_dae_seg *,
+    const unsigned char[static crypto_dae_seg_INDEXBYTES],
+    const unsigned char[static crypto_dae_seg_IDBYTES],
+    const struct crypto_dae_chachadaence_ctx *);
+
+/* Write the sealed index block.  */
+void crypto_dae_seg_index(const struct crypto_dae_seg *,
+    unsigned char[static crypto_dae_seg_INDEXBYTES]);
+
+/*
+ * Geometry: total size of the sealed object, plaintext length of
+ * segment i, and offset of sealed segment i in the sealed object.
+ */
+unsigned long long crypto_dae_seg_sealedlen(const struct crypto_dae_seg *);
+unsigned long long crypto_dae_seg_seglen(const struct crypto_dae_seg *,
+    unsigned long long);
+unsigned long long crypto_dae_seg_offset(const struct crypto_dae_seg *,
+    unsigned long long);
+
+/*
+ * One segment at a time: c[0..24 + seglen(i)] is sealed segment i, and
+ * m[0..seglen(i)] its plaintext.  _open_segment and _verify_segment
+ * return 0 if the segment is authentic, or -1 if it is a forgery or i
+ * is out of range; on forgery _open_segment zeroes m.
+ */
+void crypto_dae_seg_seal_segment(const struct crypto_dae_seg *,
+    unsigned char */*c*/, const unsigned char */*m*/, unsigned long long);
+
+int crypto_dae_seg_open_segment(const struct crypto_dae_seg *,
+    unsigned char */*m*/, const unsigned char */*c*/, unsigned long long);
+
+int crypto_dae_seg_verify_segment(const struct crypto_dae_seg *,
+    const unsigned char */*c*/, unsigned long long);
+
+/*
+ * Whole objects, with the segments spread over up to nthreads threads
+ * including the calling thread.  _seal writes the index and every
+ * segment to sealed[0..sealedlen], given m[0..len].  _open opens every
+ * segment of sealed[0..sealedlen] into m[0..len], after the seg has
+ * been set up with crypto_dae_seg_open_index; it returns 0 if all are
+ * authentic, or -1 with m zeroed if any is a forgery.
+ */
+void crypto_dae_seg_seal(const struct crypto_dae_seg *,
+    unsigned char */*sealed*/, const unsigned char */*m*/,
+    unsigned /*nthreads*/);
+
+int crypto_dae_seg_open(const struct crypto_dae_seg *,
+    unsigned char */*m*/, const unsigned char */*sealed*/,
+    unsigned /*nthreads*/);
+
+/*
+ * Random access: set buf[0..n] to bytes off..off+n of the plaintext,
+ * opening only the segments that cover them, from the sealed object
+ * at sealed, e.g. a mapped file.  Returns 0 on success, or -1 if the
+ * range is out of bounds, a segment is a forgery (in which case buf is
+ * zeroed), or there is no memory for a partly covered segment.
+ */
+int crypto_dae_seg_read_range(const struct crypto_dae_seg *,
+    unsigned char */*buf*/, unsigned long long /*off*/, size_t /*n*/,
+    const unsigned char */*sealed*/);
+
+#endif	/* SEGDAENCE_H */
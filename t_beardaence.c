@@ -24,13 +24,68 @@
  * SUCH DAMAGE.
  */
 
+#include <string.h>
+
 #include "beardaence.h"
 
+/*
+ * The automatically chosen pair must agree with the portable one, in
+ * both directions.  poly1305x2 passes its own tests, so it must be the
+ * Poly1305 chosen, reported as null.
+ */
+static int
+auto_test(void)
+{
+	unsigned char k[64], a[19], m[1000], c[sizeof m], d[sizeof m];
+	unsigned char t[24], u[24];
+	br_chacha20_run ichacha;
+	br_poly1305_run ipoly1305;
+	size_t i;
+
+	br_chachadaence_auto_get(&ichacha, &ipoly1305);
+	if (ichacha == 0 || ipoly1305 != 0)
+		return -1;
+	if (br_chacha20_sse2_get() && ichacha == br_chacha20_ct_run)
+		return -1;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = i;
+	for (i = 0; i < sizeof a; i++)
+		a[i] = 0x40 + i;
+	for (i = 0; i < sizeof m; i++)
+		m[i] = i*7;
+
+	memcpy(c, m, sizeof m);
+	br_chachadaence_encrypt_auto(k, c, sizeof c, a, sizeof a, t);
+	memcpy(d, m, sizeof m);
+	br_chachadaence_encrypt(k, d, sizeof d, a, sizeof a, u,
+	    br_chacha20_ct_run, br_poly1305_ctmul_run);
+	if (memcmp(c, d, sizeof c) || memcmp(t, u, sizeof t))
+		return -1;
+
+	if (!br_chachadaence_decrypt_auto(k, c, sizeof c, a, sizeof a, t))
+		return -1;
+	if (memcmp(c, m, sizeof m))
+		return -1;
+
+	memcpy(c, d, sizeof d);
+	c[500] ^= 1;
+	if (br_chachadaence_decrypt_auto(k, c, sizeof c, a, sizeof a, t))
+		return -1;
+
+	return 0;
+}
+
 int
 main(void)
 {
 	br_chacha20_run ichacha = br_chacha20_ct_run;
 	br_poly1305_run ipoly1305 = br_poly1305_ctmul_run;
 
-	return br_chachadaence_selftest(ichacha, ipoly1305);
+	if (br_chachadaence_selftest(ichacha, ipoly1305))
+		return 1;
+	if (auto_test())
+		return 1;
+
+	return 0;
 }
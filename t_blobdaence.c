@@ -0,0 +1,453 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#define	_POSIX_C_SOURCE	200809L
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "blobdaence.h"
+#include "chachadaence.h"
+
+#define	NBLOBS	3000		/* enough to grow the index twice */
+#define	PACKMAX	65536		/* small, to use many packfiles */
+#define	GROWAT	768		/* blobs at which a new store first grows */
+
+static const char dirtemplate[] = "/tmp/t_blobdaence.XXXXXX";
+static char dir[sizeof dirtemplate];
+static char path[sizeof dir + 32];
+
+static const char *
+file(const char *name)
+{
+
+	snprintf(path, sizeof path, "%s/%s", dir, name);
+	return path;
+}
+
+static void
+cleanup(void)
+{
+	char name[32];
+	unsigned i;
+
+	(void)unlink(file("index"));
+	(void)unlink(file("index.tmp"));
+	(void)rmdir(file("index.tmp"));
+	(void)unlink(file("index.old"));
+	for (i = 0; i < 10000; i++) {
+		snprintf(name, sizeof name, "pack-%06u", i);
+		if (unlink(file(name)) == -1 && errno == ENOENT)
+			break;
+	}
+	(void)rmdir(dir);
+}
+
+static int
+copy(const char *from, const char *to)
+{
+	char buf[4096];
+	ssize_t n;
+	int in, out, ret = -1;
+
+	if ((in = open(file(from), O_RDONLY)) == -1)
+		return -1;
+	if ((out = open(file(to), O_WRONLY|O_CREAT|O_TRUNC, 0600)) == -1)
+		goto out;
+	while ((n = read(in, buf, sizeof buf)) > 0) {
+		if (write(out, buf, n) != n)
+			goto out;
+	}
+	ret = (n == 0 ? 0 : -1);
+
+out:	if (out != -1)
+		(void)close(out);
+	(void)close(in);
+	return ret;
+}
+
+/* Blob j: (header, payload) of a length depending on j.  */
+static unsigned long long
+blob(unsigned char *m, unsigned char a[static 8], unsigned j)
+{
+	unsigned long long mlen = (j*37) % 700, i;
+
+	for (i = 0; i < mlen; i++)
+		m[i] = i ^ j ^ (j >> 8);
+	for (i = 0; i < 8; i++)
+		a[i] = j >> (8*i);
+	return mlen;
+}
+
+/*
+ * Check that every blob j in [lo, hi) can be found by its tag and comes
+ * back intact, and only with the right header.
+ */
+static int
+check(struct crypto_dae_blob *B, unsigned char (*tags)[24], unsigned lo,
+    unsigned hi)
+{
+	unsigned char m[700], m_[700], a[8];
+	unsigned long long mlen, mlen_;
+	unsigned j;
+
+	for (j = lo; j < hi; j++) {
+		mlen = blob(m, a, j);
+		if (crypto_dae_blob_size(B, tags[j], &mlen_) || mlen_ != mlen)
+			return -1;
+		if (crypto_dae_blob_get(B, m_, tags[j], a, 8) ||
+		    memcmp(m, m_, mlen))
+			return -1;
+		if (j % 97 == 0) {
+			a[0] ^= 1;
+			if (crypto_dae_blob_get(B, m_, tags[j], a, 8) == 0 ||
+			    errno != EBADMSG)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+static int
+blob_test(const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	static unsigned char tags[NBLOBS][24];
+	unsigned char m[700], a[8], t[24], junk[40] = {0}, ihdr[64];
+	char pack[sizeof dir + 32];
+	struct crypto_dae_blob *B;
+	struct crypto_dae_blob_stats S, S2;
+	struct stat st;
+	unsigned long long mlen;
+	off_t off;
+	ssize_t n;
+	unsigned j;
+	int fd;
+
+	/* Put every blob twice: the second copy is a duplicate.  */
+	if ((B = crypto_dae_blob_open(dir, PACKMAX, ctx)) == NULL)
+		return -1;
+	for (j = 0; j < NBLOBS; j++) {
+		mlen = blob(m, a, j);
+		if (crypto_dae_blob_put(B, tags[j], m, mlen, a, 8) != 1)
+			return -1;
+		if (crypto_dae_blob_put(B, t, m, mlen, a, 8) != 0 ||
+		    memcmp(t, tags[j], 24))
+			return -1;
+		crypto_dae_chachadaence_ctx_encrypt_detached(m, t, m, mlen,
+		    a, 8, ctx);
+		if (memcmp(t, tags[j], 24))
+			return -1;
+	}
+	crypto_dae_blob_stats(B, &S);
+	if (S.nblobs != NBLOBS || S.puts != 2*NBLOBS || S.dups != NBLOBS ||
+	    S.npacks < 2 || S.bytes_stored != S.bytes_in/2 + 32*NBLOBS)
+		return -1;
+	if (crypto_dae_blob_size(B, junk, &mlen) == 0 || errno != ENOENT)
+		return -1;
+	if (check(B, tags, 0, NBLOBS))
+		return -1;
+	if (crypto_dae_blob_close(B))
+		return -1;
+
+	/* Reopen: everything is still there, and still deduplicated.  */
+	if ((B = crypto_dae_blob_open(dir, PACKMAX, ctx)) == NULL)
+		return -1;
+	crypto_dae_blob_stats(B, &S);
+	if (S.nblobs != NBLOBS || check(B, tags, 0, NBLOBS))
+		return -1;
+	mlen = blob(m, a, 5);
+	if (crypto_dae_blob_put(B, t, m, mlen, a, 8) != 0)
+		return -1;
+	if (crypto_dae_blob_close(B))
+		return -1;
+
+	/* Lose the index: it is rebuilt from the packfiles.  */
+	if (unlink(file("index")) == -1)
+		return -1;
+	if ((B = crypto_dae_blob_open(dir, PACKMAX, ctx)) == NULL)
+		return -1;
+	crypto_dae_blob_stats(B, &S);
+	if (S.nblobs != NBLOBS || check(B, tags, 0, NBLOBS))
+		return -1;
+	if (crypto_dae_blob_close(B))
+		return -1;
+
+	/*
+	 * Crash after appending but before indexing: put a blob, then
+	 * put back the old index.  Then tear a record onto the end of
+	 * the last packfile.  Reopening finds the first and cuts off
+	 * the second.
+	 */
+	if (copy("index", "index.old"))
+		return -1;
+	if ((B = crypto_dae_blob_open(dir, PACKMAX, ctx)) == NULL)
+		return -1;
+	mlen = blob(m, a, NBLOBS);
+	if (crypto_dae_blob_put(B, t, m, mlen, a, 8) != 1)
+		return -1;
+	crypto_dae_blob_stats(B, &S);
+	snprintf(path, sizeof path, "%s/pack-%06llu", dir, S.npacks - 1);
+	if (crypto_dae_blob_close(B))
+		return -1;
+	if ((fd = open(path, O_WRONLY|O_APPEND)) == -1)
+		return -1;
+	junk[0] = 100;		/* claims 100 bytes, has 8 */
+	if (write(fd, junk, sizeof junk) != sizeof junk)
+		return -1;
+	(void)close(fd);
+	if (copy("index.old", "index"))
+		return -1;
+	if ((B = crypto_dae_blob_open(dir, PACKMAX, ctx)) == NULL)
+		return -1;
+	crypto_dae_blob_stats(B, &S);
+	if (S.nblobs != NBLOBS + 1 || check(B, tags, 0, NBLOBS))
+		return -1;
+	if (crypto_dae_blob_get(B, m, t, a, 8))
+		return -1;
+	mlen = blob(m, a, NBLOBS + 1);
+	if (crypto_dae_blob_put(B, t, m, mlen, a, 8) != 1)
+		return -1;
+	if (crypto_dae_blob_get(B, m, t, a, 8))
+		return -1;
+	if (crypto_dae_blob_close(B))
+		return -1;
+
+	/*
+	 * Crash with a slot written back but not its record: put a
+	 * blob, then put back the old index header and cut the record
+	 * off its packfile.  Reopening finds the slot out and rebuilds.
+	 */
+	if ((fd = open(file("index"), O_RDONLY)) == -1 ||
+	    pread(fd, ihdr, sizeof ihdr, 0) != sizeof ihdr)
+		return -1;
+	(void)close(fd);
+	if ((B = crypto_dae_blob_open(dir, PACKMAX, ctx)) == NULL)
+		return -1;
+	crypto_dae_blob_stats(B, &S);
+	snprintf(pack, sizeof pack, "%s/pack-%06llu", dir, S.npacks - 1);
+	if (stat(pack, &st) == -1)
+		return -1;
+	mlen = blob(m, a, NBLOBS + 2);
+	if (crypto_dae_blob_put(B, t, m, mlen, a, 8) != 1)
+		return -1;
+	crypto_dae_blob_stats(B, &S2);
+	if (S2.npacks != S.npacks) {
+		snprintf(pack, sizeof pack, "%s/pack-%06llu", dir,
+		    S2.npacks - 1);
+		st.st_size = 0;
+	}
+	if (crypto_dae_blob_close(B))
+		return -1;
+	if (truncate(pack, st.st_size) == -1)
+		return -1;
+	if ((fd = open(file("index"), O_WRONLY)) == -1 ||
+	    pwrite(fd, ihdr, sizeof ihdr, 0) != sizeof ihdr)
+		return -1;
+	(void)close(fd);
+	if ((B = crypto_dae_blob_open(dir, PACKMAX, ctx)) == NULL)
+		return -1;
+	crypto_dae_blob_stats(B, &S);
+	if (S.nblobs != NBLOBS + 2 || check(B, tags, 0, NBLOBS))
+		return -1;
+	if (crypto_dae_blob_size(B, t, &mlen) == 0 || errno != ENOENT)
+		return -1;
+	if (crypto_dae_blob_close(B))
+		return -1;
+
+	/* Every slot taken: nothing may spin, and it is rebuilt.  */
+	if ((fd = open(file("index"), O_WRONLY)) == -1 || fstat(fd, &st))
+		return -1;
+	memset(m, 0xff, sizeof m);
+	for (off = sizeof ihdr; off < st.st_size; off += n) {
+		n = st.st_size - off < (off_t)sizeof m ?
+		    st.st_size - off : (off_t)sizeof m;
+		if (pwrite(fd, m, n, off) != n)
+			return -1;
+	}
+	(void)close(fd);
+	if ((B = crypto_dae_blob_open(dir, PACKMAX, ctx)) == NULL)
+		return -1;
+	crypto_dae_blob_stats(B, &S);
+	if (S.nblobs != NBLOBS + 2 || check(B, tags, 0, NBLOBS))
+		return -1;
+	if (crypto_dae_blob_close(B))
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Fail to grow the index on the put that crosses 3/4 load, by putting
+ * a directory where the new index would go; then put some more blobs
+ * and crash without syncing or closing.  The failed blob must be gone
+ * without a trace, and the index must agree with one rebuilt from the
+ * packfiles.
+ */
+static int
+grow_test(const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	static unsigned char tags[GROWAT + 32][24];
+	unsigned char m[700], a[8], t[24];
+	struct crypto_dae_blob *B;
+	struct crypto_dae_blob_stats S;
+	unsigned long long mlen;
+	unsigned j;
+	pid_t pid;
+	int status;
+
+	for (j = 0; j < GROWAT + 32; j++) {
+		mlen = blob(m, a, j);
+		crypto_dae_chachadaence_ctx_tag(tags[j], m, mlen, a, 8, ctx);
+	}
+
+	if ((pid = fork()) == -1)
+		return -1;
+	if (pid == 0) {
+		if ((B = crypto_dae_blob_open(dir, PACKMAX, ctx)) == NULL)
+			_exit(1);
+		for (j = 0; j < GROWAT; j++) {
+			mlen = blob(m, a, j);
+			if (crypto_dae_blob_put(B, t, m, mlen, a, 8) != 1)
+				_exit(1);
+		}
+		if (mkdir(file("index.tmp"), 0700) == -1)
+			_exit(1);
+		mlen = blob(m, a, GROWAT);
+		if (crypto_dae_blob_put(B, t, m, mlen, a, 8) != -1)
+			_exit(1);
+		if (rmdir(file("index.tmp")) == -1)
+			_exit(1);
+		for (j = GROWAT + 1; j < GROWAT + 32; j++) {
+			mlen = blob(m, a, j);
+			if (crypto_dae_blob_put(B, t, m, mlen, a, 8) != 1)
+				_exit(1);
+		}
+		_exit(0);	/* crash */
+	}
+	if (waitpid(pid, &status, 0) == -1 ||
+	    !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		return -1;
+
+	/* Once from the index as the crash left it, once rebuilt.  */
+	for (j = 0; j < 2; j++) {
+		if ((B = crypto_dae_blob_open(dir, PACKMAX, ctx)) == NULL)
+			return -1;
+		crypto_dae_blob_stats(B, &S);
+		if (S.nblobs != GROWAT + 31 || check(B, tags, 0, GROWAT) ||
+		    check(B, tags, GROWAT + 1, GROWAT + 32))
+			return -1;
+		if (crypto_dae_blob_size(B, tags[GROWAT], &mlen) == 0 ||
+		    errno != ENOENT)
+			return -1;
+		if (crypto_dae_blob_close(B))
+			return -1;
+		if (unlink(file("index")) == -1)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Check that a blob bigger than packmax gets a packfile to itself and
+ * the next one starts another.
+ */
+static int
+big_test(const struct crypto_dae_chachadaence_ctx *ctx)
+{
+	static unsigned char m[PACKMAX + 1000], m_[sizeof m];
+	unsigned char a[8] = {0}, t[2][24];
+	struct crypto_dae_blob *B;
+	struct crypto_dae_blob_stats S;
+	unsigned long long i;
+	int ret = -1;
+
+	for (i = 0; i < sizeof m; i++)
+		m[i] = i*7 ^ (i >> 9);
+	if ((B = crypto_dae_blob_open(dir, PACKMAX, ctx)) == NULL)
+		return -1;
+	if (crypto_dae_blob_put(B, t[0], m, sizeof m, a, 8) != 1)
+		goto out;
+	crypto_dae_blob_stats(B, &S);
+	if (S.npacks != 1)
+		goto out;
+	if (crypto_dae_blob_put(B, t[1], m, 100, a, 8) != 1)
+		goto out;
+	crypto_dae_blob_stats(B, &S);
+	if (S.npacks != 2)
+		goto out;
+	if (crypto_dae_blob_get(B, m_, t[0], a, 8) ||
+	    memcmp(m, m_, sizeof m) ||
+	    crypto_dae_blob_get(B, m_, t[1], a, 8) ||
+	    memcmp(m, m_, 100))
+		goto out;
+	ret = 0;
+
+out:	if (crypto_dae_blob_close(B))
+		ret = -1;
+	return ret;
+}
+
+int
+main(void)
+{
+	struct crypto_dae_chachadaence_ctx ctx;
+	unsigned char k[64];
+	unsigned i;
+	int ret;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = 11*i;
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+	memcpy(dir, dirtemplate, sizeof dir);
+	if (mkdtemp(dir) == NULL)
+		return 1;
+	ret = blob_test(&ctx);
+	cleanup();
+	if (ret == 0) {
+		memcpy(dir, dirtemplate, sizeof dir);
+		if (mkdtemp(dir) == NULL)
+			return 1;
+		ret = grow_test(&ctx);
+		cleanup();
+	}
+	if (ret == 0) {
+		memcpy(dir, dirtemplate, sizeof dir);
+		if (mkdtemp(dir) == NULL)
+			return 1;
+		ret = big_test(&ctx);
+		cleanup();
+	}
+	crypto_dae_chachadaence_ctx_destroy(&ctx);
+	return ret ? 1 : 0;
+}
@@ -26,13 +26,373 @@
 
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "chachadaence.h"
 
+/*
+ * Cut buf[0..len] into at most 8 segments of irregular, possibly zero,
+ * lengths; return the number of segments.
+ */
+static int
+split(struct iovec iov[static 8], unsigned char *buf, size_t len,
+    unsigned *seed)
+{
+	size_t n;
+	int i = 0;
+
+	while (i < 7 && len) {
+		*seed = *seed*1103515245 + 12345;
+		n = (*seed >> 16) % (len < 130 ? len + 1 : 130);
+		iov[i].iov_base = buf;
+		iov[i].iov_len = n;
+		buf += n;
+		len -= n;
+		i++;
+	}
+	iov[i].iov_base = buf;
+	iov[i].iov_len = len;
+
+	return i + 1;
+}
+
+/*
+ * Check that the scatter/gather calls agree with the contiguous ones,
+ * out of place and in place, however the segments fall.
+ */
+static int
+iov_test(void)
+{
+	static const unsigned long long mlens[] = {
+		0, 1, 63, 64, 65, 200, 1000, 3000,
+	};
+	static const unsigned long long alens[] = { 0, 17, 100 };
+	static unsigned char k[64], a[100], m[3000];
+	static unsigned char c0[24 + sizeof m], c1[24 + sizeof m];
+	static unsigned char m1[sizeof m];
+	struct iovec av[8], mv[8], cv[9], m1v[8];
+	int avcnt, mvcnt, cvcnt, m1vcnt;
+	unsigned long long mlen, alen, i;
+	unsigned seed = 1, trial, mi, ai;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = i;
+	for (i = 0; i < sizeof a; i++)
+		a[i] = 0x40 + i;
+	for (i = 0; i < sizeof m; i++)
+		m[i] = i*7;
+
+	for (mi = 0; mi < sizeof mlens/sizeof mlens[0]; mi++) {
+		for (ai = 0; ai < sizeof alens/sizeof alens[0]; ai++) {
+			for (trial = 0; trial < 8; trial++) {
+				mlen = mlens[mi];
+				alen = alens[ai];
+				crypto_dae_chachadaence(c0, m, mlen, a, alen, k);
+
+				avcnt = split(av, a, alen, &seed);
+				mvcnt = split(mv, m, mlen, &seed);
+				cvcnt = split(cv, c1, 24 + mlen, &seed);
+				memset(c1, 0xa5, sizeof c1);
+				if (crypto_dae_chachadaence_encryptv(cv, cvcnt,
+					mv, mvcnt, av, avcnt, k))
+					return -1;
+				if (memcmp(c1, c0, 24 + mlen))
+					return -1;
+
+				cvcnt = split(cv, c1, 24 + mlen, &seed);
+				m1vcnt = split(m1v, m1, mlen, &seed);
+				memset(m1, 0x5a, sizeof m1);
+				if (crypto_dae_chachadaence_openv(m1v, m1vcnt,
+					cv, cvcnt, av, avcnt, k))
+					return -1;
+				if (memcmp(m1, m, mlen))
+					return -1;
+
+				/* In place: tag, then the m1 segments.  */
+				memcpy(m1, m, mlen);
+				cv[0].iov_base = c1;
+				cv[0].iov_len = 24;
+				memcpy(cv + 1, m1v, m1vcnt*sizeof m1v[0]);
+				if (crypto_dae_chachadaence_encryptv(cv,
+					1 + m1vcnt, m1v, m1vcnt, av, avcnt, k))
+					return -1;
+				if (memcmp(c1, c0, 24) ||
+				    memcmp(m1, c0 + 24, mlen))
+					return -1;
+				if (crypto_dae_chachadaence_openv(m1v, m1vcnt,
+					cv, 1 + m1vcnt, av, avcnt, k))
+					return -1;
+				if (memcmp(m1, m, mlen))
+					return -1;
+
+				/* Forgery, and mismatched lengths.  */
+				memcpy(c1, c0, 24 + mlen);
+				c1[(trial*7) % (24 + mlen)] ^= 1;
+				cvcnt = split(cv, c1, 24 + mlen, &seed);
+				if (crypto_dae_chachadaence_openv(m1v, m1vcnt,
+					cv, cvcnt, av, avcnt, k) == 0)
+					return -1;
+				for (i = 0; i < mlen; i++) {
+					if (m1[i])
+						return -1;
+				}
+				cvcnt = split(cv, c1, 23 + mlen, &seed);
+				if (crypto_dae_chachadaence_encryptv(cv, cvcnt,
+					mv, mvcnt, av, avcnt, k) == 0)
+					return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Check that splitting a message across threads gives the same answer
+ * as processing it in one piece, for a few awkward lengths.
+ */
+static int
+parallel_test(void)
+{
+	static const unsigned long long lens[] = {
+		0, 1, 65536, 4*65536 + 1, 1048576 + 13, 3*1048576 + 64,
+	};
+	static unsigned char k[64], a[19];
+	struct crypto_dae_chachadaence_ctx ctx;
+	unsigned char *m, *c0, *c1, *m1;
+	unsigned long long mlen, i;
+	unsigned j, nthreads;
+	int ret = -1;
+
+	m = malloc(3*1048576 + 64);
+	c0 = malloc(3*1048576 + 64 + 24);
+	c1 = malloc(3*1048576 + 64 + 24);
+	m1 = malloc(3*1048576 + 64);
+	if (m == NULL || c0 == NULL || c1 == NULL || m1 == NULL)
+		goto out;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = i;
+	for (i = 0; i < sizeof a; i++)
+		a[i] = 0x40 + i;
+	for (i = 0; i < 3*1048576 + 64; i++)
+		m[i] = i*i + 7;
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+
+	for (j = 0; j < sizeof lens/sizeof lens[0]; j++) {
+		mlen = lens[j];
+		crypto_dae_chachadaence_ctx_encrypt(c0, m, mlen, a, sizeof a,
+		    &ctx);
+		for (nthreads = 1; nthreads <= 5; nthreads++) {
+			memset(c1, 0xa5, mlen + 24);
+			memset(m1, 0x5a, mlen);
+			crypto_dae_chachadaence_ctx_parallel(c1, m, mlen,
+			    a, sizeof a, &ctx, nthreads);
+			if (memcmp(c0, c1, mlen + 24) != 0)
+				goto out;
+			if (crypto_dae_chachadaence_ctx_open_parallel(m1, c1,
+				mlen, a, sizeof a, &ctx, nthreads))
+				goto out;
+			if (memcmp(m, m1, mlen) != 0)
+				goto out;
+			c1[mlen ? 24 + mlen/2 : 0] ^= 0x10;
+			if (crypto_dae_chachadaence_ctx_open_parallel(m1, c1,
+				mlen, a, sizeof a, &ctx, nthreads) == 0)
+				goto out;
+		}
+	}
+	ret = 0;
+
+out:	crypto_dae_chachadaence_ctx_destroy(&ctx);
+	free(m1);
+	free(c1);
+	free(c0);
+	free(m);
+	return ret;
+}
+
+/*
+ * Check that the detached-tag calls agree with the combined ones, both
+ * with separate buffers and in place.
+ */
+static int
+detached_test(void)
+{
+	static const unsigned long long mlens[] = {
+		0, 1, 63, 64, 65, 1000, 70000,
+	};
+	static unsigned char k[64], a[33], m[70000];
+	static unsigned char c0[24 + sizeof m], c1[sizeof m], m1[sizeof m];
+	unsigned char t[24];
+	unsigned long long mlen, i;
+	unsigned mi;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = 3*i;
+	for (i = 0; i < sizeof a; i++)
+		a[i] = 0x40 + i;
+	for (i = 0; i < sizeof m; i++)
+		m[i] = i*7 + (i >> 8);
+
+	for (mi = 0; mi < sizeof mlens/sizeof mlens[0]; mi++) {
+		mlen = mlens[mi];
+		crypto_dae_chachadaence(c0, m, mlen, a, sizeof a, k);
+
+		crypto_dae_chachadaence_detached(c1, t, m, mlen, a, sizeof a, k);
+		if (memcmp(t, c0, 24) || memcmp(c1, c0 + 24, mlen))
+			return -1;
+		if (crypto_dae_chachadaence_open_detached(m1, c1, mlen, t,
+			a, sizeof a, k))
+			return -1;
+		if (memcmp(m1, m, mlen))
+			return -1;
+
+		/* In place.  */
+		memcpy(m1, m, mlen);
+		crypto_dae_chachadaence_detached(m1, t, m1, mlen, a, sizeof a, k);
+		if (memcmp(t, c0, 24) || memcmp(m1, c0 + 24, mlen))
+			return -1;
+		if (crypto_dae_chachadaence_open_detached(m1, m1, mlen, t,
+			a, sizeof a, k))
+			return -1;
+		if (memcmp(m1, m, mlen))
+			return -1;
+
+		/* Forgery: the buffer is zeroed.  */
+		memcpy(m1, c0 + 24, mlen);
+		t[mlen % 24] ^= 0x10;
+		if (crypto_dae_chachadaence_open_detached(m1, m1, mlen, t,
+			a, sizeof a, k) == 0)
+			return -1;
+		for (i = 0; i < mlen; i++) {
+			if (m1[i])
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Check that verifying without output agrees with opening, on genuine
+ * messages and on forgeries in the tag, the ciphertext, and the header.
+ */
+static int
+verify_test(void)
+{
+	static const unsigned long long mlens[] = {
+		0, 1, 4095, 4096, 4097, 70000,
+	};
+	static unsigned char k[64], a[33], m[70000];
+	static unsigned char c[24 + sizeof m];
+	unsigned long long mlen, i;
+	unsigned mi;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = 5*i;
+	for (i = 0; i < sizeof a; i++)
+		a[i] = 0x40 + i;
+	for (i = 0; i < sizeof m; i++)
+		m[i] = i*11 + (i >> 9);
+
+	for (mi = 0; mi < sizeof mlens/sizeof mlens[0]; mi++) {
+		mlen = mlens[mi];
+		crypto_dae_chachadaence(c, m, mlen, a, sizeof a, k);
+		if (crypto_dae_chachadaence_verify(c, mlen, a, sizeof a, k))
+			return -1;
+		if (crypto_dae_chachadaence_verify(c, mlen, a, sizeof a - 1, k) == 0)
+			return -1;
+		c[3] ^= 1;
+		if (crypto_dae_chachadaence_verify(c, mlen, a, sizeof a, k) == 0)
+			return -1;
+		c[3] ^= 1;
+		if (mlen) {
+			c[24 + mlen - 1] ^= 0x80;
+			if (crypto_dae_chachadaence_verify(c, mlen, a, sizeof a,
+				k) == 0)
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Check that the tag-only calls compute the same tag as sealing, one at
+ * a time and in a batch, and that the batch leaves the rest of c alone.
+ */
+static int
+tag_test(void)
+{
+	static const unsigned long long mlens[] = {
+		0, 1, 15, 16, 17, 63, 64, 65, 1000, 4096, 70000,
+	};
+	enum { N = sizeof mlens/sizeof mlens[0] };
+	static unsigned char k[64], a[33], m[70000];
+	static unsigned char c0[24 + sizeof m], c1[N][24 + 4];
+	struct crypto_dae_chachadaence_ctx ctx;
+	struct crypto_dae_chachadaence_batch b[N];
+	unsigned char t[24];
+	unsigned long long i;
+	unsigned mi;
+	int ret = -1;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = 7*i;
+	for (i = 0; i < sizeof a; i++)
+		a[i] = 0x40 + i;
+	for (i = 0; i < sizeof m; i++)
+		m[i] = i*13 + (i >> 7);
+
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+	for (mi = 0; mi < N; mi++) {
+		b[mi].c = c1[mi];
+		b[mi].m = m;
+		b[mi].mlen = mlens[mi];
+		b[mi].a = a;
+		b[mi].alen = mi % 2 ? sizeof a : mi;
+		memset(c1[mi], 0xa5, sizeof c1[mi]);
+	}
+	crypto_dae_chachadaence_ctx_tag_batch(b, N, &ctx);
+
+	for (mi = 0; mi < N; mi++) {
+		crypto_dae_chachadaence(c0, m, b[mi].mlen, a, b[mi].alen, k);
+		crypto_dae_chachadaence_tag(t, m, b[mi].mlen, a, b[mi].alen, k);
+		if (memcmp(t, c0, 24))
+			goto out;
+		crypto_dae_chachadaence_ctx_tag(t, m, b[mi].mlen, a,
+		    b[mi].alen, &ctx);
+		if (memcmp(t, c0, 24))
+			goto out;
+		if (memcmp(c1[mi], c0, 24))
+			goto out;
+		for (i = 24; i < sizeof c1[mi]; i++) {
+			if (c1[mi][i] != 0xa5)
+				goto out;
+		}
+	}
+	ret = 0;
+
+out:	crypto_dae_chachadaence_ctx_destroy(&ctx);
+	return ret;
+}
+
 int
 main(void)
 {
 
-	return crypto_dae_chachadaence_selftest();
+	if (crypto_dae_chachadaence_selftest())
+		return 1;
+	if (parallel_test())
+		return 1;
+	if (iov_test())
+		return 1;
+	if (detached_test())
+		return 1;
+	if (verify_test())
+		return 1;
+	if (tag_test())
+		return 1;
+	return 0;
 }
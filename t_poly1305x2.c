@@ -0,0 +1,172 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "crypto_onetimeauth_poly1305.h"
+#include "poly1305x2.h"
+
+void
+randombytes(unsigned char *p, unsigned long long n)
+{
+	static int fd = -1;
+	ssize_t nread;
+
+	if (fd == -1) {
+		if ((fd = open("/dev/urandom", O_RDONLY)) == -1)
+			abort();
+	}
+
+	while (n) {
+		nread = read(fd, p, n);
+		if (nread == -1 || nread == 0)
+			abort();
+		p += ((size_t)nread > n ? n : (size_t)nread);
+		n -= ((size_t)nread > n ? n : (size_t)nread);
+	}
+}
+
+/*
+ * Compare Poly1305^2 against two separate NaCl Poly1305 computations
+ * with zero addend, over every message length up to 1 KiB, feeding the
+ * input in irregular pieces -- once with each block function that
+ * poly1305x2_force_portable can select.
+ */
+int
+main(void)
+{
+	unsigned char k1[32] = {0}, k2[32] = {0};
+	unsigned char m[1024];
+	unsigned char h1[16], h2[16], e1[16], e2[16];
+	unsigned char st[POLY1305X2_STATEBYTES], st1[POLY1305X2_STATEBYTES];
+	struct poly1305x2_key K;
+	struct poly1305x2 P, Q;
+	unsigned long long mlen, i, n;
+	unsigned char step;
+	unsigned trial;
+
+	for (trial = 0; trial < 12; trial++) {
+		poly1305x2_force_portable(trial / 4);
+		randombytes(k1, 16);
+		randombytes(k2, 16);
+		randombytes(m, sizeof m);
+		if (trial % 4 == 0) {	/* exercise carries near p */
+			memset(m, 0xff, sizeof m);
+			memset(k1, 0xff, 16);
+		}
+		poly1305x2_setkey(&K, k1, k2);
+		for (mlen = 0; mlen <= sizeof m; mlen++) {
+			crypto_onetimeauth_poly1305(e1, m, mlen, k1);
+			crypto_onetimeauth_poly1305(e2, m, mlen, k2);
+
+			randombytes(&step, 1);
+			poly1305x2_init(&P, &K);
+			for (i = 0; i < mlen; i += n) {
+				n = (trial & 1) ? mlen - i :
+				    (unsigned long long)(1 + step++ % 151);
+				if (n > mlen - i)
+					n = mlen - i;
+				poly1305x2_update(&P, m + i, n);
+			}
+			poly1305x2_final(&P, h1, h2);
+
+			if (memcmp(h1, e1, 16) != 0)
+				return 1;
+			if (memcmp(h2, e2, 16) != 0)
+				return 1;
+
+			/* Same again, split at a block boundary.  */
+			poly1305x2_init(&P, &K);
+			poly1305x2_init(&Q, &K);
+			n = 16*((step % (mlen/16 + 1)));
+			poly1305x2_update(&P, m, n);
+			poly1305x2_update(&Q, m + n, (mlen - n) & ~15ull);
+			poly1305x2_combine(&P, &Q, (mlen - n)/16);
+			poly1305x2_final(&Q, h1, h2);
+			poly1305x2_update(&P, m + n + ((mlen - n) & ~15ull),
+			    (mlen - n) & 15);
+			poly1305x2_final(&P, h1, h2);
+
+			if (memcmp(h1, e1, 16) != 0)
+				return 1;
+			if (memcmp(h2, e2, 16) != 0)
+				return 1;
+
+			/* Same again, saving and restoring midway.  */
+			poly1305x2_init(&P, &K);
+			n = step % (mlen + 1);
+			poly1305x2_update(&P, m, n);
+			poly1305x2_export(&P, st);
+			memset(&P, 0xa5, sizeof P);
+			if (poly1305x2_import(&Q, &K, st))
+				return 1;
+			poly1305x2_update(&Q, m + n, mlen - n);
+			poly1305x2_final(&Q, h1, h2);
+
+			if (memcmp(h1, e1, 16) != 0)
+				return 1;
+			if (memcmp(h2, e2, 16) != 0)
+				return 1;
+		}
+	}
+
+	/*
+	 * Equal states must serialize alike, whatever stale input is
+	 * left past the partial block.
+	 */
+	poly1305x2_init(&P, &K);
+	poly1305x2_update(&P, m, 10);
+	poly1305x2_update(&P, m + 10, 10);
+	poly1305x2_export(&P, st);
+	poly1305x2_init(&Q, &K);
+	poly1305x2_update(&Q, m, 20);
+	poly1305x2_export(&Q, st1);
+	if (memcmp(st, st1, sizeof st) != 0)
+		return 1;
+	poly1305x2_clear(&P);
+	poly1305x2_clear(&Q);
+
+	/* Malformed states must be rejected.  */
+	poly1305x2_init(&P, &K);
+	poly1305x2_export(&P, st);
+	st[40] = 1;		/* past the empty partial block */
+	if (poly1305x2_import(&P, &K, st) == 0)
+		return 1;
+	st[40] = 0;
+	st[56] = 16;
+	if (poly1305x2_import(&P, &K, st) == 0)
+		return 1;
+	st[56] = 0;
+	st[63] = 1;
+	if (poly1305x2_import(&P, &K, st) == 0)
+		return 1;
+
+	poly1305x2_force_portable(0);
+	return 0;
+}
@@ -26,6 +26,7 @@
 
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "salsa20daence.h"
@@ -50,9 +51,491 @@ randombytes(unsigned char *p, unsigned long long n)
 	}
 }
 
+/*
+ * Cut buf[0..len] into at most 8 segments of irregular, possibly zero,
+ * lengths; return the number of segments.
+ */
+static int
+split(struct iovec iov[static 8], unsigned char *buf, size_t len,
+    unsigned *seed)
+{
+	size_t n;
+	int i = 0;
+
+	while (i < 7 && len) {
+		*seed = *seed*1103515245 + 12345;
+		n = (*seed >> 16) % (len < 130 ? len + 1 : 130);
+		iov[i].iov_base = buf;
+		iov[i].iov_len = n;
+		buf += n;
+		len -= n;
+		i++;
+	}
+	iov[i].iov_base = buf;
+	iov[i].iov_len = len;
+
+	return i + 1;
+}
+
+/*
+ * Check that the scatter/gather calls agree with the contiguous ones,
+ * out of place and in place, however the segments fall.
+ */
+static int
+iov_test(void)
+{
+	static const unsigned long long mlens[] = {
+		0, 1, 63, 64, 65, 200, 1000, 3000,
+	};
+	static const unsigned long long alens[] = { 0, 17, 100 };
+	static unsigned char k[96], a[100], m[3000];
+	static unsigned char c0[24 + sizeof m], c1[24 + sizeof m];
+	static unsigned char m1[sizeof m];
+	struct iovec av[8], mv[8], cv[9], m1v[8];
+	int avcnt, mvcnt, cvcnt, m1vcnt;
+	unsigned long long mlen, alen, i;
+	unsigned seed = 1, trial, mi, ai;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = i;
+	for (i = 0; i < sizeof a; i++)
+		a[i] = 0x40 + i;
+	for (i = 0; i < sizeof m; i++)
+		m[i] = i*7;
+
+	for (mi = 0; mi < sizeof mlens/sizeof mlens[0]; mi++) {
+		for (ai = 0; ai < sizeof alens/sizeof alens[0]; ai++) {
+			for (trial = 0; trial < 8; trial++) {
+				mlen = mlens[mi];
+				alen = alens[ai];
+				crypto_dae_salsa20daence(c0, m, mlen, a, alen, k);
+
+				avcnt = split(av, a, alen, &seed);
+				mvcnt = split(mv, m, mlen, &seed);
+				cvcnt = split(cv, c1, 24 + mlen, &seed);
+				memset(c1, 0xa5, sizeof c1);
+				if (crypto_dae_salsa20daence_encryptv(cv, cvcnt,
+					mv, mvcnt, av, avcnt, k))
+					return -1;
+				if (memcmp(c1, c0, 24 + mlen))
+					return -1;
+
+				cvcnt = split(cv, c1, 24 + mlen, &seed);
+				m1vcnt = split(m1v, m1, mlen, &seed);
+				memset(m1, 0x5a, sizeof m1);
+				if (crypto_dae_salsa20daence_openv(m1v, m1vcnt,
+					cv, cvcnt, av, avcnt, k))
+					return -1;
+				if (memcmp(m1, m, mlen))
+					return -1;
+
+				/* In place: tag, then the m1 segments.  */
+				memcpy(m1, m, mlen);
+				cv[0].iov_base = c1;
+				cv[0].iov_len = 24;
+				memcpy(cv + 1, m1v, m1vcnt*sizeof m1v[0]);
+				if (crypto_dae_salsa20daence_encryptv(cv,
+					1 + m1vcnt, m1v, m1vcnt, av, avcnt, k))
+					return -1;
+				if (memcmp(c1, c0, 24) ||
+				    memcmp(m1, c0 + 24, mlen))
+					return -1;
+				if (crypto_dae_salsa20daence_openv(m1v, m1vcnt,
+					cv, 1 + m1vcnt, av, avcnt, k))
+					return -1;
+				if (memcmp(m1, m, mlen))
+					return -1;
+
+				/* Forgery, and mismatched lengths.  */
+				memcpy(c1, c0, 24 + mlen);
+				c1[(trial*7) % (24 + mlen)] ^= 1;
+				cvcnt = split(cv, c1, 24 + mlen, &seed);
+				if (crypto_dae_salsa20daence_openv(m1v, m1vcnt,
+					cv, cvcnt, av, avcnt, k) == 0)
+					return -1;
+				for (i = 0; i < mlen; i++) {
+					if (m1[i])
+						return -1;
+				}
+				cvcnt = split(cv, c1, 23 + mlen, &seed);
+				if (crypto_dae_salsa20daence_encryptv(cv, cvcnt,
+					mv, mvcnt, av, avcnt, k) == 0)
+					return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Check that the detached-tag calls agree with the combined ones, both
+ * with separate buffers and in place.
+ */
+static int
+detached_test(void)
+{
+	static const unsigned long long mlens[] = {
+		0, 1, 63, 64, 65, 1000, 70000,
+	};
+	static unsigned char k[96], a[33], m[70000];
+	static unsigned char c0[24 + sizeof m], c1[sizeof m], m1[sizeof m];
+	unsigned char t[24];
+	unsigned long long mlen, i;
+	unsigned mi;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = 3*i;
+	for (i = 0; i < sizeof a; i++)
+		a[i] = 0x40 + i;
+	for (i = 0; i < sizeof m; i++)
+		m[i] = i*7 + (i >> 8);
+
+	for (mi = 0; mi < sizeof mlens/sizeof mlens[0]; mi++) {
+		mlen = mlens[mi];
+		crypto_dae_salsa20daence(c0, m, mlen, a, sizeof a, k);
+
+		crypto_dae_salsa20daence_detached(c1, t, m, mlen, a, sizeof a, k);
+		if (memcmp(t, c0, 24) || memcmp(c1, c0 + 24, mlen))
+			return -1;
+		if (crypto_dae_salsa20daence_open_detached(m1, c1, mlen, t,
+			a, sizeof a, k))
+			return -1;
+		if (memcmp(m1, m, mlen))
+			return -1;
+
+		/* In place.  */
+		memcpy(m1, m, mlen);
+		crypto_dae_salsa20daence_detached(m1, t, m1, mlen, a, sizeof a, k);
+		if (memcmp(t, c0, 24) || memcmp(m1, c0 + 24, mlen))
+			return -1;
+		if (crypto_dae_salsa20daence_open_detached(m1, m1, mlen, t,
+			a, sizeof a, k))
+			return -1;
+		if (memcmp(m1, m, mlen))
+			return -1;
+
+		/* Forgery: the buffer is zeroed.  */
+		memcpy(m1, c0 + 24, mlen);
+		t[mlen % 24] ^= 0x10;
+		if (crypto_dae_salsa20daence_open_detached(m1, m1, mlen, t,
+			a, sizeof a, k) == 0)
+			return -1;
+		for (i = 0; i < mlen; i++) {
+			if (m1[i])
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Check that verifying without output agrees with opening, on genuine
+ * messages and on forgeries in the tag, the ciphertext, and the header.
+ */
+static int
+verify_test(void)
+{
+	static const unsigned long long mlens[] = {
+		0, 1, 4095, 4096, 4097, 70000,
+	};
+	static unsigned char k[96], a[33], m[70000];
+	static unsigned char c[24 + sizeof m];
+	unsigned long long mlen, i;
+	unsigned mi;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = 5*i;
+	for (i = 0; i < sizeof a; i++)
+		a[i] = 0x40 + i;
+	for (i = 0; i < sizeof m; i++)
+		m[i] = i*11 + (i >> 9);
+
+	for (mi = 0; mi < sizeof mlens/sizeof mlens[0]; mi++) {
+		mlen = mlens[mi];
+		crypto_dae_salsa20daence(c, m, mlen, a, sizeof a, k);
+		if (crypto_dae_salsa20daence_verify(c, mlen, a, sizeof a, k))
+			return -1;
+		if (crypto_dae_salsa20daence_verify(c, mlen, a, sizeof a - 1, k) == 0)
+			return -1;
+		c[3] ^= 1;
+		if (crypto_dae_salsa20daence_verify(c, mlen, a, sizeof a, k) == 0)
+			return -1;
+		c[3] ^= 1;
+		if (mlen) {
+			c[24 + mlen - 1] ^= 0x80;
+			if (crypto_dae_salsa20daence_verify(c, mlen, a, sizeof a,
+				k) == 0)
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Check that splitting a message across threads gives the same answer
+ * as processing it in one piece, for a few awkward lengths.
+ */
+static int
+parallel_test(void)
+{
+	static const unsigned long long lens[] = {
+		0, 1, 65536, 4*65536 + 1, 1048576 + 13, 3*1048576 + 64,
+	};
+	static unsigned char k[96], a[19];
+	struct crypto_dae_salsa20daence_ctx ctx;
+	unsigned char *m, *c0, *c1, *m1;
+	unsigned long long mlen, i;
+	unsigned j, nthreads;
+	int ret = -1;
+
+	m = malloc(3*1048576 + 64);
+	c0 = malloc(3*1048576 + 64 + 24);
+	c1 = malloc(3*1048576 + 64 + 24);
+	m1 = malloc(3*1048576 + 64);
+	if (m == NULL || c0 == NULL || c1 == NULL || m1 == NULL)
+		goto out;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = i;
+	for (i = 0; i < sizeof a; i++)
+		a[i] = 0x40 + i;
+	for (i = 0; i < 3*1048576 + 64; i++)
+		m[i] = i*i + 7;
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+
+	for (j = 0; j < sizeof lens/sizeof lens[0]; j++) {
+		mlen = lens[j];
+		crypto_dae_salsa20daence_ctx_encrypt(c0, m, mlen, a, sizeof a,
+		    &ctx);
+		for (nthreads = 1; nthreads <= 5; nthreads++) {
+			memset(c1, 0xa5, mlen + 24);
+			memset(m1, 0x5a, mlen);
+			crypto_dae_salsa20daence_ctx_parallel(c1, m, mlen,
+			    a, sizeof a, &ctx, nthreads);
+			if (memcmp(c0, c1, mlen + 24) != 0)
+				goto out;
+			if (crypto_dae_salsa20daence_ctx_open_parallel(m1, c1,
+				mlen, a, sizeof a, &ctx, nthreads))
+				goto out;
+			if (memcmp(m, m1, mlen) != 0)
+				goto out;
+			c1[mlen ? 24 + mlen/2 : 0] ^= 0x10;
+			if (crypto_dae_salsa20daence_ctx_open_parallel(m1, c1,
+				mlen, a, sizeof a, &ctx, nthreads) == 0)
+				goto out;
+		}
+	}
+	ret = 0;
+
+out:	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+	free(m1);
+	free(c1);
+	free(c0);
+	free(m);
+	return ret;
+}
+
+/*
+ * Check that the authentication-only calls agree with the tag of an
+ * empty message, one at a time and in a batch.
+ */
+static int
+auth_test(void)
+{
+	static unsigned char k[96], a[300], t[8][24], c[24];
+	struct crypto_dae_salsa20daence_authbatch b[8];
+	struct crypto_dae_salsa20daence_ctx ctx;
+	unsigned long long i;
+	unsigned j;
+	int ret = -1;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = 3*i + 1;
+	for (i = 0; i < sizeof a; i++)
+		a[i] = i ^ (i >> 3);
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	for (j = 0; j < 8; j++) {
+		b[j].t = t[j];
+		b[j].a = a;
+		b[j].alen = (unsigned long long)j*j*j % sizeof a;
+		b[j].ret = 0;
+	}
+	crypto_dae_salsa20daence_ctx_auth_batch(b, 8, &ctx);
+	for (j = 0; j < 8; j++) {
+		crypto_dae_salsa20daence(c, NULL, 0, a, b[j].alen, k);
+		if (memcmp(t[j], c, 24))
+			goto out;
+		memset(t[j], 0, 24);
+		crypto_dae_salsa20daence_auth(t[j], a, b[j].alen, k);
+		if (memcmp(t[j], c, 24))
+			goto out;
+		if (crypto_dae_salsa20daence_auth_verify(c, a, b[j].alen, k))
+			goto out;
+		c[j] ^= 0x10;
+		if (crypto_dae_salsa20daence_auth_verify(c, a, b[j].alen,
+			k) == 0)
+			goto out;
+	}
+	if (crypto_dae_salsa20daence_ctx_auth_verify_batch(b, 8, &ctx))
+		goto out;
+	t[5][23] ^= 1;
+	if (crypto_dae_salsa20daence_ctx_auth_verify_batch(b, 8, &ctx) == 0)
+		goto out;
+	for (j = 0; j < 8; j++) {
+		if (b[j].ret != (j == 5 ? -1 : 0))
+			goto out;
+	}
+	ret = 0;
+
+out:	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+	return ret;
+}
+
+/*
+ * Check that the tag-only calls compute the same tag as sealing, one at
+ * a time and in a batch.
+ */
+static int
+tag_test(void)
+{
+	static const unsigned long long mlens[] = {
+		0, 1, 15, 16, 17, 63, 64, 65, 1000, 70000,
+	};
+	enum { N = sizeof mlens/sizeof mlens[0] };
+	static unsigned char k[96], a[33], m[70000], c[24 + sizeof m];
+	static unsigned char t[N][24];
+	struct crypto_dae_salsa20daence_tagbatch b[N];
+	struct crypto_dae_salsa20daence_ctx ctx;
+	unsigned char u[24];
+	unsigned long long i;
+	unsigned j;
+	int ret = -1;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = 5*i + 2;
+	for (i = 0; i < sizeof a; i++)
+		a[i] = 0x40 + i;
+	for (i = 0; i < sizeof m; i++)
+		m[i] = i*13 + (i >> 7);
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	for (j = 0; j < N; j++) {
+		b[j].t = t[j];
+		b[j].m = m;
+		b[j].mlen = mlens[j];
+		b[j].a = a;
+		b[j].alen = j % 2 ? sizeof a : j;
+	}
+	crypto_dae_salsa20daence_ctx_tag_batch(b, N, &ctx);
+	for (j = 0; j < N; j++) {
+		crypto_dae_salsa20daence(c, m, b[j].mlen, a, b[j].alen, k);
+		if (memcmp(t[j], c, 24))
+			goto out;
+		crypto_dae_salsa20daence_tag(u, m, b[j].mlen, a, b[j].alen, k);
+		if (memcmp(u, c, 24))
+			goto out;
+		crypto_dae_salsa20daence_ctx_tag(u, m, b[j].mlen, a, b[j].alen,
+		    &ctx);
+		if (memcmp(u, c, 24))
+			goto out;
+	}
+	ret = 0;
+
+out:	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+	return ret;
+}
+
+/*
+ * Check the header cache against the one-shot calls through a sequence
+ * of lookups that hits after a promotion, misses and re-adds a header
+ * after it was evicted, and alternates between headers of the same
+ * length that differ only in their first or last byte.
+ */
+static int
+hdrcache_test(void)
+{
+	enum { A, B, C, D, E, NHDR };
+	static const unsigned seq[] = {
+		A, B, A, C, A, B, B, C, D, A, D, E, E, A, B, C, D, E, A,
+	};
+	static unsigned char k[96], a[NHDR][40], m[100], c[24 + sizeof m];
+	static unsigned char c0[24 + sizeof m], m0[sizeof m];
+	static const unsigned long long alen[NHDR] = {
+		[A] = 40, [B] = 40, [C] = 40, [D] = 0, [E] = 39,
+	};
+	struct crypto_dae_salsa20daence_hdrcache *cache = NULL;
+	struct crypto_dae_salsa20daence_ctx ctx;
+	unsigned long long i;
+	unsigned n, j, h, o;
+	int ret = -1;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = 3*i + 11;
+	for (i = 0; i < sizeof a[A]; i++)
+		a[A][i] = a[B][i] = a[C][i] = a[E][i] = 0x20 + i;
+	a[B][sizeof a[B] - 1] ^= 1;	/* same length, last byte differs */
+	a[C][0] ^= 1;			/* same length, first byte differs */
+	for (i = 0; i < sizeof m; i++)
+		m[i] = i*7 + 1;
+
+	crypto_dae_salsa20daence_ctx_init(&ctx, k);
+	for (n = 1; n <= 3; n++) {
+		if ((cache = crypto_dae_salsa20daence_hdrcache_create(&ctx, n))
+		    == NULL)
+			goto out;
+		for (j = 0; j < sizeof seq/sizeof seq[0]; j++) {
+			h = seq[j];
+			o = seq[(j + 1) % (sizeof seq/sizeof seq[0])];
+			crypto_dae_salsa20daence(c, m, sizeof m, a[h], alen[h],
+			    k);
+			crypto_dae_salsa20daence_hdrcache_encrypt(c0, m,
+			    sizeof m, a[h], alen[h], cache);
+			if (memcmp(c, c0, sizeof c))
+				goto out;
+			if (crypto_dae_salsa20daence_hdrcache_open(m0, c,
+				sizeof m, a[h], alen[h], cache))
+				goto out;
+			if (memcmp(m, m0, sizeof m))
+				goto out;
+			/* A neighbouring header must not open it.  */
+			if (o != h &&
+			    crypto_dae_salsa20daence_hdrcache_open(m0, c,
+				sizeof m, a[o], alen[o], cache) == 0)
+				goto out;
+		}
+		crypto_dae_salsa20daence_hdrcache_destroy(cache);
+		cache = NULL;
+	}
+	ret = 0;
+
+out:	crypto_dae_salsa20daence_hdrcache_destroy(cache);
+	crypto_dae_salsa20daence_ctx_destroy(&ctx);
+	return ret;
+}
+
 int
 main(void)
 {
 
-	return crypto_dae_salsa20daence_selftest();
+	if (crypto_dae_salsa20daence_selftest())
+		return 1;
+	if (iov_test())
+		return 1;
+	if (detached_test())
+		return 1;
+	if (verify_test())
+		return 1;
+	if (auth_test())
+		return 1;
+	if (tag_test())
+		return 1;
+	if (hdrcache_test())
+		return 1;
+	if (parallel_test())
+		return 1;
+	return 0;
 }
@@ -0,0 +1,224 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chachadaence.h"
+#include "segdaence.h"
+
+#define	MAXLEN	300000
+
+static unsigned char k[64], id[32], id2[32];
+static unsigned char m[MAXLEN], m_[MAXLEN];
+static unsigned char sealed[MAXLEN + 24*(MAXLEN/64 + 1) + 64];
+
+/*
+ * Seal an object, open it whole and in ranges, and check that
+ * tampering with any part is caught by exactly the reads that touch it.
+ */
+static int
+object_test(struct crypto_dae_chachadaence_ctx *ctx, unsigned long long len,
+    unsigned long long segsize)
+{
+	struct crypto_dae_seg seg, rseg, xseg;
+	unsigned long long i, off, n, sealedlen, o;
+	unsigned t;
+
+	if (crypto_dae_seg_init(&seg, id, len, segsize, ctx))
+		return -1;
+	sealedlen = crypto_dae_seg_sealedlen(&seg);
+	if (sealedlen > sizeof sealed)
+		return -1;
+
+	for (t = 1; t <= 4; t *= 2) {
+		memset(sealed, 0, sizeof sealed);
+		crypto_dae_seg_seal(&seg, sealed, m, t);
+
+		/* Each segment is the Daence of its plaintext.  */
+		for (i = 0; i < seg.nseg; i++) {
+			unsigned long long seglen = crypto_dae_seg_seglen(&seg,
+			    i);
+			unsigned char *c = sealed + crypto_dae_seg_offset(&seg,
+			    i);
+
+			if (crypto_dae_seg_verify_segment(&seg, c, i))
+				return -1;
+			if (crypto_dae_seg_open_segment(&seg, m_, c, i) ||
+			    memcmp(m_, m + i*segsize, seglen))
+				return -1;
+		}
+
+		if (crypto_dae_seg_open_index(&rseg, sealed, id, ctx))
+			return -1;
+		if (rseg.len != len || rseg.segsize != segsize ||
+		    rseg.nseg != seg.nseg)
+			return -1;
+		memset(m_, 0, sizeof m_);
+		if (crypto_dae_seg_open(&rseg, m_, sealed, t) ||
+		    memcmp(m_, m, len))
+			return -1;
+	}
+
+	/* Wrong id: index rejected.  */
+	if (crypto_dae_seg_open_index(&xseg, sealed, id2, ctx) == 0)
+		return -1;
+
+	/* Ranges, including empty ones and ones crossing boundaries.  */
+	for (off = 0; off <= len; off += 1 + off/3 + segsize/5) {
+		for (n = 0; n <= len - off; n += 1 + n/2 + segsize/3) {
+			memset(m_, 0, n);
+			if (crypto_dae_seg_read_range(&rseg, m_, off, n,
+				sealed) ||
+			    memcmp(m_, m + off, n))
+				return -1;
+		}
+	}
+	if (crypto_dae_seg_read_range(&rseg, m_, len, 1, sealed) == 0)
+		return -1;
+	if (len && crypto_dae_seg_read_range(&rseg, m_, 0, len + 1,
+		sealed) == 0)
+		return -1;
+
+	if (seg.nseg < 3)
+		return 0;
+
+	/* Corrupt a byte of segment 1: only reads touching it fail.  */
+	o = crypto_dae_seg_offset(&seg, 1) + 30;
+	sealed[o] ^= 4;
+	if (crypto_dae_seg_verify_segment(&rseg,
+		sealed + crypto_dae_seg_offset(&seg, 1), 1) == 0)
+		return -1;
+	if (crypto_dae_seg_read_range(&rseg, m_, 0, segsize, sealed) ||
+	    memcmp(m_, m, segsize))
+		return -1;
+	if (crypto_dae_seg_read_range(&rseg, m_, 2*segsize, len - 2*segsize,
+		sealed) ||
+	    memcmp(m_, m + 2*segsize, len - 2*segsize))
+		return -1;
+	if (crypto_dae_seg_read_range(&rseg, m_, segsize - 1, 2, sealed) == 0)
+		return -1;
+	if (m_[0] || m_[1])
+		return -1;
+	if (crypto_dae_seg_open(&rseg, m_, sealed, 2) == 0)
+		return -1;
+	for (i = 0; i < len; i++) {
+		if (m_[i])
+			return -1;
+	}
+	sealed[o] ^= 4;
+
+	/* Swap segments 0 and 1: both are rejected where they land.  */
+	if (crypto_dae_seg_verify_segment(&rseg,
+		sealed + crypto_dae_seg_offset(&seg, 1), 0) == 0 ||
+	    crypto_dae_seg_verify_segment(&rseg,
+		sealed + crypto_dae_seg_offset(&seg, 0), 1) == 0)
+		return -1;
+	if (crypto_dae_seg_verify_segment(&rseg, sealed, seg.nseg) == 0)
+		return -1;
+
+	/* A segment from a shorter object with the same id is rejected.  */
+	if (crypto_dae_seg_init(&seg, id, len - 1, segsize, ctx))
+		return -1;
+	crypto_dae_seg_seal_segment(&seg, sealed + crypto_dae_seg_offset(&seg,
+		0), m, 0);
+	if (crypto_dae_seg_verify_segment(&rseg,
+		sealed + crypto_dae_seg_offset(&rseg, 0), 0) == 0)
+		return -1;
+
+	return 0;
+}
+
+static int
+geometry_test(struct crypto_dae_chachadaence_ctx *ctx)
+{
+	struct crypto_dae_seg seg;
+
+	if (crypto_dae_seg_init(&seg, id, 100, 0, ctx) == 0 ||
+	    crypto_dae_seg_init(&seg, id, 100, 100, ctx) == 0 ||
+	    crypto_dae_seg_init(&seg, id, 100, 1ull << 39, ctx) == 0 ||
+	    crypto_dae_seg_init(&seg, id, -1ull - 10, 64, ctx) == 0)
+		return -1;
+	if (crypto_dae_seg_init(&seg, id, 0, 64, ctx) || seg.nseg != 0 ||
+	    crypto_dae_seg_sealedlen(&seg) != crypto_dae_seg_INDEXBYTES)
+		return -1;
+	if (crypto_dae_seg_init(&seg, id, 129, 64, ctx) || seg.nseg != 3 ||
+	    crypto_dae_seg_seglen(&seg, 2) != 1 ||
+	    crypto_dae_seg_seglen(&seg, 3) != 0 ||
+	    crypto_dae_seg_sealedlen(&seg) != 56 + 3*24 + 129 ||
+	    crypto_dae_seg_offset(&seg, 2) != 56 + 2*(24 + 64))
+		return -1;
+
+	return 0;
+}
+
+int
+main(void)
+{
+	static const struct {
+		unsigned long long len, segsize;
+	} C[] = {
+		{ 0, 64 },
+		{ 1, 64 },
+		{ 64, 64 },
+		{ 1000, 64 },
+		{ 4096*5, 4096 },
+		{ 4096*5 + 17, 4096 },
+		{ MAXLEN, 65536 },
+		{ MAXLEN, 1 << 20 },
+	};
+	struct crypto_dae_chachadaence_ctx ctx;
+	unsigned long long i;
+	unsigned j;
+	int ret = 1;
+
+	for (i = 0; i < sizeof k; i++)
+		k[i] = 7*i + 3;
+	for (i = 0; i < sizeof id; i++) {
+		id[i] = i;
+		id2[i] = i ^ (i == 31);
+	}
+	for (i = 0; i < sizeof m; i++)
+		m[i] = i*13 + (i >> 11);
+	crypto_dae_chachadaence_ctx_init(&ctx, k);
+
+	if (geometry_test(&ctx)) {
+		fprintf(stderr, "geometry failed\n");
+		goto out;
+	}
+	for (j = 0; j < sizeof C/sizeof C[0]; j++) {
+		if (object_test(&ctx, C[j].len, C[j].segsize)) {
+			fprintf(stderr, "object %llu/%llu failed\n",
+			    C[j].len, C[j].segsize);
+			goto out;
+		}
+	}
+	ret = 0;
+
+out:	crypto_dae_chachadaence_ctx_destroy(&ctx);
+	return ret;
+}
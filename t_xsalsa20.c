@@ -0,0 +1,119 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "crypto_stream_xsalsa20.h"
+#include "xsalsa20.h"
+
+void
+randombytes(unsigned char *p, unsigned long long n)
+{
+	static int fd = -1;
+	ssize_t nread;
+
+	if (fd == -1) {
+		if ((fd = open("/dev/urandom", O_RDONLY)) == -1)
+			abort();
+	}
+
+	while (n) {
+		nread = read(fd, p, n);
+		if (nread == -1 || nread == 0)
+			abort();
+		p += ((size_t)nread > n ? n : (size_t)nread);
+		n -= ((size_t)nread > n ? n : (size_t)nread);
+	}
+}
+
+/*
+ * Compare XSalsa20 against NaCl over every message length up to
+ * 2 KiB plus some longer ones -- out of place, in place, in
+ * irregular pieces, and seeking block by block -- with each block
+ * function that xsalsa20_force_portable can select.
+ */
+int
+main(void)
+{
+	static unsigned char m[65536 + 7], c[sizeof m], e[sizeof m];
+	unsigned char k[32], n[24];
+	struct xsalsa20 S;
+	unsigned long long mlen, i, l;
+	unsigned char step;
+	unsigned trial;
+
+	for (trial = 0; trial < 3; trial++) {
+		xsalsa20_force_portable(trial);
+		randombytes(k, sizeof k);
+		randombytes(n, sizeof n);
+		randombytes(m, sizeof m);
+		for (mlen = 0; mlen <= sizeof m;
+		     mlen += (mlen < 2048 ? 1 : 4093)) {
+			crypto_stream_xsalsa20_xor(e, m, mlen, n, k);
+
+			memset(c, 0xa5, sizeof c);
+			xsalsa20_xor(c, m, mlen, n, k);
+			if (memcmp(c, e, mlen) != 0)
+				return 1;
+			if (mlen < sizeof c && c[mlen] != 0xa5)
+				return 1;
+
+			memcpy(c, m, mlen);
+			xsalsa20_xor(c, c, mlen, n, k);
+			if (memcmp(c, e, mlen) != 0)
+				return 1;
+
+			randombytes(&step, 1);
+			xsalsa20_init(&S, n, k);
+			for (i = 0; i < mlen; i += l) {
+				l = (step++ & 1) ? 1 + step % 67 : 600;
+				if (l > mlen - i)
+					l = mlen - i;
+				xsalsa20_update(&S, c + i, m + i, l);
+			}
+			xsalsa20_clear(&S);
+			if (memcmp(c, e, mlen) != 0)
+				return 1;
+
+			/* Back to front, a block at a time.  */
+			xsalsa20_init(&S, n, k);
+			for (i = mlen/64 + 1; i-- > 0;) {
+				l = (mlen - 64*i < 64 ? mlen - 64*i : 64);
+				xsalsa20_seek(&S, i);
+				xsalsa20_update(&S, c + 64*i, m + 64*i, l);
+			}
+			xsalsa20_clear(&S);
+			if (memcmp(c, e, mlen) != 0)
+				return 1;
+		}
+	}
+
+	xsalsa20_force_portable(0);
+	return 0;
+}
@@ -0,0 +1,466 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * XSalsa20 -- NaCl crypto_stream_xsalsa20_xor, several blocks at a time
+ *
+ *      k' := HSalsa20_k(n[0..16])
+ *      c := m ^ Salsa20_k'(n[16..24], 0) || Salsa20_k'(n[16..24], 1) || ...
+ *
+ *      The portable code generates one 64-byte block at a time, like
+ *      tweetnacl.  On x86 CPUs, runs of blocks go through vector code
+ *      that keeps word i of four (SSE2) or eight (AVX2) consecutive
+ *      blocks in one register, so every operation of the round
+ *      function serves all of them; the words are transposed back into
+ *      blocks on the way out.  The vector unit is selected at run time.
+ *      Define DAENCE_PORTABLE to build only the portable code.
+ */
+
+#define	_POSIX_C_SOURCE	200809L
+
+#include "xsalsa20.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    !defined(DAENCE_PORTABLE)
+#define	XSALSA20_SIMD
+#include <immintrin.h>
+#endif
+
+static void *(*volatile explicit_memset)(void *, int, size_t) = memset;
+
+static inline uint32_t
+le32dec(const void *buf)
+{
+	const unsigned char *p = buf;
+	uint32_t v = 0;
+
+	v |= (uint32_t)p[0] << 0;
+	v |= (uint32_t)p[1] << 8;
+	v |= (uint32_t)p[2] << 16;
+	v |= (uint32_t)p[3] << 24;
+
+	return v;
+}
+
+static inline void
+le32enc(void *buf, uint32_t v)
+{
+	unsigned char *p = buf;
+
+	p[0] = v >> 0;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static inline uint32_t
+rol32(uint32_t x, unsigned c)
+{
+
+	return (x << c) | (x >> (32 - c));
+}
+
+/*
+ * One double round, a column round and a row round, in terms of a
+ * quarter-round QR(a, b, c, d) on whatever x holds.
+ */
+#define	SALSA20_DOUBLEROUND(QR, x) do {					      \
+	QR(x[0], x[4], x[8], x[12]);	/* columns */			      \
+	QR(x[5], x[9], x[13], x[1]);					      \
+	QR(x[10], x[14], x[2], x[6]);					      \
+	QR(x[15], x[3], x[7], x[11]);					      \
+	QR(x[0], x[1], x[2], x[3]);	/* rows */			      \
+	QR(x[5], x[6], x[7], x[4]);					      \
+	QR(x[10], x[11], x[8], x[9]);					      \
+	QR(x[15], x[12], x[13], x[14]);					      \
+} while (0)
+
+#define	QR32(a, b, c, d) do {						      \
+	(b) ^= rol32((a) + (d), 7);					      \
+	(c) ^= rol32((b) + (a), 9);					      \
+	(d) ^= rol32((c) + (b), 13);					      \
+	(a) ^= rol32((d) + (c), 18);					      \
+} while (0)
+
+static const unsigned char sigma[16] = "expand 32-byte k";
+
+/* in := Salsa20 input block for key k, 16-byte input n */
+static void
+salsa20_input(uint32_t in[static 16], const unsigned char k[static 32],
+    const unsigned char n[static 16])
+{
+	unsigned i;
+
+	for (i = 0; i < 4; i++) {
+		in[5*i] = le32dec(sigma + 4*i);
+		in[1 + i] = le32dec(k + 4*i);
+		in[6 + i] = le32dec(n + 4*i);
+		in[11 + i] = le32dec(k + 16 + 4*i);
+	}
+}
+
+static void
+hsalsa20(unsigned char out[static 32], const unsigned char n[static 16],
+    const unsigned char k[static 32])
+{
+	uint32_t x[16];
+	unsigned i;
+
+	salsa20_input(x, k, n);
+	for (i = 0; i < 10; i++)
+		SALSA20_DOUBLEROUND(QR32, x);
+	for (i = 0; i < 4; i++) {
+		le32enc(out + 4*i, x[5*i]);
+		le32enc(out + 16 + 4*i, x[6 + i]);
+	}
+
+	explicit_memset(x, 0, sizeof x);
+}
+
+static inline void
+salsa20_advance(uint32_t in[static 16], unsigned n)
+{
+	uint64_t ctr = in[8] | (uint64_t)in[9] << 32;
+
+	ctr += n;
+	in[8] = (uint32_t)ctr;
+	in[9] = (uint32_t)(ctr >> 32);
+}
+
+/* ks := Salsa20(in), and advance the block counter.  */
+static void
+salsa20_block(unsigned char ks[static 64], uint32_t in[static 16])
+{
+	uint32_t x[16];
+	unsigned i;
+
+	memcpy(x, in, sizeof x);
+	for (i = 0; i < 10; i++)
+		SALSA20_DOUBLEROUND(QR32, x);
+	for (i = 0; i < 16; i++)
+		le32enc(ks + 4*i, x[i] + in[i]);
+	salsa20_advance(in, 1);
+
+	explicit_memset(x, 0, sizeof x);
+}
+
+/* c[0..64] := m[0..64] ^ Salsa20(in), and advance the block counter.  */
+static void
+salsa20_xor1(unsigned char *c, const unsigned char *m,
+    uint32_t in[static 16])
+{
+	unsigned char ks[64];
+	unsigned i;
+
+	salsa20_block(ks, in);
+	for (i = 0; i < 64; i++)
+		c[i] = m[i] ^ ks[i];
+
+	explicit_memset(ks, 0, sizeof ks);
+}
+
+#ifdef XSALSA20_SIMD
+
+#define	SSE2	__attribute__((__target__("sse2")))
+#define	AVX2	__attribute__((__target__("avx2")))
+
+static SSE2 inline __m128i
+rol32x4(__m128i x, int c)
+{
+
+	return _mm_or_si128(_mm_slli_epi32(x, c), _mm_srli_epi32(x, 32 - c));
+}
+
+#define	QR32X4(a, b, c, d) do {						      \
+	(b) = _mm_xor_si128((b), rol32x4(_mm_add_epi32((a), (d)), 7));	      \
+	(c) = _mm_xor_si128((c), rol32x4(_mm_add_epi32((b), (a)), 9));	      \
+	(d) = _mm_xor_si128((d), rol32x4(_mm_add_epi32((c), (b)), 13));      \
+	(a) = _mm_xor_si128((a), rol32x4(_mm_add_epi32((d), (c)), 18));      \
+} while (0)
+
+/*
+ * Transpose x[0..4], each holding one word of four blocks, so that
+ * x[i] holds four consecutive words of block i.  For 256-bit vectors
+ * the same happens independently in each 128-bit half.
+ */
+#define	TRANSPOSE4(UNPACKLO32, UNPACKHI32, UNPACKLO64, UNPACKHI64, x) do {    \
+	t0 = UNPACKLO32((x)[0], (x)[1]);				      \
+	t1 = UNPACKLO32((x)[2], (x)[3]);				      \
+	t2 = UNPACKHI32((x)[0], (x)[1]);				      \
+	t3 = UNPACKHI32((x)[2], (x)[3]);				      \
+	(x)[0] = UNPACKLO64(t0, t1);					      \
+	(x)[1] = UNPACKHI64(t0, t1);					      \
+	(x)[2] = UNPACKLO64(t2, t3);					      \
+	(x)[3] = UNPACKHI64(t2, t3);					      \
+} while (0)
+
+/* Same as salsa20_xor1 for n runs of four whole blocks.  */
+static SSE2 void
+salsa20_xor4(unsigned char *c, const unsigned char *m, unsigned long long n,
+    uint32_t in[static 16])
+{
+	__m128i x[16], y[16], t0, t1, t2, t3;
+	uint64_t ctr;
+	unsigned i, j;
+
+	for (i = 0; i < 16; i++)
+		y[i] = _mm_set1_epi32((int)in[i]);
+
+	for (; n --> 0; c += 256, m += 256) {
+		ctr = in[8] | (uint64_t)in[9] << 32;
+		y[8] = _mm_set_epi32((int)(uint32_t)(ctr + 3),
+		    (int)(uint32_t)(ctr + 2), (int)(uint32_t)(ctr + 1),
+		    (int)(uint32_t)ctr);
+		y[9] = _mm_set_epi32((int)(uint32_t)((ctr + 3) >> 32),
+		    (int)(uint32_t)((ctr + 2) >> 32),
+		    (int)(uint32_t)((ctr + 1) >> 32),
+		    (int)(uint32_t)(ctr >> 32));
+
+		for (i = 0; i < 16; i++)
+			x[i] = y[i];
+		for (i = 0; i < 10; i++)
+			SALSA20_DOUBLEROUND(QR32X4, x);
+		for (i = 0; i < 16; i++)
+			x[i] = _mm_add_epi32(x[i], y[i]);
+
+		/* x[4j + i] := words 4j..4j+3 of block i */
+		for (j = 0; j < 4; j++) {
+			TRANSPOSE4(_mm_unpacklo_epi32, _mm_unpackhi_epi32,
+			    _mm_unpacklo_epi64, _mm_unpackhi_epi64, x + 4*j);
+			for (i = 0; i < 4; i++) {
+				const size_t o = 64*i + 16*j;
+
+				_mm_storeu_si128((__m128i *)(c + o),
+				    _mm_xor_si128(x[4*j + i],
+					_mm_loadu_si128((const __m128i *)
+					    (m + o))));
+			}
+		}
+
+		salsa20_advance(in, 4);
+	}
+
+	explicit_memset(x, 0, sizeof x);
+	explicit_memset(y, 0, sizeof y);
+}
+
+static AVX2 inline __m256i
+rol32x8(__m256i x, int c)
+{
+
+	return _mm256_or_si256(_mm256_slli_epi32(x, c),
+	    _mm256_srli_epi32(x, 32 - c));
+}
+
+#define	QR32X8(a, b, c, d) do {						      \
+	(b) = _mm256_xor_si256((b), rol32x8(_mm256_add_epi32((a), (d)), 7));  \
+	(c) = _mm256_xor_si256((c), rol32x8(_mm256_add_epi32((b), (a)), 9));  \
+	(d) = _mm256_xor_si256((d), rol32x8(_mm256_add_epi32((c), (b)), 13)); \
+	(a) = _mm256_xor_si256((a), rol32x8(_mm256_add_epi32((d), (c)), 18)); \
+} while (0)
+
+/* Same as salsa20_xor1 for n runs of eight whole blocks.  */
+static AVX2 void
+salsa20_xor8(unsigned char *c, const unsigned char *m, unsigned long long n,
+    uint32_t in[static 16])
+{
+	__m256i x[16], y[16], t0, t1, t2, t3;
+	uint32_t lo[8], hi[8];
+	uint64_t ctr;
+	unsigned i, j;
+
+	for (i = 0; i < 16; i++)
+		y[i] = _mm256_set1_epi32((int)in[i]);
+
+	for (; n --> 0; c += 512, m += 512) {
+		ctr = in[8] | (uint64_t)in[9] << 32;
+		for (i = 0; i < 8; i++) {
+			lo[i] = (uint32_t)(ctr + i);
+			hi[i] = (uint32_t)((ctr + i) >> 32);
+		}
+		y[8] = _mm256_loadu_si256((const __m256i *)lo);
+		y[9] = _mm256_loadu_si256((const __m256i *)hi);
+
+		for (i = 0; i < 16; i++)
+			x[i] = y[i];
+		for (i = 0; i < 10; i++)
+			SALSA20_DOUBLEROUND(QR32X8, x);
+		for (i = 0; i < 16; i++)
+			x[i] = _mm256_add_epi32(x[i], y[i]);
+
+		/*
+		 * x[4j + i] := words 4j..4j+3 of block i in the low half
+		 * and of block i + 4 in the high half
+		 */
+		for (j = 0; j < 4; j++) {
+			TRANSPOSE4(_mm256_unpacklo_epi32,
+			    _mm256_unpackhi_epi32, _mm256_unpacklo_epi64,
+			    _mm256_unpackhi_epi64, x + 4*j);
+		}
+
+		/* Join the halves of each block, 32 bytes at a time.  */
+		for (i = 0; i < 4; i++) {
+			for (j = 0; j < 2; j++) {
+				const size_t o = 64*i + 32*j;
+
+				t0 = _mm256_permute2x128_si256(x[8*j + i],
+				    x[8*j + 4 + i], 0x20);
+				t1 = _mm256_permute2x128_si256(x[8*j + i],
+				    x[8*j + 4 + i], 0x31);
+				_mm256_storeu_si256((__m256i *)(c + o),
+				    _mm256_xor_si256(t0,
+					_mm256_loadu_si256((const __m256i *)
+					    (m + o))));
+				_mm256_storeu_si256((__m256i *)(c + 256 + o),
+				    _mm256_xor_si256(t1,
+					_mm256_loadu_si256((const __m256i *)
+					    (m + 256 + o))));
+			}
+		}
+
+		salsa20_advance(in, 8);
+	}
+
+	explicit_memset(x, 0, sizeof x);
+	explicit_memset(y, 0, sizeof y);
+	_mm256_zeroupper();
+}
+
+#undef	AVX2
+#undef	SSE2
+
+#endif	/* XSALSA20_SIMD */
+
+static int xsalsa20_portable_only;	/* see xsalsa20_force_portable */
+
+void
+xsalsa20_init(struct xsalsa20 *S, const unsigned char n[static 24],
+    const unsigned char k[static 32])
+{
+	unsigned char subkey[32], n1[16] = {0}; /* n[16..24], counter 0 */
+
+	/* in := Salsa20 input for key HSalsa20_k(n[0..16]) */
+	hsalsa20(subkey, n, k);
+	memcpy(n1, n + 16, 8);
+	salsa20_input(S->in, subkey, n1);
+	S->nks = 0;
+
+	explicit_memset(subkey, 0, sizeof subkey);
+}
+
+void
+xsalsa20_update(struct xsalsa20 *S, unsigned char *c, const unsigned char *m,
+    unsigned long long mlen)
+{
+	uint32_t *in = S->in;
+	unsigned i, n;
+
+	/* Use up what is left of the last block.  */
+	n = (mlen < S->nks ? mlen : S->nks);
+	for (i = 0; i < n; i++)
+		c[i] = m[i] ^ S->ks[64 - S->nks + i];
+	S->nks -= n;
+	c += n;
+	m += n;
+	mlen -= n;
+
+#ifdef XSALSA20_SIMD
+	if (mlen >= 512 && xsalsa20_portable_only < 1 &&
+	    __builtin_cpu_supports("avx2")) {
+		salsa20_xor8(c, m, mlen/512, in);
+		c += mlen & ~511ull;
+		m += mlen & ~511ull;
+		mlen &= 511;
+	}
+	if (mlen >= 256 && xsalsa20_portable_only < 2 &&
+	    __builtin_cpu_supports("sse2")) {
+		salsa20_xor4(c, m, mlen/256, in);
+		c += mlen & ~255ull;
+		m += mlen & ~255ull;
+		mlen &= 255;
+	}
+#endif
+	for (; mlen >= 64; c += 64, m += 64, mlen -= 64)
+		salsa20_xor1(c, m, in);
+	if (mlen) {
+		/* Keep the rest of the block for the next piece.  */
+		salsa20_block(S->ks, in);
+		for (i = 0; i < mlen; i++)
+			c[i] = m[i] ^ S->ks[i];
+		S->nks = 64 - mlen;
+	}
+}
+
+void
+xsalsa20_seek(struct xsalsa20 *S, uint64_t i)
+{
+
+	S->in[8] = (uint32_t)i;
+	S->in[9] = (uint32_t)(i >> 32);
+	S->nks = 0;
+}
+
+void
+xsalsa20_clear(struct xsalsa20 *S)
+{
+
+	explicit_memset(S, 0, sizeof *S);
+}
+
+void
+xsalsa20_xor(unsigned char *c, const unsigned char *m,
+    unsigned long long mlen, const unsigned char n[static 24],
+    const unsigned char k[static 32])
+{
+	struct xsalsa20 S;
+
+	xsalsa20_init(&S, n, k);
+	xsalsa20_update(&S, c, m, mlen);
+	xsalsa20_clear(&S);
+}
+
+const char *
+xsalsa20_impl(void)
+{
+
+#ifdef XSALSA20_SIMD
+	if (xsalsa20_portable_only < 1 && __builtin_cpu_supports("avx2"))
+		return "avx2";
+	if (xsalsa20_portable_only < 2 && __builtin_cpu_supports("sse2"))
+		return "sse2";
+#endif
+	return "portable";
+}
+
+void
+xsalsa20_force_portable(int portable_only)
+{
+
+	xsalsa20_portable_only = portable_only;
+}
@@ -0,0 +1,75 @@
+/*-
+ * Copyright (c) 2020 Taylor R. Campbell
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef XSALSA20_H
+#define	XSALSA20_H
+
+#include <stdint.h>
+
+/*
+ * XSalsa20 stream cipher, same as NaCl crypto_stream_xsalsa20_xor:
+ * c[0..mlen] := m[0..mlen] ^ XSalsa20_k(n), with the block counter
+ * starting at zero.  c and m may be equal but must not otherwise
+ * overlap.  Several blocks are generated at once with SSE2 or AVX2
+ * where available, selected at run time.
+ */
+void xsalsa20_xor(unsigned char *, const unsigned char */*m*/,
+    unsigned long long /*mlen*/, const unsigned char[static 24],
+    const unsigned char[static 32]);
+
+/*
+ * Same in pieces: xsalsa20_init, then xsalsa20_update on consecutive
+ * pieces of the message of any lengths, then xsalsa20_clear.  The
+ * keystream picks up where the last piece left off.
+ */
+struct xsalsa20 {
+	uint32_t	in[16];		/* Salsa20 input, next block */
+	unsigned char	ks[64];		/* keystream of the last block */
+	unsigned	nks;		/* unused bytes at the end of ks */
+};
+
+void xsalsa20_init(struct xsalsa20 *, const unsigned char[static 24],
+    const unsigned char[static 32]);
+void xsalsa20_update(struct xsalsa20 *, unsigned char *,
+    const unsigned char */*m*/, unsigned long long /*mlen*/);
+void xsalsa20_clear(struct xsalsa20 *);
+
+/*
+ * Jump to the start of 64-byte block i of the keystream, as if 64*i
+ * bytes had gone through xsalsa20_update since xsalsa20_init, e.g. to
+ * process pieces of one message on different threads.
+ */
+void xsalsa20_seek(struct xsalsa20 *, uint64_t);
+
+/*
+ * Name of the block function in use ("avx2", "sse2", or "portable"),
+ * and a knob for testing: 0 picks the best available, 1 avoids AVX2,
+ * and 2 generates one block at a time.  Not thread-safe.
+ */
+const char *xsalsa20_impl(void);
+void xsalsa20_force_portable(int);
+
+#endif	/* XSALSA20_H */